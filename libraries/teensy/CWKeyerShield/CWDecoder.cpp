@@ -0,0 +1,290 @@
+/* CW decoder for Teensy 4.X
+ * Copyright (c) 2021, kf7o, Steve Haynal, steve@softerhardware.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+//
+// See TeensyAudioTone.cpp why there is an ifndef here
+//
+#ifndef __AVR__
+
+#include <Arduino.h>
+#include "CWDecoder.h"
+#include "utility/dspinst.h"
+
+namespace {
+
+//
+// Morse tree: starting with 1, each dit shifts in a 0 and each dah shifts
+// in a 1, so the code of a character with up to 6 elements is its index
+// in this table. '*' marks codes that are not assigned.
+//
+const char morse_tree[128 + 1] =
+    "**ETIANMSURWDKGOHVF*L*PJBXCYZQ**"
+    "54*3***2&*+****16=/***(*7***8*90"
+    "************?*****\"**.****@***'*"
+    "*-********;!*)*****,****:*******";
+
+//
+// Adaptive threshold: a mark starts above HIGH and ends below LOW, both
+// taken between the noise floor (0) and the signal peak (1). Nothing is
+// detected unless the peak is SQUELCH times the noise floor.
+//
+const float THRESHOLD_HIGH = 0.6F;
+const float THRESHOLD_LOW  = 0.4F;
+const float SQUELCH        = 4.0F;
+
+//
+// Envelope follower coefficients (per block): the signal peak has a fast
+// attack and a slow decay. The noise floor is the mean magnitude during
+// spaces; it must not follow the tone, otherwise long marks would close
+// the squelch. So it is frozen during marks, and a single block can
+// raise it by a limited amount only, as the first block(s) of a mark
+// after a long space may still be squelched.
+//
+const float ENVELOPE_FAST  = 0.25F;
+const float ENVELOPE_SLOW  = 0.002F;
+const float ENVELOPE_NOISE = 0.05F;
+const int   NOISE_ACQUIRE  = 32;
+
+//
+// Speed range that is tracked (words per minute)
+//
+const float WPM_MIN = 5.0F;
+const float WPM_MAX = 60.0F;
+
+} // namespace
+
+void CWDecoder::frequency(float freq)
+{
+    uint8_t next = !lo_select;
+    const int N = 2 * LO_LENGTH;
+
+    if (freq < 100.0F) {
+        freq = 100.0F;
+    } else if (freq > 3000.0F) {
+        freq = 3000.0F;
+    }
+    //
+    // Hann window times cos/sin, scaled to 8191 such that 8 products
+    // of a sample and a table entry do not overflow 32 bits.
+    // The low half-word holds the even, the high half-word the odd sample.
+    //
+    float w = 2.0F * PI * freq / AUDIO_SAMPLE_RATE_EXACT;
+    for (int i = 0; i < LO_LENGTH; i++) {
+        int16_t c[2], s[2];
+        for (int j = 0; j < 2; j++) {
+            int n = 2 * i + j;
+            float win = 8191.0F * (0.5F - 0.5F * cosf(2.0F * PI * (n + 0.5F) / N));
+            c[j] = win * cosf(w * n);
+            s[j] = win * sinf(w * n);
+        }
+        lo_cos[next][i] = pack_16b_16b(c[1], c[0]);
+        lo_sin[next][i] = pack_16b_16b(s[1], s[0]);
+    }
+    lo_select = next;
+}
+
+//
+// Tone magnitude over the detector window: a single-bin DFT, two samples
+// per dual multiply-accumulate (SMLAD). Partial sums of 8 samples are
+// collected in 32 bits, and then added up in 64 bits.
+//
+float CWDecoder::detect(void)
+{
+    const uint32_t *c = lo_cos[lo_select];
+    const uint32_t *s = lo_sin[lo_select];
+    int64_t re = 0, im = 0;
+
+    for (int k = 0; k < CWDECODER_WINDOW_BLOCKS; k++) {
+        const uint32_t *x = (const uint32_t *) history[(slot + k) % CWDECODER_WINDOW_BLOCKS];
+        for (int i = 0; i < AUDIO_BLOCK_SAMPLES / 2; i += 4) {
+            int32_t r = 0, q = 0;
+            r = multiply_accumulate_16tx16t_add_16bx16b(r, x[i],     c[i]);
+            q = multiply_accumulate_16tx16t_add_16bx16b(q, x[i],     s[i]);
+            r = multiply_accumulate_16tx16t_add_16bx16b(r, x[i + 1], c[i + 1]);
+            q = multiply_accumulate_16tx16t_add_16bx16b(q, x[i + 1], s[i + 1]);
+            r = multiply_accumulate_16tx16t_add_16bx16b(r, x[i + 2], c[i + 2]);
+            q = multiply_accumulate_16tx16t_add_16bx16b(q, x[i + 2], s[i + 2]);
+            r = multiply_accumulate_16tx16t_add_16bx16b(r, x[i + 3], c[i + 3]);
+            q = multiply_accumulate_16tx16t_add_16bx16b(q, x[i + 3], s[i + 3]);
+            re += r;
+            im += q;
+        }
+        c += AUDIO_BLOCK_SAMPLES / 2;
+        s += AUDIO_BLOCK_SAMPLES / 2;
+    }
+    float fr = (float) re;
+    float fi = (float) im;
+    return sqrtf(fr * fr + fi * fi);
+}
+
+void CWDecoder::put(char c)
+{
+    uint8_t head = char_head;
+    uint8_t next = (head + 1) & (CHAR_QUEUE_LENGTH - 1);
+
+    if (next == char_tail) {
+        // queue full, nobody is reading
+        dropped_chars++;
+        return;
+    }
+    chars[head] = c;
+    __sync_synchronize();
+    char_head = next;
+}
+
+int CWDecoder::read(void)
+{
+    uint8_t tail = char_tail;
+    int c;
+
+    if (tail == char_head) return -1;
+    c = (uint8_t) chars[tail];
+    __sync_synchronize();
+    char_tail = (tail + 1) & (CHAR_QUEUE_LENGTH - 1);
+    return c;
+}
+
+//
+// A mark of the given duration has ended: classify it as dit or dah,
+// and track the dit length with it
+//
+void CWDecoder::element(float duration)
+{
+    if (duration < 0.3F * dit) {
+        // too short, most likely a noise spike
+        return;
+    }
+    uint8_t dah = (duration >= 2.0F * dit);
+
+    if (elements < 4) {
+        //
+        // Acquisition: the initial dit length is only a guess, so the
+        // first mark, and then any much shorter one, sets it directly
+        //
+        if (elements == 0) {
+            dit = dah ? duration / 3.0F : duration;
+        } else if (duration < 0.6F * dit) {
+            dit = duration;
+        } else {
+            dit += ((dah ? duration / 3.0F : duration) - dit) / (elements + 1);
+        }
+        elements++;
+    } else {
+        dit += 0.2F * ((dah ? duration / 3.0F : duration) - dit);
+    }
+    if (dit < dit_blocks(WPM_MAX)) dit = dit_blocks(WPM_MAX);
+    if (dit > dit_blocks(WPM_MIN)) dit = dit_blocks(WPM_MIN);
+    //
+    // After 7 elements code is beyond the table, then it stays there
+    //
+    if (code < 128) code = (code << 1) | dah;
+}
+
+void CWDecoder::decode(float mag)
+{
+    float high, low, f;
+
+    //
+    // Acquisition: once the detector window is full, the noise floor
+    // starts as the plain mean of NOISE_ACQUIRE blocks. Nothing is
+    // decoded meanwhile.
+    //
+    if (acquired < CWDECODER_WINDOW_BLOCKS + NOISE_ACQUIRE) {
+        acquired++;
+        if (acquired > CWDECODER_WINDOW_BLOCKS) {
+            noise += (mag - noise) / (acquired - CWDECODER_WINDOW_BLOCKS);
+            signal = noise;
+        }
+        magnitude = mag;
+        return;
+    }
+
+    //
+    // Peak and floor envelopes of the tone magnitude
+    //
+    signal += (mag - signal) * (mag > signal ? ENVELOPE_FAST : ENVELOPE_SLOW);
+    if (!mark) noise += ((mag < 2.0F * noise ? mag : 2.0F * noise) - noise) * ENVELOPE_NOISE;
+
+    high = noise + THRESHOLD_HIGH * (signal - noise);
+    low  = noise + THRESHOLD_LOW  * (signal - noise);
+    if (signal < SQUELCH * noise) {
+        // no signal: force a space
+        high = 3.4e38F;
+        low = 3.4e38F;
+    }
+
+    elapsed += 1.0F;
+    if (!mark && mag > high) {
+        //
+        // Space to mark. Locate the crossing within this block by linear
+        // interpolation, such that timing is not quantized to blocks.
+        //
+        f = (magnitude < high) ? (high - magnitude) / (mag - magnitude) : 0.0F;
+        if (elapsed - 1.0F + f < 2.0F * dit && code > 1) {
+            // space between elements tracks the dit length as well
+            dit += 0.1F * (elapsed - 1.0F + f - dit);
+        }
+        elapsed = 1.0F - f;
+        mark = 1;
+    } else if (mark && mag < low) {
+        f = (magnitude > low) ? (magnitude - low) / (magnitude - mag) : 0.0F;
+        element(elapsed - 1.0F + f);
+        elapsed = 1.0F - f;
+        mark = 0;
+    } else if (!mark) {
+        //
+        // Character space (more than two dits) and word space (more than five)
+        //
+        if (code > 1 && elapsed > 2.0F * dit) {
+            put(code >= 128 ? '*' : morse_tree[code]);
+            code = 1;
+            word_pending = 1;
+            wpm_estimate = 1.2F * AUDIO_SAMPLE_RATE_EXACT / (dit * AUDIO_BLOCK_SAMPLES) + 0.5F;
+        }
+        if (word_pending && elapsed > 5.0F * dit) {
+            put(' ');
+            word_pending = 0;
+        }
+    }
+    magnitude = mag;
+}
+
+void CWDecoder::update(void)
+{
+    audio_block_t *block;
+
+    block = receiveReadOnly(0);
+    if (!block) return;
+
+    if (!enabled) {
+        release(block);
+        return;
+    }
+
+    memcpy(history[slot], block->data, sizeof(history[slot]));
+    release(block);
+    slot = (slot + 1) % CWDECODER_WINDOW_BLOCKS;
+
+    decode(detect());
+}
+
+#endif
@@ -0,0 +1,150 @@
+/* CW decoder for Teensy 4.X
+ * Copyright (c) 2021, kf7o, Steve Haynal, steve@softerhardware.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef CWDecoder_h_
+#define CWDecoder_h_
+
+#include "Arduino.h"
+#include "Audio.h"
+#include "AudioStream.h"
+
+//
+// Number of audio blocks in the tone detector window. With 4 blocks
+// (512 samples, 11.6 msec) the detector bandwidth is about +/- 170 Hz,
+// while the time resolution is still one block (2.9 msec).
+//
+#define CWDECODER_WINDOW_BLOCKS 4
+
+//
+// Streaming CW decoder. Each update() computes the tone magnitude at the
+// decoder frequency over the last CWDECODER_WINDOW_BLOCKS blocks, which
+// is a constant amount of work per block. Decoded characters are queued
+// for loop(), see read().
+//
+class CWDecoder : public AudioStream
+{
+public:
+    CWDecoder() : AudioStream(1, inputQueueArray) {
+        enabled = 0;
+        slot = 0;
+        lo_select = 0;
+        memset(history, 0, sizeof(history));
+        signal = noise = magnitude = 0.0F;
+        acquired = 0;
+        mark = 0;
+        elapsed = 0.0F;
+        code = 1;
+        word_pending = 0;
+        dit = dit_blocks(20);
+        elements = 0;
+        wpm_estimate = 0;
+        char_head = char_tail = 0;
+        dropped_chars = 0;
+        frequency(800.0F);
+    }
+
+    virtual void update(void);
+
+    //
+    // Enable/disable decoding. When disabled, update() just discards the audio.
+    //
+    void enable(uint8_t state) { enabled = state; }
+
+    //
+    // Frequency (Hz) of the CW signal in the RX audio
+    //
+    void frequency(float freq);
+
+    //
+    // Next decoded character (ASCII), or -1 if there is none.
+    // Must only be called from a single context (normally loop()).
+    //
+    int read(void);
+
+    //
+    // Estimated speed of the received signal (words per minute),
+    // zero until the first character has been decoded.
+    //
+    uint8_t wpm(void) { return wpm_estimate; }
+
+    uint32_t updateCycles(void)    { return (uint32_t) cpu_cycles << 6; }
+    uint32_t updateCyclesMax(void) { return (uint32_t) cpu_cycles_max << 6; }
+
+    uint16_t droppedChars(void) { return dropped_chars; }
+
+private:
+    audio_block_t *inputQueueArray[1];
+
+    volatile uint8_t enabled;
+
+    //
+    // Last CWDECODER_WINDOW_BLOCKS blocks of audio, "slot" is the oldest one
+    //
+    int16_t  history[CWDECODER_WINDOW_BLOCKS][AUDIO_BLOCK_SAMPLES] __attribute__ ((aligned (4)));
+    uint8_t  slot;
+
+    //
+    // Windowed local oscillator (cos, sin), as pairs of samples packed
+    // into 32 bits for the dual 16-bit multiply-accumulate. There are two
+    // sets of tables, frequency() fills the one not in use and then
+    // switches lo_select.
+    //
+    static const int LO_LENGTH = CWDECODER_WINDOW_BLOCKS * AUDIO_BLOCK_SAMPLES / 2;
+    uint32_t lo_cos[2][LO_LENGTH];
+    uint32_t lo_sin[2][LO_LENGTH];
+    volatile uint8_t lo_select;
+
+    //
+    // Tone detector and timing state (times in units of audio blocks)
+    //
+    float    signal;        // peak envelope of the tone magnitude
+    float    noise;         // floor envelope of the tone magnitude
+    float    magnitude;     // tone magnitude of the previous block
+    uint8_t  acquired;      // blocks seen while acquiring the noise floor
+    uint8_t  mark;          // tone currently detected
+    float    elapsed;       // time since the last mark/space transition
+    float    dit;           // estimated dit length
+    uint8_t  elements;      // number of elements seen (up to 4)
+    uint8_t  code;          // elements of the current character, after a leading 1
+    uint8_t  word_pending;  // a character has been sent, but no word space yet
+    volatile uint8_t wpm_estimate;
+
+    static float dit_blocks(float wpm) {
+        return 1.2F * AUDIO_SAMPLE_RATE_EXACT / (wpm * AUDIO_BLOCK_SAMPLES);
+    }
+    float detect(void);
+    void decode(float mag);
+    void element(float duration);
+    void put(char c);
+
+    //
+    // Decoded characters are passed from the audio interrupt to loop() through
+    // a lock-free single-producer/single-consumer ring buffer.
+    //
+    static const uint8_t CHAR_QUEUE_LENGTH = 32;  // must be a power of two
+    char              chars[CHAR_QUEUE_LENGTH];
+    volatile uint8_t  char_head;
+    volatile uint8_t  char_tail;
+    uint16_t          dropped_chars;
+};
+
+#endif
@@ -0,0 +1,160 @@
+/* -*- mode: c++; c-basic-offset: 4 -*- */
+/* SofterHardwareCWKeyerShield for Teensy 4.X
+ * Copyright (c) 2021, kf7o, Steve Haynal, steve@softerhardware.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef CWKeyerParameters_h_
+#define CWKeyerParameters_h_
+
+//
+// The MIDI controls (CC) and NRPNs of the keyer. This list is the only place
+// where they are defined: the enums in CWKeyerShield.h, the dispatch tables
+// in CWKeyerShield.cpp and the host side bindings (software/cwkeyer/genparams.py
+// reads this file) are all generated from it. Each line is one of
+//
+//   CC    (name, number, min, max, flags, setter, unit, description)
+//   NRPN  (name, number, min, max, flags, setter, unit, description)
+//   STATUS(name, number, getter, description)
+//   REPORT(name, number, description)
+//
+// setter is a member function of CWKeyerShield called with the number and
+// the value (clamped to min ... max), getter is a member function whose value
+// is sent back (status NRPNs, the value written is ignored). REPORT NRPNs are
+// only sent by the keyer. Flags:
+//
+//   PARAM_BOOL     CC on/off switch: values above 63 are "on", the setter gets 0 or 1
+//   PARAM_PERSIST  setting that is part of the keyer state (to be saved/restored)
+//
+// avoid certain "continuous controllers"
+//
+// No.  0, 32           (Bank select)
+// No.  6, 38, 98--101  (Registered and non-Registered Parameters)
+// No. 88               (High-resolution velocity prefix)
+// No. 96, 97           (Increment/Decrement)
+// No. 120-127          (Channel mode messages)
+//
+#define PARAM_BOOL    0x01
+#define PARAM_PERSIST 0x02
+
+#define CWKEYER_PARAMETERS(CC, NRPN, STATUS, REPORT) \
+    CC    (MIDI_NRPN_CC_MSB,                   99, 0,   127, 0,                         cc_store,                 "",      "NRPN number, high 7 bits") \
+    CC    (MIDI_NRPN_CC_LSB,                   98, 0,   127, 0,                         cc_store,                 "",      "NRPN number, low 7 bits") \
+    CC    (MIDI_NRPN_VAL_MSB,                   6, 0,   127, 0,                         cc_store,                 "",      "NRPN value, high 7 bits") \
+    CC    (MIDI_NRPN_VAL_LSB,                  38, 0,   127, 0,                         cc_nrpn_value,            "",      "NRPN value, low 7 bits, sets the NRPN") \
+    CC    (MIDI_MASTER_VOLUME,                  7, 0,   127, PARAM_PERSIST,             cc_master_volume,         "",      "set master volume") \
+    CC    (MIDI_MASTER_BALANCE,                 8, 0,   127, PARAM_PERSIST,             cc_master_balance,        "",      "stereo balance of RX audio (64 = center)") \
+    CC    (MIDI_MASTER_PAN,                    10, 0,   127, PARAM_PERSIST,             cc_master_pan,            "",      "stereo position of CW tone (64 = center)") \
+    CC    (MIDI_SIDETONE_VOLUME,               12, 0,   127, PARAM_PERSIST,             cc_sidetone_volume,       "",      "set sidetone volume") \
+    CC    (MIDI_SIDETONE_FREQUENCY,            13, 0,   127, 0,                         cc_sidetone_frequency,    "10Hz",  "set sidetone frequency") \
+    CC    (MIDI_INPUT_LEVEL,                   16, 0,   127, 0,                         cc_store,                 "",      "TODO") \
+    CC    (MIDI_ENABLE_POTS,                   64, 0,   127, PARAM_BOOL|PARAM_PERSIST,  cc_enable_pots,           "",      "enable/disable potentiometers") \
+    CC    (MIDI_KEYER_AUTOPTT,                 65, 0,   127, PARAM_BOOL|PARAM_PERSIST,  cc_keyer_autoptt,         "",      "enable/disable auto-PTT from CW keyer") \
+    CC    (MIDI_RESPONSE,                      66, 0,   127, PARAM_BOOL|PARAM_PERSIST,  cc_response,              "",      "enable/disable reporting back to SDR and MIDI controller") \
+    CC    (MIDI_MUTE_CWPTT,                    67, 0,   127, PARAM_BOOL|PARAM_PERSIST,  cc_mute_cwptt,            "",      "enable/disable muting of RX audio during auto-PTT") \
+    CC    (MIDI_MICPTT_HWPTT,                  68, 0,   127, PARAM_BOOL|PARAM_PERSIST,  cc_micptt_hwptt,          "",      "enable/disable that MICIN triggers the hardware PTT output") \
+    CC    (MIDI_CWPTT_HWPTT,                   69, 0,   127, PARAM_BOOL|PARAM_PERSIST,  cc_cwptt_hwptt,           "",      "enable/disable that CWPTT triggers the hardware PTT output") \
+    CC    (MIDI_KEYER_HANG,                    72, 0,   127, PARAM_PERSIST,             cc_keyer_hang,            "dits",  "set Keyer hang time (if auto-PTT active)") \
+    CC    (MIDI_KEYER_LEADIN,                  73, 0,   127, PARAM_PERSIST,             cc_keyer_leadin,          "10ms",  "set Keyer lead-in time (if auto-PTT active)") \
+    CC    (MIDI_CW_SPEED,                      74, 1,   127, PARAM_PERSIST,             cc_cw_speed,              "wpm",   "set CW speed") \
+    CC    (MIDI_INPUT_SELECT,                  75, 0,   127, 0,                         cc_store,                 "",      "TODO") \
+    CC    (MIDI_SET_CHANNEL,                  119, 0,   127, 0,                         cc_store,                 "",      "Change the default channel to use (accepted on any channel)") \
+    STATUS(NRPN_ID_KEYER,                       1,                                      get_id_keyer,                      "identify this keyer for the correspondent") \
+    STATUS(NRPN_ID_VERSION,                     2,                                      get_id_version,                    "identify this keyer version for the correspondent") \
+    STATUS(NRPN_NNRPN,                          3,                                      get_nnrpn,                         "return how many NRPNs are allocated") \
+    NRPN  (NRPN_NRPN_QUERY,                     4, 0, 16383, 0,                         nrpn_query,               "",      "take the value as a nrpn number and send that nrpns value, no response if no value set") \
+    NRPN  (NRPN_NRPN_UNSET,                     5, 0, 16383, 0,                         nrpn_unset,               "",      "take the value as a nrpn number and make that nrpn NRPNV_NOTSET") \
+    STATUS(NRPN_TONE_CYCLES,                    6,                                      get_tone_cycles,                   "return CPU cycles of the last side tone mixer update") \
+    STATUS(NRPN_TONE_CYCLES_MAX,                7,                                      get_tone_cycles_max,               "return max. CPU cycles of a side tone mixer update") \
+    STATUS(NRPN_AUDIO_MEMORY_MAX,               8,                                      get_audio_memory_max,              "return max. number of audio blocks in use") \
+    STATUS(NRPN_AUDIO_ALLOC_FAILURES,           9,                                      get_audio_alloc_failures,          "return number of failed audio block allocations in the side tone mixer") \
+    NRPN  (MIDI_NRPN_WM8960_ENABLE,            11, 0, 16383, PARAM_PERSIST,             nrpn_codec,               "",      "") \
+    NRPN  (MIDI_NRPN_WM8960_INPUT_LEVEL,       12, 0, 16383, PARAM_PERSIST,             nrpn_codec,               "l7r7",  "") \
+    NRPN  (MIDI_NRPN_WM8960_INPUT_SELECT,      13, 0, 16383, PARAM_PERSIST,             nrpn_codec,               "",      "") \
+    NRPN  (MIDI_NRPN_WM8960_VOLUME,            14, 0, 16383, PARAM_PERSIST,             nrpn_codec,               "l7r7",  "") \
+    NRPN  (MIDI_NRPN_WM8960_HEADPHONE_VOLUME,  15, 0, 16383, PARAM_PERSIST,             nrpn_codec,               "l7r7",  "") \
+    NRPN  (MIDI_NRPN_WM8960_HEADPHONE_POWER,   16, 0, 16383, PARAM_PERSIST,             nrpn_codec,               "",      "") \
+    NRPN  (MIDI_NRPN_WM8960_SPEAKER_VOLUME,    17, 0, 16383, PARAM_PERSIST,             nrpn_codec,               "l7r7",  "") \
+    NRPN  (MIDI_NRPN_WM8960_SPEAKER_POWER,     18, 0, 16383, PARAM_PERSIST,             nrpn_codec,               "",      "") \
+    NRPN  (MIDI_NRPN_WM8960_DISABLE_ADCHPF,    19, 0, 16383, PARAM_PERSIST,             nrpn_codec,               "",      "") \
+    NRPN  (MIDI_NRPN_WM8960_ENABLE_MICBIAS,    20, 0, 16383, PARAM_PERSIST,             nrpn_codec,               "",      "") \
+    NRPN  (MIDI_NRPN_WM8960_ENABLE_ALC,        21, 0, 16383, PARAM_PERSIST,             nrpn_codec,               "",      "") \
+    NRPN  (MIDI_NRPN_WM8960_MIC_POWER,         22, 0, 16383, PARAM_PERSIST,             nrpn_codec,               "",      "") \
+    NRPN  (MIDI_NRPN_WM8960_LINEIN_POWER,      23, 0, 16383, PARAM_PERSIST,             nrpn_codec,               "",      "") \
+    NRPN  (MIDI_NRPN_WM8960_RAW_MASK,          24, 0,   511, 0,                         nrpn_codec_raw_mask,      "",      "") \
+    NRPN  (MIDI_NRPN_WM8960_RAW_DATA,          25, 0,   511, 0,                         nrpn_codec_raw_data,      "",      "") \
+    NRPN  (MIDI_NRPN_WM8960_RAW_WRITE,         26, 0,   127, 0,                         nrpn_codec_raw_write,     "",      "register number, +64 to force the write") \
+    NRPN  (MIDI_NRPN_KEYDOWN_NOTE,             27, 0,   255, PARAM_PERSIST,             nrpn_keydown_note,        "",      "MIDI note for key-down (128-255: off)") \
+    NRPN  (MIDI_NRPN_PTT_NOTE,                 28, 0,   255, PARAM_PERSIST,             nrpn_ptt_note,            "",      "MIDI note for PTT (128-255: off)") \
+    NRPN  (MIDI_NRPN_WINDOW_SHAPE,             29, 0,     2, PARAM_PERSIST,             nrpn_window_shape,        "",      "shape of the keying ramp (enum window_shape)") \
+    NRPN  (MIDI_NRPN_WINDOW_RISETIME,          30, 2,     6, PARAM_PERSIST,             nrpn_window_risetime,     "ms",    "rise time of the keying ramp") \
+    NRPN  (MIDI_NRPN_SIDETONE_FREQUENCY,       31, 0,  5000, PARAM_PERSIST,             nrpn_sidetone_frequency,  "Hz",    "set sidetone frequency") \
+    STATUS(NRPN_CODEC_QUEUE_DEPTH,             32,                                      get_codec_queue_depth,             "return number of pending codec commands") \
+    STATUS(NRPN_CODEC_TIME,                    33,                                      get_codec_time,                    "return codec (I2C) time in the last loop() (micro-seconds)") \
+    STATUS(NRPN_CODEC_TIME_MAX,                34,                                      get_codec_time_max,                "return max. codec (I2C) time in a loop() (micro-seconds)") \
+    NRPN  (MIDI_NRPN_DUCK_DEPTH,               35, 0,   100, PARAM_PERSIST,             nrpn_duck_depth,          "dB",    "RX audio attenuation during PTT (100 means full mute)") \
+    NRPN  (MIDI_NRPN_DUCK_ATTACK,              36, 0,   100, PARAM_PERSIST,             nrpn_duck_attack,         "ms",    "RX audio ducking attack time") \
+    NRPN  (MIDI_NRPN_DUCK_RELEASE,             37, 0,   100, PARAM_PERSIST,             nrpn_duck_release,        "ms",    "RX audio ducking release time") \
+    NRPN  (MIDI_NRPN_DECODER_ENABLE,           38, 0,     1, PARAM_PERSIST,             nrpn_decoder_enable,      "",      "enable/disable the CW decoder on the RX audio") \
+    NRPN  (MIDI_NRPN_DECODER_FREQUENCY,        39, 100, 3000, PARAM_PERSIST,            nrpn_decoder_frequency,   "Hz",    "set CW decoder frequency") \
+    REPORT(NRPN_DECODER_CHAR,                  40,                                                                         "character decoded from the RX audio (ASCII)") \
+    REPORT(NRPN_DECODER_WPM,                   41,                                                                         "estimated speed of the RX signal") \
+    STATUS(NRPN_DECODER_CYCLES_MAX,            42,                                      get_decoder_cycles_max,            "return max. CPU cycles of a CW decoder update") \
+    NRPN  (MIDI_NRPN_RX_FILTER_BANDWIDTH,      43, 0,  1000, PARAM_PERSIST,             nrpn_rx_filter_bandwidth, "Hz",    "RX audio CW filter bandwidth (0 = off)") \
+    STATUS(NRPN_RX_FILTER_CYCLES_MAX,          44,                                      get_rx_filter_cycles_max,          "return max. CPU cycles of the RX audio CW filter per block") \
+    NRPN  (MIDI_NRPN_VOX_ENABLE,               45, 0,     1, PARAM_PERSIST,             nrpn_vox_enable,          "",      "enable/disable VOX on the microphone audio") \
+    NRPN  (MIDI_NRPN_VOX_THRESHOLD,            46, 0,   100, PARAM_PERSIST,             nrpn_vox_threshold,       "-dBFS", "VOX threshold") \
+    NRPN  (MIDI_NRPN_VOX_ATTACK,               47, 0,  1000, PARAM_PERSIST,             nrpn_vox_attack,          "ms",    "VOX attack time") \
+    NRPN  (MIDI_NRPN_VOX_HOLD,                 48, 0, 10000, PARAM_PERSIST,             nrpn_vox_hold,            "ms",    "VOX hold time") \
+    NRPN  (MIDI_NRPN_VOX_ANTIVOX,              49, 0,   100, PARAM_PERSIST,             nrpn_vox_antivox,         "dB",    "anti-VOX: attenuation of the RX level added to the threshold (100 means off)") \
+    STATUS(NRPN_MIDI_DROPPED,                  50,                                      get_midi_dropped,                  "return number of MIDI control changes dropped (queue full)") \
+    STATUS(NRPN_MIDI_DEFERRED,                 51,                                      get_midi_deferred,                 "return number of MIDI control changes executed in a later loop()") \
+    STATUS(NRPN_MIDI_LATE,                     52,                                      get_midi_late,                     "return number of MIDI control changes executed more than 10 msec late") \
+    NRPN  (MIDI_NRPN_MIDI_CC_INTERVAL,         53, 0,  1000, PARAM_PERSIST,             nrpn_midi_cc_interval,    "ms",    "min. interval between control change responses") \
+    STATUS(NRPN_MIDI_OUT_QUEUE_DEPTH,          54,                                      get_midi_out_queue_depth,          "return number of pending control change responses") \
+    STATUS(NRPN_MIDI_OUT_LATENCY,              55,                                      get_midi_out_latency,              "return latency of the last control change response (micro-seconds)") \
+    STATUS(NRPN_MIDI_OUT_LATENCY_MAX,          56,                                      get_midi_out_latency_max,          "return max. latency of a control change response (micro-seconds)") \
+    STATUS(NRPN_MIDI_CC_CYCLES,                57,                                      get_midi_cc_cycles,                "return CPU cycles spent on the last MIDI control change") \
+    STATUS(NRPN_MIDI_CC_CYCLES_MAX,            58,                                      get_midi_cc_cycles_max,            "return max. CPU cycles spent on a MIDI control change") \
+    NRPN  (MIDI_NRPN_SUBSCRIBE,                59, 0,   256, 0,                         nrpn_subscribe,           "",      "report changes of a control (0-127) or NRPN (128 + number) with SYSEX_REPORT, 256 = all persistent ones") \
+    NRPN  (MIDI_NRPN_UNSUBSCRIBE,              60, 0,   256, 0,                         nrpn_unsubscribe,         "",      "stop reporting a control (0-127) or NRPN (128 + number), 256 = all") \
+    NRPN  (MIDI_NRPN_RESYNC,                   61, 0, 16383, 0,                         nrpn_resync,              "",      "take the value as the last report sequence number received, report everything subscribed that changed since") \
+    STATUS(NRPN_REPORT_SEQUENCE,               62,                                      get_report_sequence,               "return sequence number of the last SYSEX_REPORT") \
+    NRPN  (MIDI_NRPN_PERSIST_CLEAR,            63, 0,     1, 0,                         nrpn_persist_clear,       "",      "forget the saved settings, the next startup uses the defaults") \
+    STATUS(NRPN_PERSIST_WRITES,                64,                                      get_persist_writes,                "return number of settings records written to EEPROM since startup") \
+    STATUS(NRPN_PERSIST_TIME_MAX,              65,                                      get_persist_time_max,              "return max. EEPROM write time in a loop() (micro-seconds)") \
+    NRPN  (MIDI_NRPN_BOOT_TIMELINE,            66, 0,    15, 0,                         nrpn_boot_timeline,       "",      "take the value as a startup stage (enum setup_stage), report the time it was completed") \
+    REPORT(NRPN_BOOT_TIME_HIGH,                67,                                                                         "time a startup stage was completed (micro-seconds since reset), upper 14 bits") \
+    REPORT(NRPN_BOOT_TIME_LOW,                 68,                                                                         "time a startup stage was completed (micro-seconds since reset), lower 14 bits") \
+    STATUS(NRPN_BOOT_STAGE,                    69,                                      get_boot_stage,                    "return the startup stage to be executed next (enum setup_stage, SETUP_DONE when complete)") \
+    NRPN  (MIDI_NRPN_TIMESTAMPS,               70, 0,     1, 0,                         nrpn_timestamps,          "",      "enable/disable SYSEX_EVENT after key and PTT notes, and periodic SYSEX_CLOCK") \
+    NRPN  (MIDI_NRPN_CLOCK_INTERVAL,           71, 100, 10000, 0,                       nrpn_clock_interval,      "ms",    "time between periodic SYSEX_CLOCK messages") \
+    NRPN  (MIDI_NRPN_PLAYOUT_DELAY,            72, 0,  1000, PARAM_PERSIST,             nrpn_playout_delay,       "ms",    "delay of host keying (key notes and SYSEX_KEY) in the playout buffer, 0 = key notes immediately") \
+    STATUS(NRPN_PLAYOUT_DEPTH,                 73,                                      get_playout_depth,                 "return number of key transitions waiting in the playout buffer") \
+    STATUS(NRPN_PLAYOUT_DEPTH_MAX,             74,                                      get_playout_depth_max,             "return max. number of key transitions in the playout buffer") \
+    STATUS(NRPN_PLAYOUT_LATE,                  75,                                      get_playout_late,                  "return number of key transitions that arrived after their playout time") \
+    STATUS(NRPN_PLAYOUT_DROPPED,               76,                                      get_playout_dropped,               "return number of key transitions dropped (playout buffer full)") \
+    NRPN  (MIDI_NRPN_PTT_DEBOUNCE,             77, 0,   100, PARAM_PERSIST,             nrpn_ptt_debounce,        "ms",    "PTT-in de-bouncing: edges within this time after an accepted edge are ignored") \
+    NRPN  (MIDI_NRPN_PTT_LATENCY_BIN,          78, 0,    15, 0,                         nrpn_ptt_latency_bin,     "",      "take the value as a bin n of the PTT-out latency histogram, report its count") \
+    REPORT(NRPN_PTT_LATENCY_COUNT,             79,                                                                         "number of PTT-in edges that reached PTT-out within 2^n ... 2^(n+1)-1 CPU cycles") \
+    STATUS(NRPN_PTT_BOUNCES,                   80,                                      get_ptt_bounces,                   "return number of PTT-in edges ignored by de-bouncing") \
+    STATUS(NRPN_PTT_MIDI_LATENCY_MAX,          81,                                      get_ptt_midi_latency_max,          "return max. time from a PTT-in edge to the MIDI PTT note (micro-seconds)")
+
+#endif
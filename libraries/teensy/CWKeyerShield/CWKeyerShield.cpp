@@ -30,19 +30,38 @@
 #ifndef __AVR__
 
 #include <Arduino.h>
+#include <EEPROM.h>
 #include "CWKeyerShield.h"
 
+namespace {
+
+CWKeyerShield *ptt_owner = NULL;    // there is only one PTT-in line, see ptt_isr()
+
+} // namespace
+
+//
+// setup() only does what is needed for keying: audio memory, I/O lines and
+// the side tone. Everything slow, in particular the codec (I2C), is done
+// afterwards by setup_service(), one stage per loop() pass, so key() and
+// the MIDI key notes work within milliseconds after startup.
+//
 void CWKeyerShield::setup(void)
 {
-    AudioMemory(32);
-    AudioNoInterrupts();
+    setup_time[SETUP_START] = micros();
+
+    AudioMemory(CWKEYER_AUDIO_MEMORY);
 
     if (Pin_SideToneFrequency >= 0) pinMode(Pin_SideToneFrequency, INPUT);
     if (Pin_SideToneVolume    >= 0) pinMode(Pin_SideToneVolume,    INPUT);
     if (Pin_MasterVolume      >= 0) pinMode(Pin_MasterVolume,      INPUT);
     if (Pin_Speed             >= 0) pinMode(Pin_Speed,             INPUT);
 
-    if (Pin_PTTin             >= 0) pinMode(Pin_PTTin,             INPUT_PULLUP);
+    if (Pin_PTTin             >= 0) {
+      pinMode(Pin_PTTin,             INPUT_PULLUP);
+      nrpn_ptt_debounce(MIDI_NRPN_PTT_DEBOUNCE, ptt_debounce);
+      ptt_owner = this;
+      attachInterrupt(digitalPinToInterrupt(Pin_PTTin), ptt_isr, CHANGE);
+    }
     if (Pin_PTTout            >= 0) {
       pinMode(Pin_PTTout,            OUTPUT);
       digitalWrite(Pin_PTTout, 0);
@@ -56,198 +75,532 @@ void CWKeyerShield::setup(void)
     // The following settings will probably very soon be overwritten,
     // but let us start with some 'safe' values
     //
+    AudioNoInterrupts();
+    teensyaudiotone.frequency(800.0F);
+    teensyaudiotone.amplitude(0.4F);
+    duck();
+    vox_setup();
 
-    sine.frequency(800.0F);
-    sidetonelevel_target=0.4F;
-    sidetonelevel_actual=0.4F;
-    sine.amplitude(sidetonelevel_actual);
+    //
+    // The master volume is set on the codec, see mastervolume(). The
+    // digital master gain of teensyaudiotone is at unity, except while
+    // a change is ramped before it is handed over to the codec.
+    //
+    teensyaudiotone.volume(1.0F);
+    AudioInterrupts();
+    setup_time[SETUP_AUDIO] = micros();
 
-    masterlevel_actual=0.8F;
-    masterlevel_target=0.8F;
-    if (wm8960) {
-      wm8960->enable();
-      wm8960->volume(masterlevel_actual);
-      wm8960->inputSelect(0);               // 0 = Mic, 1 = LineIn
-      wm8960->enableMicBias(1);
-      //
-      // DL1YCF comment start
-      // ====================
-      //
-      // Note the level scale is logarithmic. For the mic input jack (left channel)
-      // I have measured the input voltage corresponding to full scale input
-      // (beyond that, clipping sets in)
-      //
-      //   Level       Vpp (mV)    Vrms(mV)  dBV
-      //   -------------------------------------
-      //    0.0         850         300      - 9
-      //    0.3         160          57      -25
-      //    0.4          95          34      -29
-      //    0.5          50          18      -35
-      //    0.6          31          11      -39
-      //    0.7          17           6      -44
-      //
-      // so the empirical formula for a full-scale signal (in dBV) is
-      // dBV = -10 -50*level
-      //
-      // Typical input levels are
-      //
-      // Dynamic Microphone : Vpp =    5 mV,  -55 dBV  ==> Level = 0.9
-      // Electret Microphone: Vpp =   50 mV,  -35 dBV  ==> Level = 0.5
-      // Line level:          Vpp =  900 mV   -10 dBV  ==> Level = 0.0
-      //
-      // so with a value of the input level between 0.0 and 1.0, one can cover the whole
-      // range from dynamic microphones to line levels (these may occur if using an
-      // external microphone pre-amp). A resonable default seems to be 0.5, but if you
-      // either connect a dynamic microphone or a line level source you either need
-      // to re-compile your KeyerShield firmware or use MIDI comands top re-adjust the level.
-      //
-      // Whereas the microphone jack only connects to the left audio channel, the
-      // signal of the built-in MEMS microphone goes to the right audio channel. My
-      // preliminary experiments indicate that a "level" value of about 0.6 is just fine
-      // here, since I do not expect people are holding the KeyerShield in their hands
-      // and place it just before their mouth!
-      //
-      // An API in which one can switch between MEMS and MIC such that the chosen signal
-      // (occurs on both channels) my be preferred, but then you need to adapt
-      // control_wm8960.cpp in the Audio library. This applies in particular when using
-      // the Mic input signal, in this case one certainly does not want MEMS signals.
-      //
-      // Perhaps one should implement a possibility to "switch" between the left and right
-      // channel in the sense that the "chosen" signal occurs in both channels.
-      //
-      // DL1YCF comment end
-      // ==================
-      //
-      wm8960->inputLevel(0.5F, 0.6F);     // volume control for mic input (both mic and MEMS)
-    }
-    if (sgtl5000) {
-      sgtl5000->enable();
-      sgtl5000->volume(masterlevel_actual);
-      // Note that this sets the Mic Bias voltage to 3.0 Volt and the Mic Bias
-      // output impedance to 2 kOhm, and this is "hard-wired" into control_sgtl5000
-      // in the audio library.
-      sgtl5000->inputSelect(AUDIO_INPUT_MIC);
-      // The default microphone setting is 52 dB (40 dB preamp and 12 dB line-gain),
-      // the correct value depends on the microphone but here we use some 12 dB less
-      sgtl5000->micGain(40);
-    }
+    persist_restore();
+    setup_stage = SETUP_RESTORE;
+}
 
-    AudioInterrupts();
+void CWKeyerShield::setup_service(void)
+{
+    switch (setup_stage) {
+    case SETUP_RESTORE:
+        //
+        // The settings persist_restore() has read in setup()
+        //
+        persist_apply();
+        break;
+
+    case SETUP_CODEC_ENABLE:
+        if (wm8960) wm8960->enable();
+        if (sgtl5000) sgtl5000->enable();
+        break;
+
+    case SETUP_CODEC_INPUT:
+        if (wm8960) {
+            wm8960->inputSelect(0);               // 0 = Mic, 1 = LineIn
+            wm8960->enableMicBias(1);
+        }
+        if (sgtl5000) {
+            // Note that this sets the Mic Bias voltage to 3.0 Volt and the Mic Bias
+            // output impedance to 2 kOhm, and this is "hard-wired" into control_sgtl5000
+            // in the audio library.
+            sgtl5000->inputSelect(AUDIO_INPUT_MIC);
+        }
+        break;
+
+    case SETUP_CODEC_LEVEL:
+        if (wm8960) {
+            //
+            // DL1YCF comment start
+            // ====================
+            //
+            // Note the level scale is logarithmic. For the mic input jack (left channel)
+            // I have measured the input voltage corresponding to full scale input
+            // (beyond that, clipping sets in)
+            //
+            //   Level       Vpp (mV)    Vrms(mV)  dBV
+            //   -------------------------------------
+            //    0.0         850         300      - 9
+            //    0.3         160          57      -25
+            //    0.4          95          34      -29
+            //    0.5          50          18      -35
+            //    0.6          31          11      -39
+            //    0.7          17           6      -44
+            //
+            // so the empirical formula for a full-scale signal (in dBV) is
+            // dBV = -10 -50*level
+            //
+            // Typical input levels are
+            //
+            // Dynamic Microphone : Vpp =    5 mV,  -55 dBV  ==> Level = 0.9
+            // Electret Microphone: Vpp =   50 mV,  -35 dBV  ==> Level = 0.5
+            // Line level:          Vpp =  900 mV   -10 dBV  ==> Level = 0.0
+            //
+            // so with a value of the input level between 0.0 and 1.0, one can cover the whole
+            // range from dynamic microphones to line levels (these may occur if using an
+            // external microphone pre-amp). A resonable default seems to be 0.5, but if you
+            // either connect a dynamic microphone or a line level source you either need
+            // to re-compile your KeyerShield firmware or use MIDI comands top re-adjust the level.
+            //
+            // Whereas the microphone jack only connects to the left audio channel, the
+            // signal of the built-in MEMS microphone goes to the right audio channel. My
+            // preliminary experiments indicate that a "level" value of about 0.6 is just fine
+            // here, since I do not expect people are holding the KeyerShield in their hands
+            // and place it just before their mouth!
+            //
+            // An API in which one can switch between MEMS and MIC such that the chosen signal
+            // (occurs on both channels) my be preferred, but then you need to adapt
+            // control_wm8960.cpp in the Audio library. This applies in particular when using
+            // the Mic input signal, in this case one certainly does not want MEMS signals.
+            //
+            // Perhaps one should implement a possibility to "switch" between the left and right
+            // channel in the sense that the "chosen" signal occurs in both channels.
+            //
+            // DL1YCF comment end
+            // ==================
+            //
+            wm8960->inputLevel(0.5F, 0.6F);     // volume control for mic input (both mic and MEMS)
+        }
+        if (sgtl5000) {
+            // The default microphone setting is 52 dB (40 dB preamp and 12 dB line-gain),
+            // the correct value depends on the microphone but here we use some 12 dB less
+            sgtl5000->micGain(40);
+        }
+        break;
+
+    case SETUP_ADC:
+        //
+        // The pots are low-pass filtered after the conversion as well,
+        // so less hardware averaging is needed than for a single analogRead()
+        //
+        analogReadRes(12);
+        analogReadAveraging(16);
+        if (Pin_MasterVolume >= 0 || Pin_SideToneVolume >= 0 || Pin_SideToneFrequency >= 0 || Pin_Speed >= 0) {
+            const int pins[TeensyPots::NPOTS] = {Pin_MasterVolume, Pin_SideToneVolume, Pin_SideToneFrequency, Pin_Speed};
+            potscan.begin(pins);
+        }
+        break;
+
+    case SETUP_CODEC_VOLUME:
+        //
+        // Last, so the restored master volume is written only once
+        //
+        codec_volume(master_level);
+        master_codec   = master_level;
+        master_pending = false;
+        break;
 
-    analogReadRes(12);
-    analogReadAveraging(40);
+    default:
+        return;
+    }
+    setup_time[setup_stage] = micros();
+    setup_stage++;
+}
 
+void CWKeyerShield::nrpn_boot_timeline(int16_t num, int16_t value)
+{
+    uint32_t t = (value < SETUP_DONE) ? setup_time[value] : 0;
+
+    nrpn_report(NRPN_BOOT_TIME_HIGH, (t >> 14) & 0x3fff);
+    nrpn_report(NRPN_BOOT_TIME_LOW,  t & 0x3fff);
 }
 
 void CWKeyerShield::loop(void)
 {
-    if (enable_pots) { pots(); }
+    if (setup_stage < SETUP_DONE) setup_service();
+    if (enable_pots && setup_stage == SETUP_DONE) { pots(); }
     monitor_ptt();
     midi();
-    adjust();
-}
-
-void CWKeyerShield::adjust(void)
-{
-    //
-    // There were audible cracks in the side tone if the side
-    // tone volume was changed. Therefore we only define
-    // the target value when setting the sidetone or the master
-    // volume, and here we slowly approach this value
-    //
-    unsigned long now=millis();
-    int update;
-    if (now > last_adjust) {
-      last_adjust=now;
-
-      update=0;
-      if (sidetonelevel_actual < sidetonelevel_target - 0.01F) {
-        sidetonelevel_actual += 0.001F;
-        update=1;
-      } else if (sidetonelevel_actual < sidetonelevel_target - 0.001F) {
-        sidetonelevel_actual += 0.0005F;
-        update=1;
-      } else if (sidetonelevel_actual > sidetonelevel_target + 0.01F) {
-        sidetonelevel_actual -= 0.001F;
-        update=1;
-      } else if (sidetonelevel_actual > sidetonelevel_target + 0.001F) {
-        sidetonelevel_actual -= 0.0005F;
-        update=1;
-      }
-      if (update) sine.amplitude(sidetonelevel_actual);
+    playout_service();
+    midi_out_service();
+    report_service();
+    clock_service();
+    persist_service();
+    codec_service();
+    decoder_service();
+}
 
-      //
-      // Note that depending on the "granularity" of volume
-      // control in the hardware, this may offer little
-      // improvement
-      //
-      update=0;
-      if (masterlevel_actual < masterlevel_target - 0.01F) {
-        masterlevel_actual += 0.001F;
-        update=1;
-      } else if (masterlevel_actual < masterlevel_target - 0.001F) {
-        masterlevel_actual += 0.0005F;
-        update=1;
-      } else if (masterlevel_actual > masterlevel_target + 0.01F) {
-        masterlevel_actual -= 0.001F;
-        update=1;
-      } else if (masterlevel_actual > masterlevel_target + 0.001F) {
-        masterlevel_actual -= 0.0005F;
-        update=1;
-      } 
-      if (update) {
-        if (sgtl5000) {
-          sgtl5000->volume(masterlevel_actual);
-        }
-        if (wm8960) {
-          wm8960->volume(masterlevel_actual);
-        }
-      }
+void CWKeyerShield::decoder_service(void)
+{
+    //
+    // Send characters decoded from the RX audio, and the speed
+    // estimate whenever it changes
+    //
+    int c;
+
+    if (midi_channel == 0) return;
+    while ((c = cwdecoder.read()) >= 0) {
+        nrpn_report(NRPN_DECODER_CHAR, c);
+    }
+    if (cwdecoder.wpm() != decoder_wpm) {
+        decoder_wpm = cwdecoder.wpm();
+        nrpn_report(NRPN_DECODER_WPM, decoder_wpm);
     }
 }
 
 void CWKeyerShield::monitor_ptt(void)
 {
     //
-    // do a de-bouncing read of the ptt digital input
-    // combine this with the cwptt flag
+    // combine the de-bounced PTT-in state (see ptt_isr()) with the
+    // VOX and the cwptt flag,
     // if PTT status changed, send PTT MIDI message
     // and toggle status of hardware PTT out
     //
-    unsigned long now=millis();
+    uint8_t  pending;
+    uint32_t edge;
     int val;
 
-    if (now > (last_ptt_read + 10) && (Pin_PTTin >= 0)) {
-      val=!digitalRead(Pin_PTTin);         // input is active-low
-      if (val != last_ptt_in) {
-        last_ptt_in=val;
-        last_ptt_read = now;               // used for debouncing
-      }
+    //
+    // An edge ignored by de-bouncing may have been the last one, take
+    // the level of the line once the de-bouncing time has passed
+    //
+    __disable_irq();
+    if (Pin_PTTin >= 0 && ARM_DWT_CYCCNT - ptt_raw_cycles >= ptt_debounce_cycles) {
+      val = !digitalReadFast(Pin_PTTin);   // input is active-low
+      if (val != ptt_in_state) ptt_accept(val, ptt_raw_cycles, false);
     }
-    val  = (last_ptt_in | cwptt_state) ? 1 : 0;
+    pending = ptt_edge_pending;
+    edge = ptt_edge_cycles;
+    ptt_edge_pending = 0;
+    __enable_irq();
+
+    //
+    // The VOX is not de-bounced here, it has its own hold time
+    //
+    vox_state = vox.ptt();
+    val  = (ptt_in_state | vox_state | cwptt_state) ? 1 : 0;
     if (val != midiptt_state) {
+      unsigned long now = micros();
+      unsigned long latency = 0;
+
+      if (pending) {
+        latency = (ARM_DWT_CYCCNT - edge) / (F_CPU_ACTUAL / 1000000);
+        if (latency > ptt_midi_latency_max) ptt_midi_latency_max = latency;
+      }
       midiptt_state = val;
-      midiptt(val);
+      midiptt_send(val, now - latency);
     }
     //
     // if micptt_hwptt is not set, this suppresses signalling
-    // the PTT-in state to the PTT-out line, but MIDI PTT
+    // the PTT-in (or VOX) state to the PTT-out line, but MIDI PTT
     // reporting should still occur.
     //
     // if cwptt_hwptt is not set, this suppresses signalling
     // the cwptt state to the PTT-out line, but MIDI PTT
     // reporting should still occur
     //
+    // PTT-in edges normally reach the PTT-out line in ptt_isr() already.
     //
-    val = ((last_ptt_in & micptt_hwptt) | (cwptt_state & cwptt_hwptt)) ? 1 : 0;
+    __disable_irq();
+    val = (((ptt_in_state | vox_state) & micptt_hwptt) | (cwptt_state & cwptt_hwptt)) ? 1 : 0;
     if (val != hwptt_state) {
       hwptt_state = val;
       hwptt(val);
     }
+    __enable_irq();
 }
 
+//
+// PTT-in edges are taken by an interrupt, so that the PTT-out line follows
+// within microseconds, no matter how long a loop() pass takes. The first
+// edge is taken right away, further edges within the de-bouncing time
+// are ignored (and monitor_ptt() takes the final level of the line once
+// the de-bouncing time is over).
+//
+void CWKeyerShield::ptt_isr(void)
+{
+    CWKeyerShield *k = ptt_owner;
+    uint32_t now = ARM_DWT_CYCCNT;
+    uint8_t  state = !digitalReadFast(k->Pin_PTTin);     // input is active-low
+
+    k->ptt_raw_cycles = now;
+    if (state == k->ptt_in_state) return;
+    if (now - k->ptt_edge_cycles < k->ptt_debounce_cycles) {
+        k->ptt_bounces++;
+        return;
+    }
+    k->ptt_accept(state, now, true);
+}
+
+void CWKeyerShield::ptt_accept(uint8_t state, uint32_t edge, bool isr)
+{
+    //
+    // Called from ptt_isr() (isr set), or with interrupts disabled from
+    // monitor_ptt(). Only edges taken in the interrupt go into the latency
+    // histogram: from monitor_ptt(), the latency includes the de-bouncing
+    // time and the loop() period.
+    //
+    ptt_in_state = state;
+    ptt_edge_cycles = edge;
+    ptt_edge_pending = 1;
+    if (micptt_hwptt) {
+        uint8_t val = (state | vox_state | (cwptt_state & cwptt_hwptt)) ? 1 : 0;
+        if (val != hwptt_state) {
+            hwptt_state = val;
+            hwptt(val);
+            if (isr) {
+                uint32_t latency = ARM_DWT_CYCCNT - edge;
+                uint8_t bin = 0;
+                while (bin < PTT_LATENCY_BINS - 1 && (latency >> (bin + 1))) bin++;
+                ptt_latency_hist[bin]++;
+            }
+        }
+    }
+}
+
+//
+// Codec writes are not executed when they arrive, since each of them
+// is a blocking I2C transaction. They are queued, and codec_service()
+// executes at most one of them per loop() pass: the master volume
+// handover (on either codec, see master_service()), the WM8960 commands,
+// and raw WM8960 register writes.
+//
+// There is one pending slot per command, so repeated commands (e.g. from
+// a volume slider) merge into one. Raw register writes are merged per
+// register. Writes are checked against a shadow of the codec registers,
+// the value last written per register:
+//  - a raw write is dropped if its bits are known to hold the value already
+//    (unless forced),
+//  - the commands write through the audio library, so their register
+//    values are not known: a command is dropped if it would repeat the
+//    value it last wrote, and none of its registers has been written since,
+//  - the master volume is dropped if it would write the same volume step.
+// A write forgets the shadow of the other writes that share a register
+// with it (codec_regs[]).
+//
+void CWKeyerShield::codec_queue(const int16_t nrpn, const int16_t value)
+{
+    int i = nrpn - MIDI_NRPN_WM8960_ENABLE;
+
+    if (!wm8960) return;
+    if (codec_shadow[i] == value) {
+        codec_pending[i] = NRPNV_NOTSET;  // back to what has been written
+    } else {
+        codec_pending[i] = value;
+    }
+}
 
-void CWKeyerShield::process_nrpn(const int16_t nrpn_cc, const int16_t nrpn_val)
+void CWKeyerShield::codec_queue_raw(const int16_t reg, const int16_t data, const int16_t mask, const bool force)
+{
+    codec_raw_data[reg]  = (codec_raw_data[reg] & ~mask) | (data & mask);
+    codec_raw_mask[reg] |= mask;
+    if (force) codec_raw_force |= (1ULL << reg);
+    codec_raw_pending |= (1ULL << reg);
+}
+
+int CWKeyerShield::codec_queue_depth(void)
+{
+    int depth = __builtin_popcountll(codec_raw_pending) + master_pending;
+
+    for (int i = 0; i < NCODEC; i++) {
+        if (codec_pending[i] != NRPNV_NOTSET) depth++;
+    }
+    return depth;
+}
+
+//
+// WM8960 registers written by each command (by the audio library),
+// indexed like codec_pending[]. Where in doubt, a register is included.
+//
+#define R(n) (1ULL << (n))
+const uint64_t CWKeyerShield::codec_regs[NCODEC] = {
+    ~0ULL,                                                  // enable (resets the codec)
+    R(0) | R(1) | R(32) | R(33),                            // input level
+    R(0) | R(1) | R(25) | R(32) | R(33) | R(43) | R(44) | R(47),  // input select
+    CODEC_VOLUME_REGS,                                      // volume
+    CODEC_VOLUME_REGS,                                      // headphone volume
+    R(25) | R(26) | R(47),                                  // headphone power
+    R(40) | R(41),                                          // speaker volume
+    R(26) | R(47) | R(49) | R(51),                          // speaker power
+    R(5),                                                   // disable ADC high pass
+    R(25),                                                  // enable mic bias
+    R(17) | R(18) | R(19) | R(20),                          // enable ALC
+    R(25) | R(32) | R(33) | R(47),                          // mic power
+    R(25) | R(43) | R(44) | R(45) | R(46) | R(47),          // line in power
+};
+#undef R
+
+//
+// Registers have been written by the command "cmd" (-1: not a command):
+// forget what the shadow knows about them
+//
+void CWKeyerShield::codec_touched(uint64_t regs, int cmd)
+{
+    for (int i = 0; i < NCODEC; i++) {
+        if (i != cmd && (codec_regs[i] & regs)) codec_shadow[i] = NRPNV_NOTSET;
+    }
+    for (int reg = 0; reg < 64; reg++) {
+        if (regs & (1ULL << reg)) codec_reg_known[reg] = 0;
+    }
+    if (regs & CODEC_VOLUME_REGS) codec_volume_step = -1;
+}
+
+//
+// Set the master volume on the codec, unless it has that step already
+//
+void CWKeyerShield::codec_volume(float level)
+{
+    int step = codec_step(level);
+
+    if (step == codec_volume_step) return;
+    if (wm8960) {
+        wm8960->volume(level);
+        codec_touched(CODEC_VOLUME_REGS, -1);
+    }
+    if (sgtl5000) sgtl5000->volume(level);
+    codec_volume_step = step;
+}
+
+void CWKeyerShield::codec_service(void)
+{
+    unsigned long start = micros();
+    int i;
+
+    // the codec is not ready before setup_service() is done
+    if (setup_stage != SETUP_DONE) return;
+
+    if (master_handover ? (micros() - master_handover_start >= MASTER_HANDOVER_US)
+                        : (master_pending && teensyaudiotone.volumeSettled())) {
+        master_service();
+    } else {
+        for (i = 0; i < NCODEC; i++) {
+            if (codec_pending[i] != NRPNV_NOTSET) {
+                codec_execute(MIDI_NRPN_WM8960_ENABLE + i, codec_pending[i]);
+                codec_touched(codec_regs[i], i);
+                codec_shadow[i]  = codec_pending[i];
+                codec_pending[i] = NRPNV_NOTSET;
+                break;
+            }
+        }
+        if (i == NCODEC && codec_raw_pending) {
+            int reg = __builtin_ctzll(codec_raw_pending);
+            uint16_t mask = codec_raw_mask[reg];
+            uint16_t data = codec_raw_data[reg] & mask;
+            bool force = (codec_raw_force & (1ULL << reg)) != 0;
+
+            codec_raw_pending &= ~(1ULL << reg);
+            codec_raw_force   &= ~(1ULL << reg);
+            codec_raw_mask[reg] = 0;
+            if (force || (codec_reg_known[reg] & mask) != mask || ((codec_reg[reg] ^ data) & mask)) {
+                uint16_t known = codec_reg_known[reg];
+                wm8960->write(reg, data, mask, force);
+                codec_touched(1ULL << reg, -1);
+                codec_reg[reg]       = (codec_reg[reg] & ~mask) | data;
+                codec_reg_known[reg] = known | mask;
+            }
+        }
+    }
+
+    codec_time = micros() - start;
+    if (codec_time > codec_time_max) codec_time_max = codec_time;
+}
+
+//
+// Headphone volume step of a codec master volume setting, as the audio
+// library maps the level to the register: WM8960 in 1 dB steps (0x7F:
+// +6 dB, 0x2F and below: mute), SGTL5000 in 0.5 dB steps (0x80 - m,
+// m = 128: +12 dB, m = 0: mute). codec_gain() is its linear gain.
+//
+int CWKeyerShield::codec_step(float level)
+{
+    int m;
+
+    if (wm8960) return level * 80.0F + 47.499F;
+    if (sgtl5000) {
+        m = level * 129.0F + 0.499F;
+        return (m > 128) ? 128 : m;
+    }
+    return 0;
+}
+
+float CWKeyerShield::codec_gain(float level)
+{
+    int m = codec_step(level);
+
+    if (wm8960) return (m <= 0x2F) ? 0.0F : powf(10.0F, (m - 0x79) / 20.0F);
+    if (sgtl5000) return (m == 0) ? 0.0F : powf(10.0F, (0.5F * m - 52.0F) / 20.0F);
+    return 1.0F;
+}
+
+//
+// Ramp the digital master gain towards the requested master volume,
+// relative to the volume on the codec. It never goes above unity, so
+// an increase is not heard before the handover.
+//
+void CWKeyerShield::master_ramp(void)
+{
+    float gc = codec_gain(master_codec);
+    float gl = codec_gain(master_level);
+
+    if (codec_step(master_level) == codec_step(master_codec)) {
+        master_gain    = 1.0F;
+        master_pending = false;
+    } else {
+        master_gain = (gl < gc) ? gl / gc : 1.0F;
+    }
+    teensyaudiotone.volume(master_gain);
+}
+
+//
+// Hand the master volume over from the digital gain to the codec, once
+// the ramp has settled (called by codec_service()). The codec and the digital gain change in opposite
+// directions, so the level stays the same. The codec takes effect at once,
+// the digital gain only after the audio already rendered has been played
+// (MASTER_HANDOVER_US), so whichever of the two goes down comes first: the
+// output may dip for that time, but never jumps up.
+//
+void CWKeyerShield::master_service(void)
+{
+    float gc = codec_gain(master_codec);
+    float gl, gain;
+
+    if (!master_handover) master_next = master_level;
+    gl   = codec_gain(master_next);
+    gain = (gl > 0.0F) ? master_gain * gc / gl : 1.0F;
+
+    if (!master_handover) {
+        master_raise = gl > gc;
+        if (master_raise) {
+            AudioNoInterrupts();
+            teensyaudiotone.volumeJump(gain, gain);
+            AudioInterrupts();
+        } else {
+            codec_volume(master_next);
+        }
+        master_handover = true;
+        master_handover_start = micros();
+        master_pending  = false;
+        return;
+    }
+    if (master_raise) {
+        codec_volume(master_next);
+        teensyaudiotone.volume(1.0F);
+    } else {
+        AudioNoInterrupts();
+        teensyaudiotone.volumeJump(gain, 1.0F);
+        AudioInterrupts();
+    }
+    master_codec    = master_next;
+    master_gain     = 1.0F;
+    master_handover = false;
+    if (master_pending) master_ramp();   // changed during the handover
+}
+
+void CWKeyerShield::codec_execute(const int16_t nrpn_cc, const int16_t nrpn_val)
 {
     switch(nrpn_cc) {
 
@@ -326,43 +679,83 @@ void CWKeyerShield::process_nrpn(const int16_t nrpn_cc, const int16_t nrpn_val)
         if (wm8960) wm8960->lineinPower(nrpn_val);
         break;
 
-    case MIDI_NRPN_WM8960_RAW_MASK:
-        wm8960_raw_mask = nrpn_val & 0x1ff;
+    default:
         break;
 
-    case MIDI_NRPN_WM8960_RAW_DATA:
-        wm8960_raw_data = nrpn_val & 0x1ff;
-        break;
+    }
+}
 
-    case MIDI_NRPN_WM8960_RAW_WRITE:
-        if (wm8960 && wm8960_raw_mask >= 0 && wm8960_raw_data >= 0) {
-            wm8960->write(nrpn_val & 0x3f, wm8960_raw_data, wm8960_raw_mask, (nrpn_val & 0x40) != 0);
-        }
-        wm8960_raw_mask = -1;
-        wm8960_raw_data = -1;
-        break;
+//
+// The dispatch tables: one entry per CC number and per NRPN number, built at
+// compile time from CWKeyerParameters.h. Numbers not listed there have no
+// setter (and no getter). A number listed twice stops the compilation with
+// an error that mentions duplicate_parameter_number().
+//
+struct CWKeyerShield::param {
+    int16_t  min   = 0;
+    int16_t  max   = 0;
+    uint8_t  flags = 0;
+    void     (CWKeyerShield::*set)(int16_t num, int16_t value) = nullptr;
+    uint32_t (CWKeyerShield::*get)(void)                       = nullptr;
+};
+
+struct CWKeyerShield::param_table {
+    param cc[128];
+    param nrpn[NNRPN];
+
+    static void duplicate_parameter_number(void);  // intentionally not constexpr
+
+    constexpr void add(param *p, int num, param entry) {
+        if (p[num].set || p[num].get) duplicate_parameter_number();
+        p[num] = entry;
+    }
 
-    case MIDI_NRPN_KEYDOWN_NOTE:
-        // Use 128-255 to turn note off
-        midi_keydown_note = nrpn_val & 0x0ff;
-        break;
+#define CWKEYER_TABLE_CC(name, num, min, max, flags, setter, ...) \
+        add(cc, num, param{min, max, flags, &CWKeyerShield::setter, nullptr});
+#define CWKEYER_TABLE_NRPN(name, num, min, max, flags, setter, ...) \
+        add(nrpn, num, param{min, max, flags, &CWKeyerShield::setter, nullptr});
+#define CWKEYER_TABLE_STATUS(name, num, getter, ...) \
+        add(nrpn, num, param{0, 0, 0, nullptr, &CWKeyerShield::getter});
+#define CWKEYER_TABLE_REPORT(name, num, ...)
 
-    case MIDI_NRPN_PTT_NOTE:
-        // Use 128-255 to turn note off
-        midi_ptt_note = nrpn_val & 0x0ff;
-        break;
+    constexpr param_table() : cc(), nrpn() {
+        CWKEYER_PARAMETERS(CWKEYER_TABLE_CC, CWKEYER_TABLE_NRPN, CWKEYER_TABLE_STATUS, CWKEYER_TABLE_REPORT)
+    }
+};
 
+constexpr CWKeyerShield::param_table CWKeyerShield::params;
 
-    default:
-        break;
+void CWKeyerShield::cc_cw_speed(int16_t num, int16_t value)
+{
+    speed_set(value);  // report to keyer
+    cwspeed(value);    // report to radio (and MIDI controller)
+}
 
-    }
+void CWKeyerShield::nrpn_query(int16_t num, int16_t value)
+{
+    if ( ! nrpn_is_set(value)) return;
+    nrpn_send(value);
 }
 
+void CWKeyerShield::nrpn_unset(int16_t num, int16_t value)
+{
+    if ( ! nrpn_is_valid(value)) return;
+    nrpns[value] = NRPNV_NOTSET;
+}
+
+void CWKeyerShield::nrpn_codec_raw_write(int16_t num, int16_t value)
+{
+    if (wm8960 && wm8960_raw_mask >= 0 && wm8960_raw_data >= 0) {
+        codec_queue_raw(value & 0x3f, wm8960_raw_data, wm8960_raw_mask, (value & 0x40) != 0);
+    }
+    wm8960_raw_mask = -1;
+    wm8960_raw_data = -1;
+}
 
 void CWKeyerShield::midi(void)
 {
-    uint8_t data1, data2;
+    uint8_t type, data1, data2;
+    int n;
 
     //
     // "swallow" incoming MIDI messages on ANY channel,
@@ -370,231 +763,796 @@ void CWKeyerShield::midi(void)
     // This is to prevent overflows if MIDI messages are
     // sent on the "wrong" channel.
     //
-    while (usbMIDI.read()) {
+    // Key and PTT notes are executed right away. Control changes
+    // are queued and executed below, as long as the time budget
+    // of this loop() pass lasts, such that a flood of them does
+    // not delay the rest of loop(). A SysEx message may read or
+    // replace the values the control changes set, so the ones
+    // received before it are all executed first.
+    //
+    midi_pass++;
+    for (n = 0; n < MIDI_READ_MAX && usbMIDI.read(); n++) {
+        type  = usbMIDI.getType();
         data1 = usbMIDI.getData1();
         data2 = usbMIDI.getData2();
 
-        if (usbMIDI.getType() == usbMIDI.ControlChange) {
-
-            //Serial.print("MIDI ");
-            //Serial.print(usbMIDI.getChannel());
-            //Serial.print(" ");
-            //Serial.print(midi_channel);
-            //Serial.print(" ");
-            //Serial.print(data1);
-            //Serial.print(" ");
-            //Serial.println(data2);
-
-
-            // Accept setting of control channel on any channel
-            if (data1 == MIDI_SET_CHANNEL) {
-                if (data2 > 16) data2=0;
-                set_midi_channel(data2);
+        if (type == usbMIDI.ControlChange) {
+            uint16_t head = midi_head;
+            uint16_t next = (head + 1) & (MIDI_RING_LENGTH - 1);
+            if (next == midi_tail) {
+                midi_dropped++;
+                continue;
             }
-
-            if (usbMIDI.getChannel() == midi_channel) {
-                ctrls[data1] = data2; // ctrls[data1] is the definitive value
-                switch(data1) {
-                    case MIDI_NRPN_CC_MSB: // ctrls[MIDI_NRPN_CC_MSB] is already set
-                        break;
-                    case MIDI_NRPN_CC_LSB: // ctrls[MIDI_NRPN_CC_LSB] is already set
-                        break;
-                    case MIDI_NRPN_VAL_MSB: // ctrls[MIDI_NRPN_VAL_MSB] is already set
-                        break;
-                    case MIDI_NRPN_VAL_LSB: // Writing LSB value triggers NRPN call
-                        nrpn_set((ctrls[MIDI_NRPN_CC_MSB]<<7)|ctrls[MIDI_NRPN_CC_LSB],
-                             (ctrls[MIDI_NRPN_VAL_MSB]<<7)|ctrls[MIDI_NRPN_VAL_LSB]);
-                        break;
-
-                    case MIDI_MASTER_VOLUME:
-                        mastervolume(data2);
-                        break;
-
-                    case MIDI_SIDETONE_VOLUME:
-                        sidetonevolume(data2);
-                        break;
-
-                    case MIDI_SIDETONE_FREQUENCY:
-                        sidetonefrequency(data2);
-                        break;
-
-                    case MIDI_CW_SPEED:
-                        if (data2 < 1) data2=1;
-                        speed_set(data2);  // report to keyer
-                        cwspeed(data2);    // report to radio (and MIDI controller)
-                        break;
-
-                    case MIDI_ENABLE_POTS:
-                        // Values greater than 63 are on in MIDI standards
-                        enable_pots = (data2 > 63);
-                        break;
-
-                    case MIDI_RESPONSE:
-                        midi_controller_response = (data2 > 63);
-                        break;
-
-                    case MIDI_KEYER_AUTOPTT:
-                        // auto-PTT by the keyer allowed(data2!=0) or disabled (data2==0)
-                        keyer_autoptt_set(data2 > 63);  // report to keyer
-                        break;
-
-                    case MIDI_KEYER_LEADIN:
-                        // if keyer auto-PTT: lead-in is (10*data2) milliseconds
-                        keyer_leadin_set(data2); // report to keyer
-                        break;
-
-                    case MIDI_KEYER_HANG:
-                        // if keyer auto-PTT: data2=PTT hang time in *dot lengths*
-                        keyer_hang_set(data2); // report to keyer
-                        break;
-
-                    case MIDI_MUTE_CWPTT:
-                        mute_on_cwptt = (data2 > 63);
-                        break;
-
-                    case MIDI_MICPTT_HWPTT:
-                        micptt_hwptt = (data2 > 63);
-                        break;
-
-                    case MIDI_CWPTT_HWPTT:
-                        cwptt_hwptt = (data2 > 63);
-                        break;
-
-                    default:
-                        break;
-                }
-            }
-        } else if (usbMIDI.getType() == usbMIDI.NoteOn) {
+            midi_ring[head].when    = micros();
+            midi_ring[head].pass    = midi_pass;
+            midi_ring[head].channel = usbMIDI.getChannel();
+            midi_ring[head].data1   = data1;
+            midi_ring[head].data2   = data2;
+            midi_head = next;
+        } else if (type == usbMIDI.SystemExclusive) {
+            midi_cc_run(true);
+            sysex(usbMIDI.getSysExArray(), usbMIDI.getSysExArrayLength());
+        } else if (type == usbMIDI.NoteOn) {
             if (data1 == midi_keydown_note) {
-                key(data2 != 0);  // Not an on/off value, but velocity information
+                // Not an on/off value, but velocity information
+                if (playout_delay) {
+                    playout_queue(data2 != 0, micros());
+                } else {
+                    key(data2 != 0);
+                }
             } else if (data1 == midi_ptt_note) {
                 cwptt(data2 != 0);
             }
-        } else if (usbMIDI.getType() == usbMIDI.NoteOff) {
+        } else if (type == usbMIDI.NoteOff) {
             if (data1 == midi_keydown_note) {
-                key(0);  // Ignoring velocity information
+                // Ignoring velocity information
+                if (playout_delay) {
+                    playout_queue(0, micros());
+                } else {
+                    key(0);
+                }
             } else if (data1 == midi_ptt_note) {
                 cwptt(0);
             }
         }
     }
+
+    midi_cc_run(false);
 }
 
-void CWKeyerShield::nrpn_set(const int16_t nrpn, const int16_t value) {
-    if ( ! nrpn_is_valid(nrpn)) return;
-    nrpns[nrpn] = value;
-    switch (nrpn) {
-    case NRPN_ID_KEYER:
-        nrpns[nrpn] = NRPNV_ID_KEYER; // correct nrpn value
-        nrpn_send(nrpn);
-        break;
-    case NRPN_ID_VERSION:
-        nrpns[nrpn] = NRPNV_ID_VERSION; // correct nrpn value
-        nrpn_send(nrpn);
-        break;
-    case NRPN_NNRPN:
-        nrpns[nrpn] = NNRPN; // correct nrpn value
-        nrpn_send(nrpn);
-        break;
-    case NRPN_NRPN_QUERY:
-        if ( ! nrpn_is_valid(value)) return;
-        if ( ! nrpn_is_set(value)) return;
-        nrpn_send(value);
-        break;
-    case NRPN_NRPN_UNSET:
-        if ( ! nrpn_is_valid(value)) return;
-        nrpns[value] = NRPNV_NOTSET;
-        break;
+//
+// Execute the queued control changes in the order received: all of them,
+// or as many as the time budget of this loop() pass allows
+//
+void CWKeyerShield::midi_cc_run(bool all)
+{
+    unsigned long start = micros();
+
+    while (midi_tail != midi_head && (all || micros() - start < CWKEYER_MIDI_BUDGET_US)) {
+        const midi_message &m = midi_ring[midi_tail];
+        if (m.pass != midi_pass) midi_deferred++;
+        if (micros() - m.when > MIDI_LATE_US) midi_late++;
+        midi_cc(m.channel, m.data1, m.data2);
+        midi_tail = (midi_tail + 1) & (MIDI_RING_LENGTH - 1);
+    }
+}
 
-    default:
-        process_nrpn(nrpn, value);
-        break;
-   }
+void CWKeyerShield::midi_cc(uint8_t channel, uint8_t data1, uint8_t data2)
+{
+    uint32_t start = ARM_DWT_CYCCNT;
+
+    // Accept setting of control channel on any channel
+    if (data1 == MIDI_SET_CHANNEL) {
+        if (data2 > 16) data2=0;
+        set_midi_channel(data2);
+    }
+
+    if (channel == midi_channel) cc_dispatch(data1, data2);
+
+    midi_cc_cycles = ARM_DWT_CYCCNT - start;
+    if (midi_cc_cycles > midi_cc_cycles_max) midi_cc_cycles_max = midi_cc_cycles;
 }
 
-void CWKeyerShield::pots()
+void CWKeyerShield::cc_dispatch(uint8_t cc, uint8_t value)
 {
-    uint16_t analog_data;
-    unsigned long m = millis();
-    int val;
+    const param &p = params.cc[cc & 0x7f];
+    int16_t v = value;
+
+    ctrl_store(cc, value); // ctrls[cc] is the definitive value
+    if (p.set) {
+        if (v < p.min) v = p.min;
+        if (v > p.max) v = p.max;
+        // Values greater than 63 are on in MIDI standards
+        if (p.flags & PARAM_BOOL) v = (value > 63);
+        (this->*p.set)(cc, v);
+    }
+}
 
-    // Call every 10 ms, will handle rollover as both m and last_analog_read are unsigned long
-    if ((m - last_analog_read) > 10) {
-        //
-        // Note on analog debouncing:
-        // The value obtained by analogRead is a 12-bit value, that is converted
-        // to a 13-bit moving average (0...8191). Changes of the input value are
-        // 'accepted' if they deviate more than a given threshold (64 for volume,
-        // 128 for freq and 256 for speed) from the previous 'nominal' value
-        // (this is referred to as 'discretization').
-        //
-        // Now there is a problem:
-        // Let the "discretization" be 64 (as for the volume pots). Then, if the
-        // "last analog value" was 64 (mapping to 1 on the range 0-127), you can never
-        // reach zero. Likewise, if the "last analog value" was 63 (mapping to 0),
-        // then it is impossible to reach the next value and you have to jump 2 steps.
-        // Therefore, the last analog value to be remembered will be placed
-        // at the mid-point of the interval corresponding to the new setting.
-        // (in our example:  63 ==> 32; 64 ==> 96).
-        //
-        // Note on the soldering of the pots:
-        // In the CW Keyer Shield, the pots are soldered such that turning them clockwise
-        // *decreases* the analogRead value downto zero. Therefore the max analog value
-        // is a "zero reading" and a zero analog value is a "max reading".
-        //
-        if (last_analog_line == 0) {
-            // Master volume
-            analog_data = analogRead(Pin_MasterVolume);
-            Analog_MasterVol = (Analog_MasterVol >> 1) + analog_data;
-
-            if (abs(Analog_MasterVol - last_mastervol) > 64) {
-                val=(Analog_MasterVol >> 6) & 0x7f;              // 0...127
-                mastervolume(127-val);                           // correct soldering
-                last_mastervol = (val << 6) + 32;                // new "old" value
-                //Serial.print("MV ");
-                //Serial.println(analog_data);
+//
+// MIDI output has two paths. Key and PTT notes are sent and flushed
+// right away, see key() and midiptt(). Control change responses are
+// only recorded here, one slot per controller number, such that a
+// turning pot or a moving slider produces one message per interval
+// instead of one per change. midi_out_service() sends them.
+//
+void CWKeyerShield::midi_cc_queue(uint8_t cc, uint8_t value)
+{
+    uint64_t bit;
+
+    cc &= 127;
+    bit = 1ULL << (cc & 63);
+    if (!(midi_cc_pending[cc >> 6] & bit)) {
+        midi_cc_pending[cc >> 6] |= bit;
+        midi_cc_time[cc] = micros();
+    }
+    midi_cc_value[cc] = value;
+}
+
+int CWKeyerShield::midi_out_queue_depth(void)
+{
+    return __builtin_popcountll(midi_cc_pending[0]) + __builtin_popcountll(midi_cc_pending[1]);
+}
+
+void CWKeyerShield::midi_out_service(void)
+{
+    unsigned long now = millis();
+    unsigned long latency;
+
+    if (now - midi_cc_last < midi_cc_interval) return;
+    if (!(midi_cc_pending[0] | midi_cc_pending[1])) return;
+    midi_cc_last = now;
+
+    for (int i = 0; i < 2; i++) {
+        while (midi_cc_pending[i]) {
+            int bit = __builtin_ctzll(midi_cc_pending[i]);
+            int cc  = (i << 6) | bit;
+            midi_cc_pending[i] &= ~(1ULL << bit);
+            if (midi_channel > 0) {
+                usbMIDI.sendControlChange(cc, midi_cc_value[cc], midi_channel);
             }
-        } else if (last_analog_line == 1) {
-
-            // Sidetone volume
-            analog_data = analogRead(Pin_SideToneVolume);
-            Analog_SideVol = (Analog_SideVol >> 1) + analog_data;
-            if (abs(Analog_SideVol - last_sidevol) > 64) {
-                val=(Analog_SideVol >> 6) & 0x7F;                // 0...127
-                sidetonevolume(127-val);                         // correct soldering
-                last_sidevol = (val << 6) + 32;                  // new "old" value
-                //Serial.print("SV ");
-                //Serial.println(analog_data);
+            latency = micros() - midi_cc_time[cc];
+            midi_cc_latency = latency;
+            if (latency > midi_cc_latency_max) midi_cc_latency_max = latency;
+        }
+    }
+    usbMIDI.send_now();
+}
+
+void CWKeyerShield::nrpn_set(const int16_t nrpn, const int16_t value) {
+    if ( ! nrpn_is_valid(nrpn)) return;
+    const param &p = params.nrpn[nrpn];
+    int16_t v = value;
+
+    if (p.get) {
+        // status NRPN: the value written is ignored, report the current one
+        nrpn_report(nrpn, (this->*p.get)());
+        return;
+    }
+    if (p.set) {
+        if (v < p.min) v = p.min;
+        if (v > p.max) v = p.max;
+    }
+    if (nrpns[nrpn] != v) param_changed(128 + nrpn);
+    nrpns[nrpn] = v;
+    if (p.set) (this->*p.set)(nrpn, v);
+}
+
+//
+// SysEx bulk dump and restore of the NRPN and control values. A host
+// gets the complete state with one SYSEX_DUMP_REQUEST, instead of one
+// NRPN_NRPN_QUERY per NRPN. A dump sent back to the keyer restores
+// it, but only the parameters flagged PARAM_PERSIST are executed, so
+// stale status values and NRPN addresses are ignored.
+//
+void CWKeyerShield::sysex(const uint8_t *data, uint16_t len)
+{
+    unsigned long now = micros();
+    uint8_t sum = 0;
+    uint8_t result;
+    uint8_t command;
+
+    // F0 7D 'C' 'W' version command checksum F7 at least
+    if (len < 8 || data[0] != 0xF0 || data[1] != 0x7D || data[2] != 'C' || data[3] != 'W') return;
+    command = data[5] & 0x7f;
+    if (data[len - 1] != 0xF7) {
+        // truncated, longer than the USB MIDI SysEx buffer
+        result = SYSEX_BAD_LENGTH;
+    } else {
+        for (uint16_t i = 4; i < len - 1; i++) sum += data[i];
+        if (sum & 0x7f) {
+            result = SYSEX_BAD_CHECKSUM;
+        } else if (data[4] != CWKEYER_SYSEX_VERSION) {
+            result = SYSEX_BAD_VERSION;
+        } else {
+            switch (command) {
+            case SYSEX_DUMP_REQUEST:
+                sysex_dump();
+                return;
+            case SYSEX_NRPN_DUMP:
+                result = sysex_restore_nrpns(data + 6, len - 8);
+                break;
+            case SYSEX_CTRL_DUMP:
+                result = sysex_restore_ctrls(data + 6, len - 8);
+                break;
+            case SYSEX_CLOCK_REQUEST:
+                if (len != 10) {
+                    result = SYSEX_BAD_LENGTH;
+                    break;
+                }
+                clock_send((data[6] << 7) | data[7], now);
+                return;
+            case SYSEX_KEY:
+                if (len != 14) {
+                    result = SYSEX_BAD_LENGTH;
+                    break;
+                }
+                playout_queue(data[6] != 0, ((unsigned long) data[7] << 28) | ((unsigned long) data[8] << 21) |
+                                            ((unsigned long) data[9] << 14) | (data[10] << 7) | data[11]);
+                return;
+            default:
+                result = SYSEX_BAD_COMMAND;
+                break;
             }
-        } else if (last_analog_line == 2) {
-
-            // Sidetone frequency
-            analog_data = analogRead(Pin_SideToneFrequency);
-            Analog_SideFreq = (Analog_SideFreq >> 1) + analog_data;
-            if (abs(Analog_SideFreq - last_sidefreq) > 128) {
-                val=(Analog_SideFreq >> 7) & 0x3F;               // val 0...63, mapped to 40 ... 103 (400 to 1030 Hz)
-                sidetonefrequency(103-val);                      // correct soldering
-                last_sidefreq = (val << 7) + 64;                 // new "old" value
-                //Serial.print("SF ");
-                //Serial.println(analog_data);
+        }
+    }
+    uint8_t reply[2] = {command, result};
+    sysex_send(SYSEX_RESULT, reply, 2);
+}
+
+void CWKeyerShield::sysex_send(uint8_t command, const uint8_t *payload, uint16_t len)
+{
+    uint8_t *p = sysex_buffer;
+    uint8_t sum;
+
+    if (len > SYSEX_MAX - 8) return;
+    *p++ = 0xF0;
+    *p++ = 0x7D;
+    *p++ = 'C';
+    *p++ = 'W';
+    *p++ = CWKEYER_SYSEX_VERSION;
+    *p++ = command;
+    sum = CWKEYER_SYSEX_VERSION + command;
+    for (uint16_t i = 0; i < len; i++) {
+        *p++ = payload[i];
+        sum += payload[i];
+    }
+    *p++ = (-sum) & 0x7f;
+    *p++ = 0xF7;
+    usbMIDI.sendSysEx(p - sysex_buffer, sysex_buffer, true);
+    usbMIDI.send_now();
+}
+
+void CWKeyerShield::sysex_dump(void)
+{
+    //
+    // The payload is assembled in sysex_buffer right after the header,
+    // where sysex_send() would copy it to anyway
+    //
+    uint8_t *payload = sysex_buffer + 6;
+    uint16_t len;
+
+    memset(payload, 0, SYSEX_BITMAP);
+    len = SYSEX_BITMAP;
+    for (unsigned nrpn = 0; nrpn < NNRPN; nrpn++) {
+        if (!nrpn_is_set(nrpn)) continue;
+        payload[nrpn / 7] |= 1 << (nrpn % 7);
+        payload[len++] = (nrpns[nrpn] >> 7) & 0x7f;
+        payload[len++] = nrpns[nrpn] & 0x7f;
+    }
+    sysex_send(SYSEX_NRPN_DUMP, payload, len);
+
+    memset(payload, 0, SYSEX_BITMAP);
+    len = SYSEX_BITMAP;
+    for (unsigned cc = 0; cc < 128; cc++) {
+        if (!ctrl_is_set(cc)) continue;
+        payload[cc / 7] |= 1 << (cc % 7);
+        payload[len++] = ctrls[cc] & 0x7f;
+    }
+    sysex_send(SYSEX_CTRL_DUMP, payload, len);
+}
+
+uint8_t CWKeyerShield::sysex_restore_nrpns(const uint8_t *payload, uint16_t len)
+{
+    const uint8_t *value = payload + SYSEX_BITMAP;
+    uint16_t n = 0;
+
+    if (len < SYSEX_BITMAP) return SYSEX_BAD_LENGTH;
+    for (unsigned nrpn = 0; nrpn < NNRPN; nrpn++) {
+        if (payload[nrpn / 7] & (1 << (nrpn % 7))) n++;
+    }
+    if (len != SYSEX_BITMAP + 2 * n) return SYSEX_BAD_LENGTH;
+
+    for (unsigned nrpn = 0; nrpn < NNRPN; nrpn++) {
+        if (!(payload[nrpn / 7] & (1 << (nrpn % 7)))) continue;
+        if (params.nrpn[nrpn].flags & PARAM_PERSIST) {
+            nrpn_set(nrpn, (value[0] << 7) | value[1]);
+        }
+        value += 2;
+    }
+    return SYSEX_OK;
+}
+
+uint8_t CWKeyerShield::sysex_restore_ctrls(const uint8_t *payload, uint16_t len)
+{
+    const uint8_t *value = payload + SYSEX_BITMAP;
+    uint16_t n = 0;
+
+    if (len < SYSEX_BITMAP) return SYSEX_BAD_LENGTH;
+    for (unsigned cc = 0; cc < 128; cc++) {
+        if (payload[cc / 7] & (1 << (cc % 7))) n++;
+    }
+    if (len != SYSEX_BITMAP + n) return SYSEX_BAD_LENGTH;
+
+    for (unsigned cc = 0; cc < 128; cc++) {
+        if (!(payload[cc / 7] & (1 << (cc % 7)))) continue;
+        if (params.cc[cc].flags & PARAM_PERSIST) {
+            cc_dispatch(cc, *value);
+        }
+        value++;
+    }
+    return SYSEX_OK;
+}
+
+//
+// Change reports. Instead of polling, a host subscribes to the parameters
+// it tracks. Each change of a subscribed parameter is marked pending, and
+// report_service() sends the pending ones with their current values, at
+// most once per MIDI_NRPN_MIDI_CC_INTERVAL, so a turning pot results in
+// one report per interval. Each SYSEX_REPORT carries a sequence number:
+// a host that sees a gap sends the last number it did receive to
+// MIDI_NRPN_RESYNC, and gets everything subscribed that was reported since.
+//
+void CWKeyerShield::param_changed(uint16_t index)
+{
+    const param &p = (index < 128) ? params.cc[index] : params.nrpn[index - 128];
+
+    if (p.flags & PARAM_PERSIST) {
+        persist_dirty = true;
+        persist_dirty_time = millis();
+    }
+    report_change(index);
+}
+
+void CWKeyerShield::report_change(uint16_t index)
+{
+    uint64_t bit = 1ULL << (index & 63);
+
+    if (report_subscribed[index >> 6] & bit) report_pending[index >> 6] |= bit;
+}
+
+void CWKeyerShield::nrpn_subscribe(int16_t num, int16_t value)
+{
+    for (uint16_t index = 0; index < NREPORT; index++) {
+        if (value < (int16_t) NREPORT) {
+            if (index != value) continue;
+        } else if (!((index < 128 ? params.cc[index] : params.nrpn[index - 128]).flags & PARAM_PERSIST)) {
+            continue;
+        }
+        report_subscribed[index >> 6] |= 1ULL << (index & 63);
+        // report the current value right away
+        if (index < 128 ? ctrl_is_set(index) : nrpn_is_set(index - 128)) report_change(index);
+    }
+}
+
+void CWKeyerShield::nrpn_unsubscribe(int16_t num, int16_t value)
+{
+    for (uint16_t i = 0; i < NREPORT / 64; i++) {
+        uint64_t mask = ~0ULL;
+        if (value < (int16_t) NREPORT) mask = (value >> 6 == i) ? 1ULL << (value & 63) : 0;
+        report_subscribed[i] &= ~mask;
+        report_pending[i]    &= ~mask;
+    }
+}
+
+void CWKeyerShield::nrpn_resync(int16_t num, int16_t value)
+{
+    uint16_t newest = (report_sequence - value) & 0x3fff;
+
+    for (uint16_t index = 0; index < NREPORT; index++) {
+        uint16_t age = (report_changed[index] - value) & 0x3fff;
+        if (report_changed[index] && age > 0 && age <= newest) report_change(index);
+    }
+}
+
+void CWKeyerShield::report_service(void)
+{
+    unsigned long now = millis();
+    uint8_t *payload = sysex_buffer + 6;
+    uint16_t len, seq;
+    bool pending = false;
+
+    for (uint16_t i = 0; i < NREPORT / 64; i++) pending |= (report_pending[i] != 0);
+    if (!pending || now - report_last < midi_cc_interval) return;
+    report_last = now;
+
+    //
+    // As many messages as needed, if all subscribed parameters changed
+    // at once they do not fit into one
+    //
+    while (pending) {
+        seq = report_next_sequence(report_sequence);
+        payload[0] = seq >> 7;
+        payload[1] = seq & 0x7f;
+        len = 2;
+        pending = false;
+        for (uint16_t i = 0; i < NREPORT / 64; i++) {
+            while (report_pending[i] && len + 4 <= SYSEX_MAX - 8) {
+                int bit = __builtin_ctzll(report_pending[i]);
+                uint16_t index = (i << 6) | bit;
+                int16_t value;
+                report_pending[i] &= ~(1ULL << bit);
+                if (index < 128) {
+                    value = ctrls[index];
+                } else if (nrpn_is_set(index - 128)) {
+                    value = nrpns[index - 128];
+                } else {
+                    continue;
+                }
+                report_changed[index] = seq;
+                payload[len++] = index >> 7;
+                payload[len++] = index & 0x7f;
+                payload[len++] = (value >> 7) & 0x7f;
+                payload[len++] = value & 0x7f;
             }
-        } else if (last_analog_line == 3) {
-
-            // Speed
-            analog_data = analogRead(Pin_Speed);
-            Analog_Speed = (Analog_Speed >> 1) + analog_data;
-            if (abs(Analog_Speed - last_speed) > 256) {
-                val=(Analog_Speed >> 8) & 0x1f;                  // 0...31, mapped to 0 ... 127 through SpeedTab
-                speed_set(SpeedTab[31-val]);                     // report to keyer
-                cwspeed(SpeedTab[31-val]);                       // report to radio
-                last_speed = (val << 8) + 128;                   // new "old" value
-                //Serial.print("SP ");
-                //Serial.println(analog_data);
+            pending |= (report_pending[i] != 0);
+        }
+        if (len > 2) {
+            report_sequence = seq;
+            sysex_send(SYSEX_REPORT, payload, len);
+        }
+    }
+}
+
+//
+// Persistent settings. The values of all PARAM_PERSIST controls and
+// NRPNs are kept in the EEPROM as one record:
+//
+//   'C' 'W' version count sequence (2 bytes) CRC (2 bytes)
+//   count * (index, value MSB, value LSB)
+//
+// with index as for change reports (CC number, 128 + NRPN number).
+// Each record goes into the next slot of a ring, so the writes are spread
+// over the EEPROM, and a record that is cut short by a power loss leaves
+// the previous one intact. Restoring reads the slot headers, and then only
+// the newest valid record, into ctrls[] and nrpns[]. persist_apply()
+// executes it once the startup has reached SETUP_RESTORE, in loop().
+//
+// A record is written when the settings have not changed for
+// CWKEYER_PERSIST_DELAY_MS, in chunks of PERSIST_CHUNK bytes per loop()
+// pass, and only while the key is up, there is no PTT and no MIDI backlog.
+// The header, which makes the record valid, comes last.
+//
+namespace {
+
+uint16_t crc16(uint16_t crc, const uint8_t *data, uint16_t len)
+{
+    // CRC-16/CCITT
+    while (len--) {
+        crc ^= (uint16_t) *data++ << 8;
+        for (int i = 0; i < 8; i++) crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+} // namespace
+
+uint16_t CWKeyerShield::persist_build(void)
+{
+    uint8_t *entry = persist_record + PERSIST_HEADER;
+    uint8_t count = 0;
+
+    for (uint16_t index = 0; index < NREPORT; index++) {
+        int16_t value;
+        if (index < 128) {
+            if (!(params.cc[index].flags & PARAM_PERSIST) || !ctrl_is_set(index)) continue;
+            value = ctrls[index];
+        } else {
+            if (!(params.nrpn[index - 128].flags & PARAM_PERSIST) || !nrpn_is_set(index - 128)) continue;
+            value = nrpns[index - 128];
+        }
+        *entry++ = index;
+        *entry++ = value >> 8;
+        *entry++ = value & 0xff;
+        count++;
+    }
+    persist_record[0] = 'C';
+    persist_record[1] = 'W';
+    persist_record[2] = PERSIST_VERSION;
+    persist_record[3] = count;
+    return entry - persist_record;
+}
+
+void CWKeyerShield::persist_restore(void)
+{
+    uint8_t  header[PERSIST_HEADER];
+    int      newest = -1;
+    uint16_t seq = 0;
+
+    for (uint16_t slot = 0; slot < PERSIST_SLOTS; slot++) {
+        int base = CWKEYER_EEPROM_BASE + slot * PERSIST_SLOT;
+        for (uint16_t i = 0; i < PERSIST_HEADER; i++) header[i] = EEPROM.read(base + i);
+        if (header[0] != 'C' || header[1] != 'W' || header[2] != PERSIST_VERSION) continue;
+        if (header[3] > PERSIST_ENTRIES) continue;
+        uint16_t s = (header[4] << 8) | header[5];
+        if (newest < 0 || (int16_t) (s - seq) > 0) {
+            newest = slot;
+            seq = s;
+        }
+    }
+    if (newest < 0) return;
+
+    int base = CWKEYER_EEPROM_BASE + newest * PERSIST_SLOT;
+    for (uint16_t i = 0; i < PERSIST_HEADER; i++) persist_record[i] = EEPROM.read(base + i);
+    uint16_t len = PERSIST_HEADER + 3 * persist_record[3];
+    for (uint16_t i = PERSIST_HEADER; i < len; i++) persist_record[i] = EEPROM.read(base + i);
+    uint16_t crc = crc16(0xffff, persist_record + 3, 1);
+    crc = crc16(crc, persist_record + PERSIST_HEADER, len - PERSIST_HEADER);
+    if (crc != ((persist_record[6] << 8) | persist_record[7])) {
+        // Not from an interrupted write (the previous record would then
+        // be the newest one), something else has written to this part
+        // of the EEPROM: start with the defaults
+        return;
+    }
+
+    //
+    // Into the stores only, the setters run in persist_apply()
+    //
+    for (uint8_t *entry = persist_record + PERSIST_HEADER; entry < persist_record + len; entry += 3) {
+        uint16_t index = entry[0];
+        int16_t value = (entry[1] << 8) | entry[2];
+        const param &p = (index < 128) ? params.cc[index] : params.nrpn[index - 128];
+        if (!(p.flags & PARAM_PERSIST)) continue;
+        if (value < p.min) value = p.min;
+        if (value > p.max) value = p.max;
+        if (index < 128) {
+            ctrls[index] = value;
+            ctrls_set[index >> 6] |= 1ULL << (index & 63);
+        } else {
+            nrpns[index - 128] = value;
+        }
+    }
+    persist_len = len;
+    persist_slot = newest;
+    persist_seq = seq;
+    persist_crc = crc;
+    persist_dirty = false;
+}
+
+//
+// Execute each restored setting once. The setters queue control change
+// responses, which are dropped: the host has not asked for anything yet.
+//
+void CWKeyerShield::persist_apply(void)
+{
+    for (uint8_t *entry = persist_record + PERSIST_HEADER; entry < persist_record + persist_len; entry += 3) {
+        uint16_t index = entry[0];
+        if (index < 128) {
+            if (ctrl_is_set(index)) cc_dispatch(index, ctrls[index]);
+        } else {
+            const param &p = params.nrpn[index - 128];
+            if (p.set && nrpn_is_set(index - 128)) (this->*p.set)(index - 128, nrpns[index - 128]);
+        }
+    }
+    persist_len = 0;
+    midi_cc_pending[0] = midi_cc_pending[1] = 0;
+    persist_dirty = false;
+}
+
+void CWKeyerShield::persist_service(void)
+{
+    unsigned long start;
+
+    if (PERSIST_SLOTS == 0) return;
+    if (key_state || cwptt_state || hwptt_state || midiptt_state || midi_tail != midi_head) return;
+    if (playout_tail != playout_head) return;
+
+    start = micros();
+    if (persist_clear) {
+        for (uint16_t slot = 0; slot < PERSIST_SLOTS; slot++) {
+            EEPROM.update(CWKEYER_EEPROM_BASE + slot * PERSIST_SLOT, 0xff);
+        }
+        persist_clear = false;
+        persist_dirty = false;
+        persist_pos   = 0;
+    } else if (persist_pos == 0) {
+        if (!persist_dirty || millis() - persist_dirty_time < CWKEYER_PERSIST_DELAY_MS) return;
+        persist_dirty = false;
+        persist_len = persist_build();
+        uint16_t crc = crc16(0xffff, persist_record + 3, 1);
+        crc = crc16(crc, persist_record + PERSIST_HEADER, persist_len - PERSIST_HEADER);
+        if (crc == persist_crc) return;  // changed back to what is saved
+        persist_seq++;
+        persist_record[4] = persist_seq >> 8;
+        persist_record[5] = persist_seq & 0xff;
+        persist_record[6] = crc >> 8;
+        persist_record[7] = crc & 0xff;
+        persist_crc  = crc;
+        persist_slot = (persist_slot + 1) % PERSIST_SLOTS;
+        persist_pos  = PERSIST_HEADER;
+        return;
+    } else {
+        int base = CWKEYER_EEPROM_BASE + persist_slot * PERSIST_SLOT;
+        if (persist_pos < persist_len) {
+            // entries first
+            for (uint16_t n = 0; n < PERSIST_CHUNK && persist_pos < persist_len; n++, persist_pos++) {
+                EEPROM.update(base + persist_pos, persist_record[persist_pos]);
             }
+        } else {
+            // then the header
+            for (uint16_t i = 0; i < PERSIST_HEADER; i++) EEPROM.update(base + i, persist_record[i]);
+            persist_pos = 0;
+            persist_writes++;
         }
+    }
+    unsigned long t = micros() - start;
+    if (t > persist_time_max) persist_time_max = t;
+}
+
+//
+// Timestamped events. The host only sees when a USB frame with a key or
+// PTT note arrives, which adds the USB polling jitter to the keying.
+// With MIDI_NRPN_TIMESTAMPS set, each note is followed by a SYSEX_EVENT
+// with the keyer time of the transition. To relate keyer time to its own
+// clock, the host gets a SYSEX_CLOCK every clock_interval; for a better
+// estimate it can send SYSEX_CLOCK_REQUEST and measure the round trip.
+//
+namespace {
+
+uint8_t *put_time(uint8_t *p, unsigned long t)
+{
+    *p++ = (t >> 28) & 0x0f;
+    *p++ = (t >> 21) & 0x7f;
+    *p++ = (t >> 14) & 0x7f;
+    *p++ = (t >>  7) & 0x7f;
+    *p++ =  t        & 0x7f;
+    return p;
+}
+
+} // namespace
+
+void CWKeyerShield::event_send(uint8_t event, uint8_t state, unsigned long when)
+{
+    uint8_t payload[8];
+
+    if (!timestamps || midi_channel == 0) return;
+    payload[0] = event;
+    payload[1] = state ? 1 : 0;
+    payload[2] = event_sequence;
+    put_time(payload + 3, when);
+    event_sequence = (event_sequence + 1) & 0x7f;
+    sysex_send(SYSEX_EVENT, payload, 8);
+}
+
+void CWKeyerShield::clock_send(uint16_t tag, unsigned long when)
+{
+    uint8_t payload[7];
+
+    put_time(payload, when);
+    payload[5] = (tag >> 7) & 0x7f;
+    payload[6] = tag & 0x7f;
+    sysex_send(SYSEX_CLOCK, payload, 7);
+}
+
+void CWKeyerShield::clock_service(void)
+{
+    unsigned long now = millis();
 
-        last_analog_read = m;
-        last_analog_line = (last_analog_line + 1) & 0x3;
+    if (!timestamps || midi_channel == 0 || now - clock_last < clock_interval) return;
+    clock_last = now;
+    clock_send(0, micros());
+}
+
+//
+// Playout buffer for keying from the host. Key notes, and even more so
+// SysEx, arrive with the USB scheduling jitter, which would make the
+// element lengths uneven if they were keyed right away. Instead, each
+// transition is played at a fixed delay after the time stamp the host
+// gave it (SYSEX_KEY), or after its arrival (key notes with
+// MIDI_NRPN_PLAYOUT_DELAY set). The first transition after a pause fixes
+// the offset between the host time stamps and micros(), so the host may
+// use any clock with micro-second ticks. The side tone gets each
+// transition PLAYOUT_LEAD_US ahead and starts it at the exact sample,
+// the other outputs follow when loop() reaches its time.
+//
+void CWKeyerShield::playout_queue(uint8_t state, unsigned long stamp)
+{
+    unsigned long now = micros();
+    unsigned long when;
+    uint8_t head = playout_head;
+    uint8_t next = (head + 1) & (PLAYOUT_LENGTH - 1);
+
+    if (next == playout_tail) {
+        playout_dropped++;
+        return;
+    }
+    if (!playout_anchored || (head == playout_tail && (long)(now - playout_last) > (long) PLAYOUT_IDLE_US)) {
+        playout_offset = now + playout_delay * 1000UL - stamp;
+        playout_anchored = true;
+    }
+    when = stamp + playout_offset;
+    if ((long)(when - now) < 0) {
+        // too late, play it now
+        playout_late++;
+        when = now;
+    }
+    if (head != playout_tail && (long)(when - playout_last) < 0) {
+        // keep the transitions in order, the side tone expects that
+        when = playout_last;
+    }
+    playout_ring[head].when  = when;
+    playout_ring[head].state = state;
+    playout_head = next;
+    playout_last = when;
+
+    uint16_t depth = (next - playout_tail) & (PLAYOUT_LENGTH - 1);
+    if (depth > playout_depth_max) playout_depth_max = depth;
+}
+
+void CWKeyerShield::playout_service(void)
+{
+    unsigned long now = micros();
+
+    while (playout_tone != playout_head && (long)(playout_ring[playout_tone].when - now) < PLAYOUT_LEAD_US) {
+        teensyaudiotone.scheduleKeyEvent(playout_ring[playout_tone].state, playout_ring[playout_tone].when);
+        playout_tone = (playout_tone + 1) & (PLAYOUT_LENGTH - 1);
+    }
+    while (playout_tail != playout_tone && (long)(playout_ring[playout_tail].when - now) <= 0) {
+        key_output(playout_ring[playout_tail].state, playout_ring[playout_tail].when);
+        playout_tail = (playout_tail + 1) & (PLAYOUT_LENGTH - 1);
+    }
+}
+
+void CWKeyerShield::pots()
+{
+    int val;
+
+    //
+    // The pots are scanned in the background, see TeensyPots, this only
+    // looks at the latest filtered values (13 bits, 0...8191).
+    //
+    // Note on analog debouncing:
+    // Changes of the input value are 'accepted' if they deviate more than
+    // a given threshold (64 for volume, 128 for freq and 256 for speed) from
+    // the previous 'nominal' value (this is referred to as 'discretization').
+    //
+    // Now there is a problem:
+    // Let the "discretization" be 64 (as for the volume pots). Then, if the
+    // "last analog value" was 64 (mapping to 1 on the range 0-127), you can never
+    // reach zero. Likewise, if the "last analog value" was 63 (mapping to 0),
+    // then it is impossible to reach the next value and you have to jump 2 steps.
+    // Therefore, the last analog value to be remembered will be placed
+    // at the mid-point of the interval corresponding to the new setting.
+    // (in our example:  63 ==> 32; 64 ==> 96). See TeensyPots::step().
+    //
+    // Note on the soldering of the pots:
+    // In the CW Keyer Shield, the pots are soldered such that turning them clockwise
+    // *decreases* the analog value downto zero. Therefore the max analog value
+    // is a "zero reading" and a zero analog value is a "max reading".
+    //
+    if (Pin_MasterVolume >= 0) {
+        val = TeensyPots::step(potscan.value(POT_MASTER_VOLUME), last_mastervol, 6);
+        if (val >= 0) {
+            mastervolume(127 - val);                             // 0...127, correct soldering
+        }
+    }
+    if (Pin_SideToneVolume >= 0) {
+        val = TeensyPots::step(potscan.value(POT_SIDETONE_VOLUME), last_sidevol, 6);
+        if (val >= 0) {
+            sidetonevolume(127 - val);                           // 0...127, correct soldering
+        }
+    }
+    if (Pin_SideToneFrequency >= 0) {
+        val = TeensyPots::step(potscan.value(POT_SIDETONE_FREQ), last_sidefreq, 7);
+        if (val >= 0) {
+            sidetonefrequency(103 - val);                        // val 0...63, mapped to 40 ... 103 (400 to 1030 Hz)
+        }
+    }
+    if (Pin_Speed >= 0) {
+        val = TeensyPots::step(potscan.value(POT_SPEED), last_speed, 8);
+        if (val >= 0) {
+            speed_set(SpeedTab[31 - val]);                       // 0...31, mapped to 0 ... 127 through SpeedTab
+            cwspeed(SpeedTab[31 - val]);                         // report to keyer and radio
+        }
     }
 }
 
@@ -609,13 +1567,20 @@ void CWKeyerShield::hwptt(int state)
 }
 
 void CWKeyerShield::midiptt(int state)
+{
+    midiptt_send(state, micros());
+}
+
+void CWKeyerShield::midiptt_send(int state, unsigned long when)
 {
     //
     // send MIDI PTT message to radio
     //
     if ((midi_channel > 0) && (midi_ptt_note < 128)) {
         usbMIDI.sendNoteOn(midi_ptt_note, state ? 127 : 0, midi_channel);
+        usbMIDI.send_now();
     }
+    event_send(SYSEX_EVENT_PTT, state, when);
 }
 
 void CWKeyerShield::key(int state)
@@ -627,11 +1592,20 @@ void CWKeyerShield::key(int state)
     // b) send MIDI message
     // c) set hardware line
     //
-    teensyaudiotone.setTone(state);
+    unsigned long now = micros();
+
+    teensyaudiotone.keyEvent(state, now);
+    key_output(state, now);
+}
+
+void CWKeyerShield::key_output(int state, unsigned long when)
+{
+    key_state = state;
     if ((midi_channel > 0) && (midi_keydown_note < 128)) {
         usbMIDI.sendNoteOn(midi_keydown_note, state ? 127 : 0, midi_channel);
         usbMIDI.send_now();
     }
+    event_send(SYSEX_EVENT_KEY, state, when);
     if (Pin_CWout >= 0) {
       digitalWrite(Pin_CWout, state? 1 : 0);
     }
@@ -656,9 +1630,60 @@ void CWKeyerShield::cwptt(int state)
 void CWKeyerShield::mastervolume(uint8_t level)  // input level from 0 ... 127
 {
     if (midi_controller_response && midi_channel > 0) {
-        usbMIDI.sendControlChange(MIDI_MASTER_VOLUME, level, midi_channel);
+        midi_cc_queue(MIDI_MASTER_VOLUME, level);
     }
-    masterlevel_target=(float)level/127.0;
+    ctrl_store(MIDI_MASTER_VOLUME, level);
+    master_level = (float) level / 127.0F;
+    if (!wm8960 && !sgtl5000) return;   // no master volume control
+    master_pending = true;
+    //
+    // Before the codec is up, SETUP_CODEC_VOLUME writes the level
+    // directly. During a handover, the ramp starts after it.
+    //
+    if (setup_stage == SETUP_DONE && !master_handover) master_ramp();
+}
+
+//
+// Balance and pan both use 0 = left, 64 = center, 127 = right.
+// Off center, only the opposite channel is attenuated, so the
+// center position leaves both channels at full level.
+//
+void CWKeyerShield::masterbalance(uint8_t balance)   // input balance from 0 ... 127
+{
+    if (midi_controller_response && midi_channel > 0) {
+        midi_cc_queue(MIDI_MASTER_BALANCE, balance);
+    }
+    ctrl_store(MIDI_MASTER_BALANCE, balance);
+    if (balance > 127) balance = 127;
+    teensyaudiotone.balance(balance <= 64 ? 1.0F : (float)(127 - balance) / 63.0F,
+                            balance >= 64 ? 1.0F : (float)balance / 64.0F);
+}
+
+void CWKeyerShield::sidetonepan(uint8_t pan)   // input pan from 0 ... 127
+{
+    if (midi_controller_response && midi_channel > 0) {
+        midi_cc_queue(MIDI_MASTER_PAN, pan);
+    }
+    ctrl_store(MIDI_MASTER_PAN, pan);
+    if (pan > 127) pan = 127;
+    teensyaudiotone.pan(pan <= 64 ? 1.0F : (float)(127 - pan) / 63.0F,
+                        pan >= 64 ? 1.0F : (float)pan / 64.0F);
+}
+
+void CWKeyerShield::duck()
+{
+    //
+    // Attenuation in dB to a remaining gain, 100 dB or more is a full mute
+    //
+    float depth = (duck_depth_db >= 100) ? 0.0F : powf(10.0F, -0.05F * duck_depth_db);
+    teensyaudiotone.duck(depth, duck_attack, duck_release);
+}
+
+void CWKeyerShield::vox_setup()
+{
+    vox.threshold(-(float) vox_threshold);
+    vox.times(vox_attack, vox_hold);
+    vox.antivox((vox_antivox >= 100) ? 0.0F : powf(10.0F, -0.05F * vox_antivox));
 }
 
 void CWKeyerShield::sidetonevolume(uint8_t level)    // input level from 0 ... 127
@@ -669,20 +1694,34 @@ void CWKeyerShield::sidetonevolume(uint8_t level)    // input level from 0 ... 1
     // simulated.
     //
     if (midi_controller_response && midi_channel > 0) {
-        usbMIDI.sendControlChange(MIDI_SIDETONE_VOLUME, level, midi_channel);
+        midi_cc_queue(MIDI_SIDETONE_VOLUME, level);
     }
+    ctrl_store(MIDI_SIDETONE_VOLUME, level);
     level = level >> 2;                  // reduce to 0...31
-    sidetonelevel_target=VolTab[level];
+    teensyaudiotone.amplitude(VolTab[level]);
 }
 
 void CWKeyerShield::sidetonefrequency(uint8_t freq)   // input freq from 0 ... 127, maps to 0 ... 1270 Hz
 {
-    sine.frequency( (float)(10*freq) );
+    teensyaudiotone.frequency( (float)(10*freq) );
+
+    // MIDI_NRPN_SIDETONE_FREQUENCY holds the persistent value
+    if (nrpns[MIDI_NRPN_SIDETONE_FREQUENCY] != 10*freq) {
+        nrpns[MIDI_NRPN_SIDETONE_FREQUENCY] = 10*freq;
+        param_changed(128 + MIDI_NRPN_SIDETONE_FREQUENCY);
+    }
 
     // Code provides a unified on/off switch for control change responses, there is no distinction between controller and SDR
     if (midi_controller_response && midi_channel > 0) {
-        usbMIDI.sendControlChange(MIDI_SIDETONE_FREQUENCY, freq, midi_channel);
+        midi_cc_queue(MIDI_SIDETONE_FREQUENCY, freq);
     }
+    ctrl_store(MIDI_SIDETONE_FREQUENCY, freq);
+}
+
+void CWKeyerShield::nrpn_sidetone_frequency(int16_t num, int16_t value)
+{
+    teensyaudiotone.frequency((float) value);
+    ctrl_store(MIDI_SIDETONE_FREQUENCY, (value + 5) / 10 > 127 ? 127 : (value + 5) / 10);
 }
 
 void CWKeyerShield::cwspeed(uint8_t speed)   // input speed from 0 ... 127
@@ -690,8 +1729,9 @@ void CWKeyerShield::cwspeed(uint8_t speed)   // input speed from 0 ... 127
     if (speed == 0) speed = 1;  // even more paranoia
 
     if (midi_controller_response && midi_channel> 0) {
-        usbMIDI.sendControlChange(MIDI_CW_SPEED, speed, midi_channel);
+        midi_cc_queue(MIDI_CW_SPEED, speed);
     }
+    ctrl_store(MIDI_CW_SPEED, speed);
  }
 
 #endif
@@ -29,6 +29,48 @@
 #include "AudioStream.h"
 #include "arm_math.h"
 #include "TeensyAudioTone.h"
+#include "CWDecoder.h"
+#include "TeensyAudioVox.h"
+#include "TeensyPots.h"
+#include "CWKeyerParameters.h"
+
+//
+// Number of audio blocks reserved by AudioMemory(). The side tone mixer
+// works in place on the USB audio blocks and allocates at most one block
+// per update, so this is mostly needed by the USB and I2S objects.
+// Use NRPN_AUDIO_MEMORY_MAX to check the actual usage.
+//
+#ifndef CWKEYER_AUDIO_MEMORY
+#define CWKEYER_AUDIO_MEMORY 32
+#endif
+
+//
+// Time (micro-seconds) that loop() may spend per pass on executing
+// queued MIDI control changes, see midi()
+//
+#ifndef CWKEYER_MIDI_BUDGET_US
+#define CWKEYER_MIDI_BUDGET_US 200
+#endif
+
+//
+// Part of the (emulated) EEPROM where the persistent settings are kept,
+// see persist_service(). Keyer sketches usually keep their own settings
+// at the start of the EEPROM, so by default the last CWKEYER_EEPROM_SIZE
+// bytes are used. A size of zero disables persistent settings.
+//
+#ifndef CWKEYER_EEPROM_SIZE
+#define CWKEYER_EEPROM_SIZE 640
+#endif
+#ifndef CWKEYER_EEPROM_BASE
+#define CWKEYER_EEPROM_BASE (E2END + 1 - CWKEYER_EEPROM_SIZE)
+#endif
+
+//
+// Time (milli-seconds) a setting must be unchanged before it is saved
+//
+#ifndef CWKEYER_PERSIST_DELAY_MS
+#define CWKEYER_PERSIST_DELAY_MS 5000
+#endif
 
 //
 // External functions, to be implemented in the keyer
@@ -40,44 +82,14 @@ void keyer_leadin_set(int leadin);  // set keyer PTT lead-in time (leadin milli-
 void keyer_hang_set(int hang);      // set keyer PTT hang time (in *dotlengths*) (if using auto-PTT)
 
 //
-// avoid certain "continuous controllers"
-//
-// No.  0, 32           (Bank select)
-// No.  6, 38, 98--101  (Registered and non-Registered Parameters)
-// No. 88               (High-resolution velocity prefix)
-// No. 96, 97           (Increment/Decrement)
-// No. 120-127          (Channel mode messages)
-//
+// The MIDI controls and NRPNs, see CWKeyerParameters.h
 //
+#define CWKEYER_ENUM_CC(name, num, ...)         name = num,
+#define CWKEYER_ENUM_NRPN(name, num, ...)       name = num,
+#define CWKEYER_ENUM_IGNORE(...)
 
 enum midi_control_selection {
-
-    MIDI_NRPN_CC_MSB              = 99,
-    MIDI_NRPN_CC_LSB              = 98,
-    MIDI_NRPN_VAL_MSB             = 6,
-    MIDI_NRPN_VAL_LSB             = 38,
-
-    MIDI_MASTER_VOLUME            = 7,      // set master volume
-    MIDI_MASTER_BALANCE           = 8,      //TODO: stereo balance
-    MIDI_MASTER_PAN               = 10,     //TODO: stereo position of CW tone
-
-    MIDI_SIDETONE_VOLUME          = 12,     // set sidetone volume
-    MIDI_SIDETONE_FREQUENCY       = 13,     // set sidetone frequency
-
-    MIDI_INPUT_LEVEL              = 16,     //TODO:
-
-    MIDI_ENABLE_POTS              = 64,     // enable/disable potentiometers
-    MIDI_KEYER_AUTOPTT            = 65,     // enable/disable auto-PTT from CW keyer
-    MIDI_RESPONSE                 = 66,     // enable/disable reporting back to SDR and MIDI controller
-    MIDI_MUTE_CWPTT               = 67,     // enable/disable muting of RX audio during auto-PTT
-    MIDI_MICPTT_HWPTT             = 68,     // enable/disable that MICIN triggers the hardware PTT output
-    MIDI_CWPTT_HWPTT              = 69,     // enable/disable that CWPTT triggers the hardware PTT output
-
-    MIDI_KEYER_HANG               = 72,     // set Keyer hang time (if auto-PTT active)
-    MIDI_KEYER_LEADIN             = 73,     // set Keyer lead-in time (if auto-PTT active)
-    MIDI_CW_SPEED                 = 74,     // set CW speed
-    MIDI_INPUT_SELECT             = 75,     //TODO:
-    MIDI_SET_CHANNEL              = 119     // Change the default channel to use
+    CWKEYER_PARAMETERS(CWKEYER_ENUM_CC, CWKEYER_ENUM_IGNORE, CWKEYER_ENUM_IGNORE, CWKEYER_ENUM_IGNORE)
 };
 
 enum midi_nrpn_values {
@@ -86,31 +98,67 @@ enum midi_nrpn_values {
     NRPNV_ID_VERSION = 101
 };
 
+//
+// SysEx messages, see sysex(). All of them have the form
+//
+//   F0 7D 'C' 'W' <version> <command> <payload> <checksum> F7
+//
+// 7D is the manufacturer ID for non-commercial use. The checksum is chosen
+// such that the 7-bit sum of version, command, payload and checksum is zero.
+// Bitmaps have one bit per CC/NRPN number, seven bits per byte, LSB first.
+//
+#define CWKEYER_SYSEX_VERSION 1
+
+enum sysex_command {
+    SYSEX_DUMP_REQUEST  = 1,    // host: send SYSEX_NRPN_DUMP and SYSEX_CTRL_DUMP
+    SYSEX_NRPN_DUMP     = 2,    // bitmap of NRPNs set, then MSB, LSB of each one set
+    SYSEX_CTRL_DUMP     = 3,    // bitmap of controls set, then the value of each one set
+    SYSEX_RESULT        = 4,    // keyer: command, result (enum sysex_result) of a restore
+    SYSEX_REPORT        = 5,    // keyer: sequence number (MSB, LSB), then index (MSB, LSB)
+                                //        and value (MSB, LSB) of each changed parameter
+    SYSEX_EVENT         = 6,    // keyer: event (enum sysex_event), state, sequence number, time
+    SYSEX_CLOCK_REQUEST = 7,    // host: tag (MSB, LSB), answered by SYSEX_CLOCK right away
+    SYSEX_CLOCK         = 8,    // keyer: time, tag (MSB, LSB) of the request (0: periodic)
+    SYSEX_KEY           = 9     // host: state, time of the key transition (host time base)
+};
+
+//
+// Events of SYSEX_EVENT. Times in SysEx messages are micros() of the
+// keyer, 32 bits in five bytes, most significant first. SYSEX_KEY is the
+// exception, its time stamps are micro-seconds of any clock of the host,
+// see playout_queue().
+//
+enum sysex_event {
+    SYSEX_EVENT_KEY     = 0,
+    SYSEX_EVENT_PTT     = 1
+};
+
+enum sysex_result {
+    SYSEX_OK            = 0,
+    SYSEX_BAD_CHECKSUM  = 1,
+    SYSEX_BAD_VERSION   = 2,
+    SYSEX_BAD_LENGTH    = 3,
+    SYSEX_BAD_COMMAND   = 4
+};
+
+//
+// Startup stages, see setup() and setup_service()
+//
+enum setup_stage {
+    SETUP_START         = 0,    // setup() called
+    SETUP_AUDIO         = 1,    // audio memory, I/O lines, side tone: keying works from here on
+    SETUP_RESTORE       = 2,    // persistent settings (read in setup()) executed
+    SETUP_CODEC_ENABLE  = 3,    // codec powered up
+    SETUP_CODEC_INPUT   = 4,    // codec input and microphone bias selected
+    SETUP_CODEC_LEVEL   = 5,    // codec input level set
+    SETUP_ADC           = 6,    // ADC for the pots configured, background scan started
+    SETUP_CODEC_VOLUME  = 7,    // codec volume set to the (restored) master volume
+    SETUP_DONE          = 8
+};
+
 enum midi_nrpn_selection {
-    NRPN_NOTHING                       = 0,   // not a nrpn nrpn value, where a null pointer is needed
-    NRPN_ID_KEYER                      = 1,   // identify this keyer for the correspondent
-    NRPN_ID_VERSION                    = 2,   // identify this keyer version for the correspondent
-    NRPN_NNRPN                         = 3,   // return how many NRPNs are allocated
-    NRPN_NRPN_QUERY                    = 4,   // take the value as a nrpn number and send that nrpns value, no response if no value set
-    NRPN_NRPN_UNSET                    = 5,   // take the value as a nrpn number and make that nrpn NRPNV_NOTSET
-    MIDI_NRPN_WM8960_ENABLE            = 11,
-    MIDI_NRPN_WM8960_INPUT_LEVEL       = 12,
-    MIDI_NRPN_WM8960_INPUT_SELECT      = 13,
-    MIDI_NRPN_WM8960_VOLUME            = 14,
-    MIDI_NRPN_WM8960_HEADPHONE_VOLUME  = 15,
-    MIDI_NRPN_WM8960_HEADPHONE_POWER   = 16,
-    MIDI_NRPN_WM8960_SPEAKER_VOLUME    = 17,
-    MIDI_NRPN_WM8960_SPEAKER_POWER     = 18,
-    MIDI_NRPN_WM8960_DISABLE_ADCHPF    = 19,
-    MIDI_NRPN_WM8960_ENABLE_MICBIAS    = 20,
-    MIDI_NRPN_WM8960_ENABLE_ALC        = 21,
-    MIDI_NRPN_WM8960_MIC_POWER         = 22,
-    MIDI_NRPN_WM8960_LINEIN_POWER      = 23,
-    MIDI_NRPN_WM8960_RAW_MASK          = 24,
-    MIDI_NRPN_WM8960_RAW_DATA          = 25,
-    MIDI_NRPN_WM8960_RAW_WRITE         = 26,
-    MIDI_NRPN_KEYDOWN_NOTE             = 27,
-    MIDI_NRPN_PTT_NOTE                 = 28
+    NRPN_NOTHING = 0,   // not a nrpn nrpn value, where a null pointer is needed
+    CWKEYER_PARAMETERS(CWKEYER_ENUM_IGNORE, CWKEYER_ENUM_NRPN, CWKEYER_ENUM_NRPN, CWKEYER_ENUM_NRPN)
 };
 
 //
@@ -137,14 +185,20 @@ public:
                    int midi_keydown_nt  = 17,
                    int midi_ptt_nt      = 18)
                    :
-    sine(),
     usbaudioinput(),
+    cwdecoder(),
+    vox(),
     teensyaudiotone(),
     patchinl (usbaudioinput,   0, teensyaudiotone, 0),
     patchinr (usbaudioinput,   1, teensyaudiotone, 1),
-    patchwav (sine,            0, teensyaudiotone, 2)
+    patchdecoder (usbaudioinput, 0, cwdecoder,     0),
+    patchvoxrx (usbaudioinput,   0, vox,           2),
+    patchusboutl (vox,           0, usbaudiooutput, 0),
+    patchusboutr (vox,           1, usbaudiooutput, 1)
     {
       nrpn_init();              // because any of these could be aliases to nrpn values
+      for (int i = 0; i < NCODEC; i++) codec_pending[i] = codec_shadow[i] = NRPNV_NOTSET;
+      for (int i = 0; i < 64; i++) codec_reg_known[i] = 0;
       Pin_SideToneFrequency = pin_sidefreq;
       Pin_SideToneVolume    = pin_sidevol;
       Pin_MasterVolume      = pin_mastervol;
@@ -193,14 +247,23 @@ public:
       }
       if (audioin) {
         //
-        // Connect I2S audio input to USB audio out
+        // Connect I2S audio input to USB audio out, through the VOX
         //
-        patchusboutl = new AudioConnection(*audioin, 0, usbaudiooutput, 0);
-        patchusboutr = new AudioConnection(*audioin, 1, usbaudiooutput, 1);
+        patchvoxl = new AudioConnection(*audioin, 0, vox, 0);
+        patchvoxr = new AudioConnection(*audioin, 1, vox, 1);
       }
     }
 
     int8_t ctrls[128];          // current values of controls
+    uint64_t ctrls_set[2] = {0, 0};  // bit mask of controls that have a value
+    void ctrl_store(const uint8_t cc, const uint8_t value) {
+        if (!ctrl_is_set(cc) || ctrls[cc & 0x7f] != (value & 0x7f)) param_changed(cc & 0x7f);
+        ctrls[cc & 0x7f] = value & 0x7f;
+        ctrls_set[(cc >> 6) & 1] |= 1ULL << (cc & 63);
+    }
+    bool ctrl_is_set(const uint8_t cc) {
+        return (ctrls_set[(cc >> 6) & 1] >> (cc & 63)) & 1;
+    }
     static const unsigned NNRPN = 128;  // number of NRPNs maintained
     int16_t nrpns[NNRPN];         // current values of NRPNs
     void nrpn_init(void) {
@@ -217,6 +280,10 @@ public:
     bool nrpn_is_set(const int16_t nrpn) { // nrpn value has been set
         return nrpn_is_valid(nrpn) && nrpns[nrpn] != NRPNV_NOTSET;
     }
+    void nrpn_report(const int16_t nrpn, const uint32_t value) { // send a status value, limited to 14 bits
+        nrpns[nrpn] = value > 0x3fff ? 0x3fff : value;
+        nrpn_send(nrpn);
+    }
 
     void setup(void);                                           // to be executed once upon startup
     void loop(void);                                            // to be executed at each heart beat
@@ -225,7 +292,9 @@ public:
     void hwptt(int state);                                      // set hardware PTT
     void midiptt(int state);                                    // send MIDI PTT event
     void mastervolume(uint8_t level);                           // set master volume
+    void masterbalance(uint8_t balance);                        // set RX audio stereo balance
     void sidetonevolume(uint8_t level);                         // Change side tone volume
+    void sidetonepan(uint8_t pan);                              // set side tone stereo position
     void sidetonefrequency(uint8_t freq);                       // Change side tone frequency
     void cwspeed(uint8_t speed);                                // send CW speed event
     void sidetoneenable(int onoff) {                            // enable/disable side tone
@@ -246,19 +315,157 @@ public:
 
 private:
     void monitor_ptt(void);                                     // monitor PTT-in line, do PTT
+    static void ptt_isr(void);                                  // PTT-in edge interrupt
+    void ptt_accept(uint8_t state, uint32_t edge, bool isr);    // take a de-bounced PTT-in state
+    void midiptt_send(int state, unsigned long when);           // send MIDI PTT event of time "when"
     void midi(void);                                            // MIDI loop
     void pots(void);                                            // Potentiometer loop
-    void adjust(void);                                          // slowly adjust SideTone/Master volume
-    void process_nrpn(const int16_t nrpn_cc, const int16_t nrpn_val); // Process NRPN midi messages
-    AudioSynthWaveformSine  sine;               // free-running side tone oscillator
+    void midi_cc(uint8_t channel, uint8_t data1, uint8_t data2);  // Process MIDI control change
+    void midi_cc_run(bool all);                                 // execute queued control changes
+    void midi_cc_queue(uint8_t cc, uint8_t value);              // queue a control change response
+    void midi_out_service(void);                                // send queued control change responses
+    int  midi_out_queue_depth(void);                            // number of queued control change responses
+    void codec_queue(const int16_t nrpn, const int16_t value);  // queue a WM8960 command
+    void codec_queue_raw(const int16_t reg, const int16_t data, const int16_t mask, const bool force);
+    void codec_execute(const int16_t nrpn_cc, const int16_t nrpn_val); // execute a WM8960 command
+    void codec_service(void);                                   // execute one queued codec write
+    int  codec_queue_depth(void);                               // number of queued codec writes
+    void decoder_service(void);                                 // send decoded characters
+    void setup_service(void);                                   // execute the next startup stage
+    void event_send(uint8_t event, uint8_t state, unsigned long when);  // send SYSEX_EVENT
+    void clock_send(uint16_t tag, unsigned long when);          // send SYSEX_CLOCK
+    void clock_service(void);                                   // send periodic SYSEX_CLOCK
+    void key_output(int state, unsigned long when);             // key outputs except the side tone
+    void playout_queue(uint8_t state, unsigned long stamp);     // queue a key transition from the host
+    void playout_service(void);                                 // play queued key transitions
+    void cc_dispatch(uint8_t cc, uint8_t value);                // set a control, and execute it
+    void param_changed(uint16_t index);                         // a control or NRPN has a new value
+    void report_change(uint16_t index);                         // mark a parameter for reporting
+    void report_service(void);                                  // send SYSEX_REPORT for subscribed changes
+    void persist_restore(void);                                 // read settings from EEPROM into ctrls[], nrpns[]
+    void persist_apply(void);                                   // execute the restored settings
+    void persist_service(void);                                 // save changed settings to EEPROM
+    uint16_t persist_build(void);                               // assemble a record of the settings
+    void sysex(const uint8_t *data, uint16_t len);              // process incoming SysEx message
+    void sysex_send(uint8_t command, const uint8_t *payload, uint16_t len);
+    void sysex_dump(void);                                      // send NRPN and control dumps
+    uint8_t sysex_restore_nrpns(const uint8_t *payload, uint16_t len);
+    uint8_t sysex_restore_ctrls(const uint8_t *payload, uint16_t len);
+
+    //
+    // Dispatch of MIDI controls and NRPNs. There is one entry per CC number
+    // and per NRPN number, generated from CWKeyerParameters.h, see
+    // CWKeyerShield.cpp. Setters get the CC/NRPN number and the value
+    // (already clamped to the range of the parameter), getters return the
+    // value of a status NRPN.
+    //
+    struct param;
+    struct param_table;
+    static const param_table params;
+
+    void cc_store(int16_t num, int16_t value)               { }
+    void cc_nrpn_value(int16_t num, int16_t value)          { nrpn_set((ctrls[MIDI_NRPN_CC_MSB] << 7) | ctrls[MIDI_NRPN_CC_LSB],
+                                                                       (ctrls[MIDI_NRPN_VAL_MSB] << 7) | value); }
+    void cc_master_volume(int16_t num, int16_t value)       { mastervolume(value); }
+    void cc_master_balance(int16_t num, int16_t value)      { masterbalance(value); }
+    void cc_master_pan(int16_t num, int16_t value)          { sidetonepan(value); }
+    void cc_sidetone_volume(int16_t num, int16_t value)     { sidetonevolume(value); }
+    void cc_sidetone_frequency(int16_t num, int16_t value)  { sidetonefrequency(value); }
+    void cc_enable_pots(int16_t num, int16_t value)         { enable_pots = value; }
+    void cc_keyer_autoptt(int16_t num, int16_t value)       { keyer_autoptt_set(value); }    // report to keyer
+    void cc_response(int16_t num, int16_t value)            { midi_controller_response = value; }
+    void cc_mute_cwptt(int16_t num, int16_t value)          { mute_on_cwptt = value; }
+    void cc_micptt_hwptt(int16_t num, int16_t value)        { micptt_hwptt = value; }
+    void cc_cwptt_hwptt(int16_t num, int16_t value)         { cwptt_hwptt = value; }
+    void cc_keyer_hang(int16_t num, int16_t value)          { keyer_hang_set(value); }       // report to keyer
+    void cc_keyer_leadin(int16_t num, int16_t value)        { keyer_leadin_set(value); }     // report to keyer
+    void cc_cw_speed(int16_t num, int16_t value);
+
+    void nrpn_query(int16_t num, int16_t value);
+    void nrpn_unset(int16_t num, int16_t value);
+    void nrpn_codec(int16_t num, int16_t value)             { codec_queue(num, value); }
+    void nrpn_codec_raw_mask(int16_t num, int16_t value)    { wm8960_raw_mask = value; }
+    void nrpn_codec_raw_data(int16_t num, int16_t value)    { wm8960_raw_data = value; }
+    void nrpn_codec_raw_write(int16_t num, int16_t value);
+    void nrpn_keydown_note(int16_t num, int16_t value)      { midi_keydown_note = value; }  // 128-255: off
+    void nrpn_ptt_note(int16_t num, int16_t value)          { midi_ptt_note = value; }      // 128-255: off
+    void nrpn_window_shape(int16_t num, int16_t value)      { keying_shape = value; teensyaudiotone.setWindow(keying_shape, keying_rise); }
+    void nrpn_window_risetime(int16_t num, int16_t value)   { keying_rise = value;  teensyaudiotone.setWindow(keying_shape, keying_rise); }
+    void nrpn_sidetone_frequency(int16_t num, int16_t value);
+    void nrpn_duck_depth(int16_t num, int16_t value)        { duck_depth_db = value; duck(); }
+    void nrpn_duck_attack(int16_t num, int16_t value)       { duck_attack = value;   duck(); }
+    void nrpn_duck_release(int16_t num, int16_t value)      { duck_release = value;  duck(); }
+    void nrpn_decoder_enable(int16_t num, int16_t value)    { cwdecoder.enable(value); }
+    void nrpn_decoder_frequency(int16_t num, int16_t value) { cwdecoder.frequency((float) value); }
+    void nrpn_rx_filter_bandwidth(int16_t num, int16_t value) { teensyaudiotone.rxFilter(value); }
+    void nrpn_midi_cc_interval(int16_t num, int16_t value)  { midi_cc_interval = value; }
+    void nrpn_vox_enable(int16_t num, int16_t value)        { vox.enable(value); }
+    void nrpn_vox_threshold(int16_t num, int16_t value)     { vox_threshold = value; vox_setup(); }
+    void nrpn_vox_attack(int16_t num, int16_t value)        { vox_attack = value;    vox_setup(); }
+    void nrpn_vox_hold(int16_t num, int16_t value)          { vox_hold = value;      vox_setup(); }
+    void nrpn_vox_antivox(int16_t num, int16_t value)       { vox_antivox = value;   vox_setup(); }
+    void nrpn_subscribe(int16_t num, int16_t value);
+    void nrpn_unsubscribe(int16_t num, int16_t value);
+    void nrpn_resync(int16_t num, int16_t value);
+    void nrpn_persist_clear(int16_t num, int16_t value)     { persist_clear = true; }
+    void nrpn_boot_timeline(int16_t num, int16_t value);
+    void nrpn_timestamps(int16_t num, int16_t value)        { timestamps = value; }
+    void nrpn_clock_interval(int16_t num, int16_t value)    { clock_interval = value; }
+    void nrpn_playout_delay(int16_t num, int16_t value)     { playout_delay = value; playout_anchored = false; }
+    void nrpn_ptt_debounce(int16_t num, int16_t value)      { ptt_debounce = value; ptt_debounce_cycles = value * (F_CPU_ACTUAL / 1000); }
+    void nrpn_ptt_latency_bin(int16_t num, int16_t value)   { nrpn_report(NRPN_PTT_LATENCY_COUNT, ptt_latency_hist[value]); }
+
+    uint32_t get_id_keyer(void)               { return NRPNV_ID_KEYER; }
+    uint32_t get_id_version(void)             { return NRPNV_ID_VERSION; }
+    uint32_t get_nnrpn(void)                  { return NNRPN; }
+    uint32_t get_tone_cycles(void)            { return teensyaudiotone.updateCycles(); }
+    uint32_t get_tone_cycles_max(void)        { return teensyaudiotone.updateCyclesMax(); }
+    uint32_t get_audio_memory_max(void)       { return AudioMemoryUsageMax(); }
+    uint32_t get_audio_alloc_failures(void)   { return teensyaudiotone.allocFailures(); }
+    uint32_t get_codec_queue_depth(void)      { return codec_queue_depth(); }
+    uint32_t get_codec_time(void)             { return codec_time; }
+    uint32_t get_codec_time_max(void)         { return codec_time_max; }
+    uint32_t get_decoder_cycles_max(void)     { return cwdecoder.updateCyclesMax(); }
+    uint32_t get_rx_filter_cycles_max(void)   { return teensyaudiotone.rxFilterCyclesMax(); }
+    uint32_t get_midi_dropped(void)           { return midi_dropped; }
+    uint32_t get_midi_deferred(void)          { return midi_deferred; }
+    uint32_t get_midi_late(void)              { return midi_late; }
+    uint32_t get_midi_out_queue_depth(void)   { return midi_out_queue_depth(); }
+    uint32_t get_midi_out_latency(void)       { return midi_cc_latency; }
+    uint32_t get_midi_out_latency_max(void)   { return midi_cc_latency_max; }
+    uint32_t get_midi_cc_cycles(void)         { return midi_cc_cycles; }
+    uint32_t get_midi_cc_cycles_max(void)     { return midi_cc_cycles_max; }
+    uint32_t get_report_sequence(void)        { return report_sequence; }
+    uint32_t get_persist_writes(void)         { return persist_writes; }
+    uint32_t get_persist_time_max(void)       { return persist_time_max; }
+    uint32_t get_boot_stage(void)             { return setup_stage; }
+    uint32_t get_playout_depth(void)          { return (playout_head - playout_tail) & (PLAYOUT_LENGTH - 1); }
+    uint32_t get_playout_depth_max(void)      { return playout_depth_max; }
+    uint32_t get_playout_late(void)           { return playout_late; }
+    uint32_t get_playout_dropped(void)        { return playout_dropped; }
+    uint32_t get_ptt_bounces(void)            { return ptt_bounces; }
+    uint32_t get_ptt_midi_latency_max(void)   { return ptt_midi_latency_max; }
+
     AudioInputUSB           usbaudioinput;      // Audio in from Computer
+    //
+    // The decoder and the VOX must come before the side tone mixer: objects are
+    // updated in the order of construction, and once they have released their
+    // references to the "L" block, the mixer can still work on it in place.
+    // The USB output must come after the VOX, otherwise the microphone audio
+    // would wait one more block on its way to the computer.
+    //
+    CWDecoder               cwdecoder;          // CW decoder on the RX audio
+    TeensyAudioVox          vox;                // VOX on the microphone audio
     AudioOutputUSB          usbaudiooutput;     // Audio out to Computer
-    TeensyAudioTone         teensyaudiotone;    // Side tone mixer
+    TeensyAudioTone         teensyaudiotone;    // Side tone oscillator and mixer
     AudioConnection         patchinl;           // Cable "L" from Audio-in to side tone mixer
     AudioConnection         patchinr;           // Cable "R" from Audio-in to side tone mixer
-    AudioConnection         patchwav;           // Mono-Cable from Side tone oscillator to side tone mixer
-    AudioConnection         *patchusboutl=NULL;
-    AudioConnection         *patchusboutr=NULL;
+    AudioConnection         patchdecoder;       // Cable "L" from Audio-in to CW decoder
+    AudioConnection         patchvoxrx;         // Cable "L" from Audio-in to VOX (anti-VOX)
+    AudioConnection         patchusboutl;       // Cable "L" from VOX to Audio-out
+    AudioConnection         patchusboutr;       // Cable "R" from VOX to Audio-out
+    AudioConnection         *patchvoxl=NULL;    // Cable "L" from microphone to VOX
+    AudioConnection         *patchvoxr=NULL;    // Cable "R" from microphone to VOX
     //
     // These are dynamically created, since they depend on the actual
     // audio output device
@@ -287,17 +494,158 @@ private:
     uint8_t micptt_hwptt      = 1;
     uint8_t cwptt_hwptt       = 1;
 
+    // Startup stage to be executed next, and micros() time each stage was completed
+    uint8_t  setup_stage = SETUP_START;
+    uint32_t setup_time[SETUP_DONE] = {};
+
+    //
+    // Timestamped key and PTT events, see event_send()
+    //
+    uint8_t  timestamps     = 0;                     // send SYSEX_EVENT and SYSEX_CLOCK
+    uint8_t  event_sequence = 0;                     // 7 bits, counts SYSEX_EVENT messages
+    uint16_t clock_interval = 1000;                  // time between periodic SYSEX_CLOCK (milli-seconds)
+    unsigned long clock_last = 0;                    // millis() time of the last periodic SYSEX_CLOCK
+
+    //
+    // Playout buffer for keying from the host, see playout_queue().
+    // Entries between playout_tail and playout_tone have been handed to
+    // the side tone already, their other outputs are still due.
+    //
+    static const uint8_t  PLAYOUT_LENGTH  = 32;          // must be a power of two
+    static const long     PLAYOUT_LEAD_US = 10000;       // side tone is queued this much ahead
+    static const unsigned long PLAYOUT_IDLE_US = 1000000;  // re-anchor after this much silence
+    struct playout_event {
+        unsigned long when;     // micros() time at which the transition is played
+        uint8_t  state;
+    };
+    playout_event playout_ring[PLAYOUT_LENGTH];
+    uint8_t  playout_head      = 0;
+    uint8_t  playout_tone      = 0;
+    uint8_t  playout_tail      = 0;
+    uint16_t playout_delay     = 0;                  // milli-seconds, 0: key notes are played immediately
+    bool     playout_anchored  = false;
+    unsigned long playout_offset = 0;                // keyer time minus host time stamp
+    unsigned long playout_last   = 0;                // time of the last transition queued
+    uint16_t playout_depth_max = 0;
+    uint16_t playout_late      = 0;
+    uint16_t playout_dropped   = 0;
+
+    // Key state from keyer, see key()
+    uint8_t key_state = 0;
+
     // PTT state from keyer. This flag is set if the keyer wants to
     // activate PTT. The actual PTT switching is done in monitor_ptt()
     uint8_t cwptt_state = 0;
 
     // PTT state of the MIDI and hardware PTT "lines"
-    uint8_t hwptt_state=0;
+    volatile uint8_t hwptt_state=0;
     uint8_t midiptt_state=0;
 
+    //
+    // PTT-in edges, see ptt_isr(). Times are ARM_DWT_CYCCNT values.
+    //
+    static const uint8_t PTT_LATENCY_BINS = 16;
+    volatile uint8_t  ptt_in_state        = 0;   // de-bounced state of the PTT-in line
+    volatile uint8_t  ptt_edge_pending    = 0;   // ptt_in_state changed, not yet seen by monitor_ptt()
+    volatile uint32_t ptt_edge_cycles     = 0;   // time of the last accepted edge
+    volatile uint32_t ptt_raw_cycles      = 0;   // time of the last edge, accepted or not
+    uint8_t           ptt_debounce        = 10;  // milli-seconds
+    uint32_t          ptt_debounce_cycles = 0;   // set up in setup()
+    volatile uint32_t ptt_bounces         = 0;
+    volatile uint32_t ptt_latency_hist[PTT_LATENCY_BINS] = {};  // PTT-in edge to PTT-out in ptt_isr(), log2 of CPU cycles
+    unsigned long     ptt_midi_latency_max = 0;  // PTT-in edge to MIDI PTT note (micro-seconds)
+
     // Enable/disable MIDI control change responses
     uint8_t midi_controller_response     = 1;
 
+    //
+    // Queue of incoming MIDI control changes, see midi()
+    //
+    static const int      MIDI_READ_MAX    = 64;     // max. messages read per loop()
+    static const uint16_t MIDI_RING_LENGTH = 256;    // must be a power of two
+    static const unsigned long MIDI_LATE_US = 10000;
+    struct midi_message {
+        unsigned long when;     // micros() time of reception
+        uint8_t  pass;          // loop() pass of reception (low 8 bits)
+        uint8_t  channel;
+        uint8_t  data1;
+        uint8_t  data2;
+    };
+    midi_message midi_ring[MIDI_RING_LENGTH];
+    uint16_t midi_head     = 0;
+    uint16_t midi_tail     = 0;
+    uint8_t  midi_pass     = 0;
+    uint16_t midi_dropped  = 0;
+    uint16_t midi_deferred = 0;
+    uint16_t midi_late     = 0;
+    uint32_t midi_cc_cycles     = 0;     // CPU cycles of the last control change, see midi_cc()
+    uint32_t midi_cc_cycles_max = 0;
+
+    //
+    // Largest SysEx message, an NRPN dump with all NRPNs set. Keep it within
+    // the USB MIDI SysEx buffer, so it arrives in one piece.
+    //
+    static const uint16_t SYSEX_BITMAP = (128 + 6) / 7;
+    static const uint16_t SYSEX_MAX    = 6 + SYSEX_BITMAP + 2 * NNRPN + 2;
+#ifdef USB_MIDI_SYSEX_MAX
+    static_assert(SYSEX_MAX <= USB_MIDI_SYSEX_MAX, "NRPN dump does not fit into USB_MIDI_SYSEX_MAX");
+#endif
+    uint8_t sysex_buffer[SYSEX_MAX];
+
+    //
+    // Change reports, see report_change(). Parameters are indexed by
+    // CC number (0-127) and 128 + NRPN number. Sequence numbers are
+    // 14 bits and never zero, zero in report_changed means "never".
+    //
+    static const uint16_t NREPORT = 128 + NNRPN;
+    uint64_t report_subscribed[NREPORT / 64] = {};   // bit mask of subscribed parameters
+    uint64_t report_pending[NREPORT / 64]    = {};   // bit mask of changes not yet reported
+    uint16_t report_changed[NREPORT]         = {};   // sequence number of the last report including it
+    uint16_t report_sequence = 0;                    // sequence number of the last report sent
+    unsigned long report_last = 0;                   // millis() time of the last report
+    uint16_t report_next_sequence(uint16_t seq) { seq = (seq + 1) & 0x3fff; return seq ? seq : 1; }
+
+    //
+    // Persistent settings, see persist_service(). The EEPROM part is
+    // a ring of slots, each holding one complete record. A slot has room
+    // for every PARAM_PERSIST parameter (PERSIST_ENTRIES, counted from
+    // CWKeyerParameters.h).
+    //
+#define CWKEYER_PERSIST_COUNT(name, num, min, max, flags, ...) + (((flags) & PARAM_PERSIST) ? 1 : 0)
+    static const uint8_t  PERSIST_VERSION = 2;
+    static const uint16_t PERSIST_HEADER = 8;
+    static const uint16_t PERSIST_ENTRIES = 0
+        CWKEYER_PARAMETERS(CWKEYER_PERSIST_COUNT, CWKEYER_PERSIST_COUNT, CWKEYER_ENUM_IGNORE, CWKEYER_ENUM_IGNORE);
+    static const uint16_t PERSIST_SLOT   = PERSIST_HEADER + 3 * PERSIST_ENTRIES;
+    static const uint16_t PERSIST_SLOTS  = CWKEYER_EEPROM_SIZE / PERSIST_SLOT;
+    static_assert(PERSIST_ENTRIES <= 255, "the entry count of a persistent record is one byte");
+    static_assert(CWKEYER_EEPROM_SIZE == 0 || PERSIST_SLOTS >= 1,
+                  "CWKEYER_EEPROM_SIZE is too small for a record of the persistent settings");
+#undef CWKEYER_PERSIST_COUNT
+    static const uint16_t PERSIST_CHUNK  = 8;        // bytes written per loop() pass
+    uint8_t  persist_record[PERSIST_SLOT];           // record being written
+    uint16_t persist_len   = 0;                      // length of persist_record
+    uint16_t persist_pos   = 0;                      // bytes written so far, 0: no write in progress
+    bool     persist_dirty = false;                  // a setting changed since the last record
+    bool     persist_clear = false;                  // invalidate all records
+    unsigned long persist_dirty_time = 0;            // millis() time of the last change
+    uint8_t  persist_slot  = 0;                      // slot of the latest record
+    uint16_t persist_seq   = 0;                      // sequence number of the latest record
+    uint16_t persist_crc   = 0;                      // CRC of the latest record
+    uint16_t persist_writes = 0;                     // records written since startup
+    unsigned long persist_time_max = 0;              // max. time spent in EEPROM writes in a loop()
+
+    //
+    // Pending control change responses, see midi_cc_queue()
+    //
+    uint64_t      midi_cc_pending[2] = {0, 0};   // bit mask of pending controller numbers
+    uint8_t       midi_cc_value[128];            // latest value per controller number
+    unsigned long midi_cc_time[128];             // micros() time the slot became pending
+    unsigned long midi_cc_interval    = 20;      // min. interval between sends (milli-seconds)
+    unsigned long midi_cc_last        = 0;       // millis() time of the last send
+    unsigned long midi_cc_latency     = 0;       // queueing delay of the last response (micro-seconds)
+    unsigned long midi_cc_latency_max = 0;
+
     // Enable/disable POTS
     uint8_t enable_pots       = 1;
 
@@ -319,13 +667,15 @@ private:
     int Pin_Speed             = -1;
 
     //
-    // current states of the analog input lines,
-    // kept for de-noising.
+    // Background scan of the analog input lines, see pots()
     //
-    uint16_t Analog_SideFreq  = 0;
-    uint16_t Analog_SideVol   = 0;
-    uint16_t Analog_MasterVol = 0;
-    uint16_t Analog_Speed     = 0;
+    enum pot_index {
+        POT_MASTER_VOLUME    = 0,
+        POT_SIDETONE_VOLUME  = 1,
+        POT_SIDETONE_FREQ    = 2,
+        POT_SPEED            = 3
+    };
+    TeensyPots potscan;
 
     uint16_t last_sidefreq         = 0;
     uint16_t last_sidevol          = 0;
@@ -334,26 +684,73 @@ private:
 
     int mute_on_cwptt  = 0;                 // If set, Audio from PC is muted while CWPTT is active
 
-    unsigned long last_analog_read = 0;     // time of last analog read
-    unsigned int  last_analog_line=0;       // which line was read last time
-
-    unsigned long last_ptt_read = 0;        // time of last PTT-in reading
-    uint8_t       last_ptt_in = 0;          // state of PTT-in line
     uint8_t       ptt_state = 0;            // PTT state
+    uint8_t       vox_state = 0;            // VOX state
+
+    // Shape and rise time of the keying ramp
+    uint8_t keying_shape   = WINDOW_BLACKMAN_HARRIS;
+    uint8_t keying_rise    = 3;
+
+    //
+    // RX audio ducking during PTT (default: full mute, as a hard mute but click-free)
+    //
+    uint8_t duck_depth_db  = 100;
+    uint8_t duck_attack    = 2;
+    uint8_t duck_release   = 10;
+    void duck(void);
 
     // Accumulators for MIDI commands with multiple data
     int16_t wm8960_raw_mask = -1;
     int16_t wm8960_raw_data = -1;
 
     //
-    // Variables for the "continuous" adjustment of side tone and master volume.
-    // This is meant to reduce audible "cracks" when changing the volume
+    // WM8960 command queue, see codec_queue(). Indexed by
+    // the NRPN number minus MIDI_NRPN_WM8960_ENABLE.
+    //
+    static const int NCODEC = MIDI_NRPN_WM8960_LINEIN_POWER - MIDI_NRPN_WM8960_ENABLE + 1;
+    int16_t  codec_pending[NCODEC];       // value to be written, or NRPNV_NOTSET
+    int16_t  codec_shadow[NCODEC];        // value last written, or NRPNV_NOTSET
+    uint64_t codec_raw_pending = 0;       // bit mask of registers with pending raw writes
+    uint64_t codec_raw_force   = 0;       // bit mask of registers to be written unconditionally
+    uint16_t codec_raw_data[64];          // pending raw register data
+    uint16_t codec_raw_mask[64];          // pending raw register mask
+    uint16_t codec_reg[64];               // register shadow: value last written
+    uint16_t codec_reg_known[64];         // bits of codec_reg[] known to be on the codec
+    int16_t  codec_volume_step = -1;      // master volume step last written, or -1
+    static const uint64_t CODEC_VOLUME_REGS = (1ULL << 2) | (1ULL << 3);  // WM8960 LOUT1, ROUT1
+    static const uint64_t codec_regs[NCODEC];  // registers written per command
+    void codec_touched(uint64_t regs, int cmd);
+    void codec_volume(float level);
+    int  codec_step(float level);
+    unsigned long codec_time     = 0;     // time spent in codec_service() in the last loop()
+    unsigned long codec_time_max = 0;     // max. time spent in codec_service()
+
+    uint8_t decoder_wpm = 0;              // last speed reported by decoder_service()
+
+    // VOX settings, see vox_setup()
+    uint8_t  vox_threshold = 40;          // -dBFS
+    uint16_t vox_attack    = 1;           // milli-seconds
+    uint16_t vox_hold      = 500;         // milli-seconds
+    uint8_t  vox_antivox   = 100;         // dB, 100 = off
+    void vox_setup(void);
+
+    //
+    // Master volume (0.0 ... 1.0), set on the codec (if any). A change is
+    // first ramped on the digital master gain, and handed over to the
+    // codec once the ramp has settled, see codec_service()
     //
-    float sidetonelevel_target;
-    float sidetonelevel_actual;
-    float masterlevel_target;
-    float masterlevel_actual;
-    unsigned long last_adjust=0;
+    static const unsigned long MASTER_HANDOVER_US = 6000;   // audio output latency, two blocks
+    float master_level   = 0.8F;          // master volume requested
+    float master_codec   = 0.8F;          // master volume last written to the codec
+    float master_next    = 0.8F;          // master volume being handed over
+    float master_gain    = 1.0F;          // digital master gain (target)
+    bool  master_pending = false;         // master_level not yet on the codec
+    bool  master_raise   = false;         // handover to a higher codec volume
+    bool  master_handover = false;        // handover in progress
+    unsigned long master_handover_start = 0;
+    float codec_gain(float level);
+    void  master_ramp(void);
+    void  master_service(void);
 
     //
     // Side tone level (amplitude), in 32 steps from zero to one, covering 40 dB
@@ -32,215 +32,849 @@
 #include "TeensyAudioTone.h"
 #include "utility/dspinst.h"
 
-#define WINDOW_TABLE_LENGTH 128
-
-
-#if 0
-//
-// This "ramp" is the raised cosine function itself.
-//
-// Mathematica code to generate it:
-//
-// RC[x_] = 1/2 (1 + Cos[2 Pi x + Pi])
-// Tab = Table[Round[2^31  RC[i/258]], {i, 1, 128}];
-// Do[{l = Table[PaddedForm[Tab[[j]], 12], {j, 8*i + 1, 8*i + 8}], Print[Row[l, ","], ","]}, {i, 0, 15}]
-//
-// SciPy code to generate it:
-//
-//import numpy as np
-//import scipy.signal
-//a = np.round((2**31)*scipy.signal.windows.hann(259))
-//for i in range(1,129):
-//  if (i-1)%8 == 0: print()
-//  print("{:10d}".format(int(a[i])),end=", ")
-const int32_t window_table[WINDOW_TABLE_LENGTH] = {
-    318397,    1273398,    2864439,    5090574,    7950483,   11442471,   15564467,   20314026,
-  25688331,   31684195,   38298062,   45526009,   53363751,   61806638,   70849664,   80487465,
-  90714326,  101524182,  112910621,  124866892,  137385902,  150460228,  164082115,  178243486,
- 192935941,  208150767,  223878941,  240111135,  256837722,  274048782,  291734109,  309883213,
- 328485332,  347529432,  367004221,  386898147,  407199413,  427895979,  448975571,  470425686,
- 492233605,  514386393,  536870912,  559673828,  582781618,  606180576,  629856827,  653796328,
- 677984882,  702408144,  727051629,  751900723,  776940687,  802156673,  827533725,  853056793,
- 878710740,  904480353,  930350348,  956305383,  982330065, 1008408960, 1034526600, 1060667498,
-1086816150, 1112957048, 1139074688, 1165153583, 1191178265, 1217133300, 1243003295, 1268772908,
-1294426855, 1319949923, 1345326975, 1370542961, 1395582925, 1420432019, 1445075504, 1469498766,
-1493687320, 1517626821, 1541303072, 1564702030, 1587809820, 1610612736, 1633097255, 1655250043,
-1677057962, 1698508077, 1719587669, 1740284235, 1760585501, 1780479427, 1799954216, 1818998316,
-1837600435, 1855749539, 1873434866, 1890645926, 1907372513, 1923604707, 1939332881, 1954547707,
-1969240162, 1983401533, 1997023420, 2010097746, 2022616756, 2034573027, 2045959466, 2056769322,
-2066996183, 2076633984, 2085677010, 2094119897, 2101957639, 2109185586, 2115799453, 2121795317,
-2127169622, 2131919181, 2136041177, 2139533165, 2142393074, 2144619209, 2146210250, 2147165251,
+extern "C" {
+extern const int16_t AudioWaveformSine[257];
+}
+
+//
+// The keying "ramps" are step functions rising from zero to one within
+// the rise time. They are computed by the compiler for the actual sample
+// rate, so there is no trig at run time and no hand-pasted tables.
+// Each table has N = rise time * sample rate entries, and entry i (i=0...N-1)
+// is the value of the step function at x = (i+1)/(N+1), scaled to 2^31.
+//
+// WINDOW_RAISED_COSINE: the raised cosine function itself
+//
+//   RC(x) = 1/2 (1 - Cos[Pi x])
+//
+// WINDOW_INTEGRATED_RAISED_COSINE: step function from a raised cosine window
+//
+//   RCI(x) = x - Sin[2 Pi x]/(2 Pi)
+//
+// WINDOW_BLACKMAN_HARRIS: step function from a Blackman-Harris window
+//
+//   BHI(x) = (a0 x - a1 Sin[2 Pi x]/(2 Pi) + a2 Sin[4 Pi x]/(4 Pi) - a3 Sin[6 Pi x]/(6 Pi)) / a0
+//
+//   a0 = 0.35875, a1 = 0.48829, a2 = 0.14128, a3 = 0.01168
+//
+// With 128 entries, these tables are identical to the Mathematica generated
+// tables used before.
+//
+// The Blackman-Harris step gives the narrowest spectrum of the three and is the
+// default. The rise time should be shortened at very high speeds only.
+//
+
+namespace {
+
+constexpr double WINDOW_PI = 3.14159265358979323846;
+
+//
+// Sine function that can be evaluated at compile time
+// (range reduction to [-Pi, Pi], then Taylor series)
+//
+constexpr double ct_sin(double x)
+{
+    while (x >  WINDOW_PI) x -= 2*WINDOW_PI;
+    while (x < -WINDOW_PI) x += 2*WINDOW_PI;
+    double term = x;
+    double sum  = x;
+    for (int n = 1; n < 14; n++) {
+        term *= -x*x / ((2*n) * (2*n + 1));
+        sum  += term;
+    }
+    return sum;
+}
+
+constexpr double ct_cos(double x)
+{
+    return ct_sin(x + WINDOW_PI/2);
+}
+
+constexpr double window_step(int shape, double x)
+{
+    return (shape == WINDOW_RAISED_COSINE)
+           ? 0.5 * (1.0 - ct_cos(WINDOW_PI * x))
+           : (shape == WINDOW_INTEGRATED_RAISED_COSINE)
+           ? x - ct_sin(2*WINDOW_PI * x) / (2*WINDOW_PI)
+           : (0.35875 * x
+              - 0.48829 * ct_sin(2*WINDOW_PI * x) / (2*WINDOW_PI)
+              + 0.14128 * ct_sin(4*WINDOW_PI * x) / (4*WINDOW_PI)
+              - 0.01168 * ct_sin(6*WINDOW_PI * x) / (6*WINDOW_PI)) / 0.35875;
+}
+
+template <int SHAPE, unsigned RISE_MS, unsigned RATE>
+struct window_generator
+{
+    static constexpr uint16_t length = (RISE_MS * RATE + 500) / 1000;
+    int32_t data[length];
+
+    constexpr window_generator() : data()
+    {
+        for (unsigned i = 0; i < length; i++) {
+            double v = 2147483648.0 * window_step(SHAPE, (double)(i + 1) / (length + 1)) + 0.5;
+            data[i] = (v >= 2147483647.0) ? 2147483647 : (v <= 0.0) ? 0 : (int32_t) v;
+        }
+    }
 };
-#endif
 
-#if 0
-//
-// Step function from a RaisedCosine window. Mathematica code:
-//
-// RC[x_] = 1/2 (1 + Cos[2 Pi x + Pi])
-// RCI[y_] = Integrate[RC[x], {x, 0, y}]
-// Tab = Table[Round[2^31  RCI[i/129]/RCI[1]], {i, 1, 128}];
-// Do[{l = Table[PaddedForm[Tab[[j]], 12], {j, 8*i + 1, 8*i + 8}], Print[Row[l, ","], ","]}, {i, 0, 15}]
-//
-const int32_t window_table[WINDOW_TABLE_LENGTH] = {
-         6581,        52632,       177529,       420460,       820335,      1415690,      2244599,      3344580,
-      4752510,      6504535,      8635984,     11181287,     14173892,     17646185,     21629417,     26153625,
-     31247563,     36938634,     43252825,     50214644,     57847064,     66171467,     75207593,     84973495,
-     95485495,    106758145,    118804192,    131634549,    145258270,    159682527,    174912590,    190951822,
-    207801665,    225461638,    243929338,    263200447,    283268743,    304126109,    325762560,    348166263,
-    371323562,    395219017,    419835436,    445153916,    471153890,    497813174,    525108021,    553013175,
-    581501933,    610546210,    640116599,    670182449,    700711932,    731672120,    763029066,    794747877,
-    826792808,    859127335,    891714249,    924515745,    957493504,    990608794,   1023822553,   1057095487,
-   1090388161,   1123661095,   1156874854,   1189990144,   1222967903,   1255769399,   1288356313,   1320690840,
-   1352735771,   1384454582,   1415811528,   1446771716,   1477301199,   1507367049,   1536937438,   1565981715,
-   1594470473,   1622375627,   1649670474,   1676329758,   1702329732,   1727648212,   1752264631,   1776160086,
-   1799317385,   1821721088,   1843357539,   1864214905,   1884283201,   1903554310,   1922022010,   1939681983,
-   1956531826,   1972571058,   1987801121,   2002225378,   2015849099,   2028679456,   2040725503,   2051998153,
-   2062510153,   2072276055,   2081312181,   2089636584,   2097269004,   2104230823,   2110545014,   2116236085,
-   2121330023,   2125854231,   2129837463,   2133309756,   2136302361,   2138847664,   2140979113,   2142731138,
-   2144139068,   2145239049,   2146067958,   2146663313,   2147063188,   2147306119,   2147431016,   2147477067
+const unsigned WINDOW_RATE = (unsigned) AUDIO_SAMPLE_RATE_EXACT;
+
+constexpr window_generator<WINDOW_RAISED_COSINE,            2, WINDOW_RATE> rc_2ms;
+constexpr window_generator<WINDOW_RAISED_COSINE,            3, WINDOW_RATE> rc_3ms;
+constexpr window_generator<WINDOW_RAISED_COSINE,            4, WINDOW_RATE> rc_4ms;
+constexpr window_generator<WINDOW_RAISED_COSINE,            5, WINDOW_RATE> rc_5ms;
+constexpr window_generator<WINDOW_RAISED_COSINE,            6, WINDOW_RATE> rc_6ms;
+constexpr window_generator<WINDOW_INTEGRATED_RAISED_COSINE, 2, WINDOW_RATE> irc_2ms;
+constexpr window_generator<WINDOW_INTEGRATED_RAISED_COSINE, 3, WINDOW_RATE> irc_3ms;
+constexpr window_generator<WINDOW_INTEGRATED_RAISED_COSINE, 4, WINDOW_RATE> irc_4ms;
+constexpr window_generator<WINDOW_INTEGRATED_RAISED_COSINE, 5, WINDOW_RATE> irc_5ms;
+constexpr window_generator<WINDOW_INTEGRATED_RAISED_COSINE, 6, WINDOW_RATE> irc_6ms;
+constexpr window_generator<WINDOW_BLACKMAN_HARRIS,          2, WINDOW_RATE> bh_2ms;
+constexpr window_generator<WINDOW_BLACKMAN_HARRIS,          3, WINDOW_RATE> bh_3ms;
+constexpr window_generator<WINDOW_BLACKMAN_HARRIS,          4, WINDOW_RATE> bh_4ms;
+constexpr window_generator<WINDOW_BLACKMAN_HARRIS,          5, WINDOW_RATE> bh_5ms;
+constexpr window_generator<WINDOW_BLACKMAN_HARRIS,          6, WINDOW_RATE> bh_6ms;
+
+const uint8_t WINDOW_MIN_RISE_MS = 2;   // rise time of the first table in each row
+
+struct window_desc {
+    const int32_t *table;
+    uint16_t       length;
 };
-#endif
 
-// Blackman-Harris Window. Mathematica code.
-//
-// a0 = 0.3587500000000000000000000000000000000000000000000000;
-// a1 = 0.4882900000000000000000000000000000000000000000000000;
-// a2 = 0.1412800000000000000000000000000000000000000000000000;
-// a3 = 0.0116800000000000000000000000000000000000000000000000;
-//
-// BH[x_] = a0 - a1 Cos[2 Pi x] + a2 Cos[4 Pi x] - a3 Cos[6 Pi x];
-// BHIHI[y_] = Integrate[BH[x], {x, 0, y}]
-// Tab = Table[Round[2^31 BHI[i/129]/BHI[1]], {i, 1, 128}];
-// Do[{l = Table[PaddedForm[Tab[[j]], 12], {j, 8*i + 1, 8*i + 8}], Print[Row[l, ","], ","]}, {i, 0, 15}]
-//
-const int32_t window_table[WINDOW_TABLE_LENGTH] = {
-         3305,         9778,        22804,        46197,        84420,       142798,       227731,       346909,
-       509525,       726474,      1010566,      1376713,      1842122,      2426465,      3152045,      4043938,
-      5130118,      6441557,      8012296,      9879493,     12083427,     14667468,     17678014,     21164373,
-     25178607,     29775326,     35011439,     40945845,     47639087,     55152951,     63550020,     72893188,
-     83245126,     94667721,    107221476,    120964892,    135953824,    152240832,    169874519,    188898887,
-    209352690,    231268820,    254673713,    279586805,    306020025,    333977346,    363454400,    394438165,
-    426906721,    460829093,    496165178,    532865761,    570872623,    610118743,    650528584,    692018482,
-    734497114,    777866051,    822020396,    866849483,    912237655,    958065083,   1004208652,   1050542864,
-   1096940784,   1143274996,   1189418565,   1235245993,   1280634165,   1325463252,   1369617597,   1412986534,
-   1455465166,   1496955064,   1537364905,   1576611025,   1614617887,   1651318470,   1686654555,   1720576927,
-   1753045483,   1784029248,   1813506302,   1841463623,   1867896843,   1892809935,   1916214828,   1938130958,
-   1958584761,   1977609129,   1995242816,   2011529824,   2026518756,   2040262172,   2052815927,   2064238522,
-   2074590460,   2083933628,   2092330697,   2099844561,   2106537803,   2112472209,   2117708322,   2122305041,
-   2126319275,   2129805634,   2132816180,   2135400221,   2137604155,   2139471352,   2141042091,   2142353530,
-   2143439710,   2144331603,   2145057183,   2145641526,   2146106935,   2146473082,   2146757174,   2146974123,
-   2147136739,   2147255917,   2147340850,   2147399228,   2147437451,   2147460844,   2147473870,   2147480343
+//
+// Indexed by shape * WINDOW_NRISE + (rise time in ms - WINDOW_MIN_RISE_MS)
+//
+constexpr window_desc windows[WINDOW_NSHAPE * WINDOW_NRISE] = {
+    { rc_2ms.data,  rc_2ms.length  }, { rc_3ms.data,  rc_3ms.length  }, { rc_4ms.data,  rc_4ms.length  },
+    { rc_5ms.data,  rc_5ms.length  }, { rc_6ms.data,  rc_6ms.length  },
+    { irc_2ms.data, irc_2ms.length }, { irc_3ms.data, irc_3ms.length }, { irc_4ms.data, irc_4ms.length },
+    { irc_5ms.data, irc_5ms.length }, { irc_6ms.data, irc_6ms.length },
+    { bh_2ms.data,  bh_2ms.length  }, { bh_3ms.data,  bh_3ms.length  }, { bh_4ms.data,  bh_4ms.length  },
+    { bh_5ms.data,  bh_5ms.length  }, { bh_6ms.data,  bh_6ms.length  }
+};
+
+//
+// Regression check of the ramp tables, done by the compiler. Each ramp must
+// - rise monotonically from (almost) zero to (almost) full scale, and
+// - be point-symmetric, s[i] + s[N-1-i] = 2^31 (up to rounding), such that
+//   ramp up and ramp down have the same shape and key-down and key-up
+//   produce the same key click spectrum.
+// A ramp that does not start within 2^-7 of zero (or end within 2^-7 of
+// full scale) would cause a click itself.
+//
+constexpr bool windows_are_valid()
+{
+    for (unsigned k = 0; k < WINDOW_NSHAPE * WINDOW_NRISE; k++) {
+        const int32_t *w = windows[k].table;
+        unsigned       n = windows[k].length;
+
+        if (n < 2 || w[0] < 0 || w[n-1] < 2147483647 - (1 << 24)) return false;
+        if (w[0] > (1 << 24)) return false;
+        for (unsigned i = 1; i < n; i++) {
+            if (w[i] < w[i-1]) return false;
+        }
+        for (unsigned i = 0; i < n; i++) {
+            int64_t sum = (int64_t) w[i] + w[n-1-i];
+            if (sum < 2147483648LL - 2 || sum > 2147483648LL + 2) return false;
+        }
+    }
+    return true;
+}
+
+static_assert(windows_are_valid(), "keying ramp tables are not monotonic and symmetric");
+
+//
+// Processing kernels used by update(). The side tone is rendered segment by
+// segment, and within a segment the phase of the keying envelope (ramp up,
+// steady, ramp down, silence) is fixed, so the kernel is chosen once per
+// segment and the inner loops do not test the envelope state. The oscillator
+// runs within these kernels, so the side tone takes one pass over the block.
+// Mixing works on pairs of 16-bit samples using the dual multiply-add
+// (SMUAD), with one kernel per combination of inputs, gain ramps and ducking.
+//
+// Note on memory placement: on the Teensy 4 all code runs from ITCM and
+// const data (the ramp tables) lives in DTCM by default. Neither the kernels
+// nor the tables must be moved to flash (PROGMEM/FLASHMEM) or OCRAM (DMAMEM).
+//
+enum side_phase {
+    SIDE_RAMP_UP,
+    SIDE_STEADY,
+    SIDE_RAMP_DOWN,
+    SIDE_SILENCE
 };
 
+//
+// Linear gain ramp used for all volume changes. Gains are kept in Q30
+// (1 << 30 is unity), and the step per sample is limited by a saturation
+// (SSAT) to 1 << 21, so a full scale change takes 512 samples (about 11 msec).
+//
+inline int32_t ramp_step(int32_t current, int32_t target)
+{
+    return current + signed_saturate_rshift(target - current, 22, 0);
+}
+
+//
+// Advance a gain ramp by n samples, same result as n calls to ramp_step()
+//
+inline int32_t ramp_block(int32_t current, int32_t target, int n = AUDIO_BLOCK_SAMPLES)
+{
+    int32_t d = target - current;
+
+    if (d > n * ((1 << 21) - 1)) {
+        d = n * ((1 << 21) - 1);
+    } else if (d < -n * (1 << 21)) {
+        d = -n * (1 << 21);
+    }
+    return current + d;
+}
+
+//
+// Render n samples of one envelope phase. The side tone comes from a
+// numerically controlled oscillator: sine table lookup with linear
+// interpolation, as in AudioSynthWaveformSine, with the amplitude following
+// its gain ramp if RAMP is set. The oscillator runs within the kernel, so
+// each sample is computed in a single pass; in silence only the phase and
+// the gain advance.
+// For ramp up, "window" points to the first table entry to use,
+// for ramp down it points just past the first entry to use.
+// Returns the new phase.
+//
+template <int PHASE, bool RAMP>
+inline uint32_t side_kernel(int16_t *dst, uint32_t ph, uint32_t inc, int32_t &gain, int32_t target,
+                            const int32_t *window, int n)
+{
+    uint32_t index, scale;
+    int32_t  val1, val2, t, g;
+
+    if (PHASE == SIDE_SILENCE) {
+        if (n <= 0) return ph;
+        memset(dst, 0, n * sizeof(int16_t));
+        if (RAMP) gain = ramp_block(gain, target, n);
+        return ph + inc * n;
+    }
+    g = gain;
+    while (n-- > 0) {
+        index = ph >> 24;
+        val1  = AudioWaveformSine[index];
+        val2  = AudioWaveformSine[index+1];
+        scale = (ph >> 8) & 0xFFFF;
+        val2 *= scale;
+        val1 *= 0x10000 - scale;
+        if (RAMP) g = ramp_step(g, target);
+        t = multiply_32x32_rshift32(val1 + val2, g >> 14);   // 65536 = full scale
+        ph += inc;
+        if (PHASE == SIDE_RAMP_UP) {
+            t = multiply_32x32_rshift32(t << 1, *window++);
+        } else if (PHASE == SIDE_RAMP_DOWN) {
+            t = multiply_32x32_rshift32(t << 1, *--window);
+        }
+        *dst++ = t;
+    }
+    gain = g;
+    return ph;
+}
+
+//
+// Select the kernel variant: with or without a side tone gain ramp
+//
+template <int PHASE>
+inline uint32_t render_side(int16_t *dst, uint32_t ph, uint32_t inc, int32_t &gain, int32_t target,
+                            const int32_t *window, int n)
+{
+    if (gain != target) {
+        return side_kernel<PHASE, true>(dst, ph, inc, gain, target, window, n);
+    }
+    return side_kernel<PHASE, false>(dst, ph, inc, gain, target, window, n);
+}
+
+//
+// Out = (Side * SideGain + In * RXGain) / 2, computed with a dual 16-bit
+// multiply-add (SMUAD) and a 16-bit saturation (SSAT). With SIDE or RX false,
+// that input is taken as silence. With RAMP, the gains follow their ramps
+// sample by sample, otherwise they are constant. With DUCK, the RX gain is
+// additionally multiplied by the ducking envelope (Q15, 32768 = unity).
+// The gain variables of the caller are not changed, see ramp_block().
+//
+template <bool SIDE, bool RX, bool RAMP, bool DUCK>
+inline void mix_kernel(int16_t *dst, const int16_t *side, const int16_t *in,
+                       int32_t gs, int32_t gs_target, int32_t gr, int32_t gr_target,
+                       const int32_t *duck)
+{
+    uint32_t g = pack_16b_16b(gs >> 16, gr >> 16);   // Q30 gains to Q15, including the 1/2
+
+    for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+        if (RAMP) {
+            gs = ramp_step(gs, gs_target);
+            gr = ramp_step(gr, gr_target);
+            g  = pack_16b_16b(gs >> 16, gr >> 16);
+        }
+        if (DUCK) {
+            g  = pack_16b_16b(gs >> 16, ((gr >> 16) * duck[i]) >> 15);
+        }
+        uint32_t x = pack_16b_16b(SIDE ? side[i] : 0, RX ? in[i] : 0);
+        dst[i] = signed_saturate_rshift(multiply_16tx16t_add_16bx16b(x, g), 16, 15);
+    }
+}
+
+//
+// Select the cheapest kernel. "in" is NULL if there is no RX audio,
+// "duck" is NULL if there is no ducking envelope in this block.
+//
+template <bool SIDE>
+inline void mix(int16_t *dst, const int16_t *side, const int16_t *in,
+                int32_t gs, int32_t gs_target, int32_t gr, int32_t gr_target,
+                const int32_t *duck)
+{
+    bool ramp = (gs != gs_target || gr != gr_target);
+
+    if (!in || (gr == 0 && gr_target == 0 && !duck)) {
+        if (ramp) {
+            mix_kernel<SIDE, false, true,  false>(dst, side, NULL, gs, gs_target, 0, 0, NULL);
+        } else {
+            mix_kernel<SIDE, false, false, false>(dst, side, NULL, gs, gs_target, 0, 0, NULL);
+        }
+    } else if (duck) {
+        mix_kernel<SIDE, true, true,  true >(dst, side, in, gs, gs_target, gr, gr_target, duck);
+    } else if (ramp) {
+        mix_kernel<SIDE, true, true,  false>(dst, side, in, gs, gs_target, gr, gr_target, NULL);
+    } else {
+        mix_kernel<SIDE, true, false, false>(dst, side, in, gs, gs_target, gr, gr_target, NULL);
+    }
+}
+
+//
+// Bandwidths (Hz) available for the RX filter
+//
+const uint16_t rx_filter_bandwidths[] = {100, 150, 200, 300, 500, 800};
+
+} // namespace
+
+void TeensyAudioTone::setWindow(uint8_t shape, uint8_t rise_ms)
+{
+    //
+    // Only record the request, update() switches tables at the start
+    // of the next block.
+    //
+    if (shape >= WINDOW_NSHAPE) shape = WINDOW_BLACKMAN_HARRIS;
+    if (rise_ms < WINDOW_MIN_RISE_MS) rise_ms = WINDOW_MIN_RISE_MS;
+    if (rise_ms >= WINDOW_MIN_RISE_MS + WINDOW_NRISE) rise_ms = WINDOW_MIN_RISE_MS + WINDOW_NRISE - 1;
+    window_request = shape * WINDOW_NRISE + (rise_ms - WINDOW_MIN_RISE_MS);
+}
+
+void TeensyAudioTone::frequency(float freq)
+{
+    if (freq < 0.0F) {
+        freq = 0.0F;
+    } else if (freq > AUDIO_SAMPLE_RATE_EXACT / 2.0F) {
+        freq = AUDIO_SAMPLE_RATE_EXACT / 2.0F;
+    }
+    //
+    // A single 32-bit store, so update() either sees the old or the
+    // new value. The phase accumulator is not touched, so the tone
+    // changes frequency without a phase jump.
+    //
+    phase_increment = freq * (4294967296.0F / AUDIO_SAMPLE_RATE_EXACT);
+
+    //
+    // The RX filter follows the side tone
+    //
+    rx_filter_freq = freq;
+    if (rx_filter_bandwidth) rxFilterDesign();
+}
+
+void TeensyAudioTone::rxFilter(uint16_t bandwidth)
+{
+    if (bandwidth == 0) {
+        rx_filter_bandwidth = 0;
+        rx_filter_request = RX_FILTER_OFF;
+        return;
+    }
+    uint16_t best = rx_filter_bandwidths[0];
+    for (unsigned i = 1; i < sizeof(rx_filter_bandwidths) / sizeof(rx_filter_bandwidths[0]); i++) {
+        if (abs((int) rx_filter_bandwidths[i] - (int) bandwidth) < abs((int) best - (int) bandwidth)) {
+            best = rx_filter_bandwidths[i];
+        }
+    }
+    rx_filter_bandwidth = best;
+    rxFilterDesign();
+}
+
+//
+// Compute the coefficients for the current centre frequency and bandwidth into
+// the bank not in use, and request it. The filter is a cascade of identical
+// band-pass biquads (RBJ, 0 dB peak gain). Two such stages have 0.644 times
+// the -3 dB bandwidth of a single one. The coefficients are in the format
+// of arm_biquad_cascade_df1_fast_q15(), {b0, 0, b1, b2, -a1, -a2}, scaled
+// by 1/2 (postShift 1) since |a1| is close to 2.
+//
+void TeensyAudioTone::rxFilterDesign(void)
+{
+    uint8_t bank;
+
+    //
+    // Replace a pending request by RX_FILTER_HOLD (a single byte store,
+    // no critical section, so this may run with the audio interrupt
+    // disabled by the caller). Any update() after the store keeps the
+    // selected bank, which is then stable, and the other one is free.
+    //
+    rx_filter_request = RX_FILTER_HOLD;
+    __sync_synchronize();
+    bank = (rx_filter_selected == 0) ? 1 : 0;
+
+    float w0    = 2.0F * PI * rx_filter_freq / AUDIO_SAMPLE_RATE_EXACT;
+    float q     = rx_filter_freq * 0.644F / rx_filter_bandwidth;
+    if (q < 0.5F) q = 0.5F;
+    float alpha = sinf(w0) / (2.0F * q);
+    float scale = 16384.0F / (1.0F + alpha);
+    q15_t *c    = rx_filter_coeffs[bank];
+
+    for (int i = 0; i < RX_FILTER_STAGES; i++) {
+        c[6 * i + 0] = alpha * scale;
+        c[6 * i + 1] = 0;
+        c[6 * i + 2] = 0;
+        c[6 * i + 3] = -alpha * scale;
+        c[6 * i + 4] = 2.0F * cosf(w0) * scale;
+        c[6 * i + 5] = -(1.0F - alpha) * scale;
+    }
+    //
+    // Coefficients must be complete before update() can see the request
+    //
+    __sync_synchronize();
+    rx_filter_request = bank;
+}
+
+//
+// Filter one block of RX audio in place. If "from" and "to" differ, both are
+// computed and cross-faded linearly over the block. A new bank takes over
+// the filter state of the previous one, so switching bandwidth or frequency
+// does not restart the filter.
+//
+void TeensyAudioTone::rxFilterBlock(int16_t *data, uint8_t channel, uint8_t from, uint8_t to)
+{
+    int16_t old[AUDIO_BLOCK_SAMPLES] __attribute__ ((aligned (4)));
+
+    if (from == to) {
+        if (data) arm_biquad_cascade_df1_fast_q15(&rx_filter[to][channel], data, data, AUDIO_BLOCK_SAMPLES);
+        return;
+    }
+    if (to != RX_FILTER_OFF) {
+        if (from == RX_FILTER_OFF) {
+            memset(rx_filter_state[to][channel], 0, sizeof(rx_filter_state[to][channel]));
+        } else {
+            memcpy(rx_filter_state[to][channel], rx_filter_state[from][channel],
+                   sizeof(rx_filter_state[to][channel]));
+        }
+    }
+    if (!data) return;
+
+    if (from == RX_FILTER_OFF) {
+        memcpy(old, data, sizeof(old));
+    } else {
+        arm_biquad_cascade_df1_fast_q15(&rx_filter[from][channel], data, old, AUDIO_BLOCK_SAMPLES);
+    }
+    if (to != RX_FILTER_OFF) {
+        arm_biquad_cascade_df1_fast_q15(&rx_filter[to][channel], data, data, AUDIO_BLOCK_SAMPLES);
+    }
+    for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+        data[i] = old[i] + (((int32_t) data[i] - old[i]) * (i + 1) >> 7);
+    }
+}
+
+//
+// Volume changes only set the target, update() ramps to it
+// sample by sample.
+//
+void TeensyAudioTone::amplitude(float level)
+{
+    if (level < 0.0F) {
+        level = 0.0F;
+    } else if (level > 1.0F) {
+        level = 1.0F;
+    }
+    side_gain_target = level * 1073741824.0F;
+}
+
+void TeensyAudioTone::volume(float level)
+{
+    if (level < 0.0F) {
+        level = 0.0F;
+    } else if (level > 1.0F) {
+        level = 1.0F;
+    }
+    master_gain_target = level * 1073741824.0F;
+    master_settled = 0;
+}
+
+void TeensyAudioTone::volumeJump(float from, float to)
+{
+    volume(to);
+    if (from < 0.0F) {
+        from = 0.0F;
+    } else if (from > 1.0F) {
+        from = 1.0F;
+    }
+    master_gain_jump = from * 1073741824.0F;
+}
+
+void TeensyAudioTone::pan(float left, float right)
+{
+    side_pan[0] = (left  < 0.0F) ? 0 : (left  > 1.0F) ? 32768 : (int32_t)(left  * 32768.0F);
+    side_pan[1] = (right < 0.0F) ? 0 : (right > 1.0F) ? 32768 : (int32_t)(right * 32768.0F);
+}
+
+void TeensyAudioTone::balance(float left, float right)
+{
+    rx_balance[0] = (left  < 0.0F) ? 0 : (left  > 1.0F) ? 32768 : (int32_t)(left  * 32768.0F);
+    rx_balance[1] = (right < 0.0F) ? 0 : (right > 1.0F) ? 32768 : (int32_t)(right * 32768.0F);
+}
+
+void TeensyAudioTone::duck(float depth, float attack_ms, float release_ms)
+{
+    if (depth < 0.0F) {
+        depth = 0.0F;
+    } else if (depth > 1.0F) {
+        depth = 1.0F;
+    }
+    if (attack_ms  < 0.1F) attack_ms  = 0.1F;
+    if (release_ms < 0.1F) release_ms = 0.1F;
+    duck_depth   = depth * 1073741824.0F;
+    duck_attack  = 1073741824.0F / (attack_ms  * AUDIO_SAMPLE_RATE_EXACT / 1000.0F);
+    duck_release = 1073741824.0F / (release_ms * AUDIO_SAMPLE_RATE_EXACT / 1000.0F);
+}
+
+void TeensyAudioTone::queueEvent(uint8_t queue, uint8_t state, uint32_t when)
+{
+    uint8_t head = event_head[queue];
+    uint8_t next = (head + 1) & (EVENT_QUEUE_LENGTH - 1);
+
+    if (next == event_tail[queue]) {
+        // queue full, update() is not running
+        dropped_events++;
+        return;
+    }
+    events[queue][head].when  = when;
+    events[queue][head].state = state;
+    //
+    // The event must be completely stored before update() can see it
+    //
+    __sync_synchronize();
+    event_head[queue] = next;
+}
+
+//
+// Take the events of one queue that happened before the end of the current
+// block (last_update + span), and convert their time stamps to sample
+// positions within the block. Events time-stamped in the future remain in
+// the queue. The positions never decrease, as the rendering in updateAt()
+// requires, even if the time stamps of a queue are out of order.
+//
+uint8_t TeensyAudioTone::collectEvents(uint8_t queue, uint32_t span, uint8_t *pos, uint8_t *state)
+{
+    uint8_t tail = event_tail[queue];
+    uint8_t n = 0, p;
+    int32_t dt;
+
+    while (tail != event_head[queue]) {
+        dt = (int32_t)(events[queue][tail].when - last_update);
+        if (dt >= (int32_t) span) break;
+        if (dt < 0) {
+            late_events++;
+            dt = 0;
+        }
+        p = (dt * AUDIO_BLOCK_SAMPLES) / span;
+        if (n && p < pos[n - 1]) p = pos[n - 1];
+        pos[n]   = p;
+        state[n] = events[queue][tail].state;
+        n++;
+        tail = (tail + 1) & (EVENT_QUEUE_LENGTH - 1);
+    }
+    event_tail[queue] = tail;
+    return n;
+}
+
 void TeensyAudioTone::update(void)
 {
-    audio_block_t *block_sine, *block_inl, *block_inr;
-    audio_block_t *block_sidel,*block_sider;
-    int16_t i;
-    int32_t t;
-
-
-    block_inl  = receiveReadOnly(0);
-    block_inr  = receiveReadOnly(1);
-    block_sine = receiveReadOnly(2);
-
-    //
-    // Use block_side[lr] as a "flag" for "playing side tone"
-    // This guarantees that we do not "hang" in the "window_index > 0" state
-    // if allocation of block_side[lr] constantly fails.
-    //
-    block_sidel = block_sider = NULL;
-    if ((tone || windowindex || mute) && block_sine && sidetone_enabled) {
-      block_sidel=allocate();
-      block_sider=allocate();
-    }
-
-    if (block_sidel && block_sider){
-        if (tone) {
-            // Apply ramp up window and/or send tone to both outputs
-            for (i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
-                if (windowindex < WINDOW_TABLE_LENGTH) {
-                    t = multiply_32x32_rshift32(block_sine->data[i] << 1, window_table[windowindex++]);
-                } else {
-                    t = block_sine->data[i];
-                }
-                if (block_inl && !mute) {
-                  block_sidel->data[i]=(t+(int32_t)block_inl->data[i]) >> 1;
-                } else {
-                  block_sidel->data[i]=t >> 1;
-                }
-                if (block_inr && !mute) {
-                  block_sider->data[i]=(t+(int32_t)block_inr->data[i]) >> 1;
-                } else {
-                  block_sider->data[i]=t >> 1;
-                }
+    updateAt(micros());
+}
+
+void TeensyAudioTone::updateAt(uint32_t now)
+{
+    audio_block_t *block_inl, *block_inr, *block_sidel, *block_sider;
+    int16_t i, e, n;
+    int32_t d;
+    uint32_t span, ph, inc;
+    int32_t target;
+    uint8_t nkeys, nscheduled, nmutes, keying, shared, settled;
+    int32_t master_target, master_jump, side_target[2], rx_target[2];
+    int32_t rx_gain[2], duck_target, depth;
+    uint8_t key_pos[2 * EVENT_QUEUE_LENGTH];
+    uint8_t key_state[2 * EVENT_QUEUE_LENGTH];
+    uint8_t scheduled_pos[EVENT_QUEUE_LENGTH];
+    uint8_t scheduled_state[EVENT_QUEUE_LENGTH];
+    uint8_t mute_pos[EVENT_QUEUE_LENGTH];
+    uint8_t mute_state[EVENT_QUEUE_LENGTH];
+    int16_t side[AUDIO_BLOCK_SAMPLES] __attribute__ ((aligned (4)));
+    int32_t duck_env[AUDIO_BLOCK_SAMPLES];
+    const int32_t *duck_ptr;
+
+    //
+    // Switch to a new ramp if requested. Scale the window index such
+    // that a ramp in progress continues at (about) the same level.
+    //
+    if (window_request != window_selected || !window_table) {
+        const window_desc &w = windows[window_request];
+        if (window_length) windowindex = ((uint32_t) windowindex * w.length) / window_length;
+        window_table    = w.table;
+        window_length   = w.length;
+        window_selected = window_request;
+    }
+
+    //
+    // Collect the key and mute events that happened since the previous update()
+    // and convert their time stamps to a sample position within this block.
+    // So the side tone follows the key with a constant delay of one block,
+    // instead of being quantized to block boundaries.
+    // Events time-stamped in the future remain in the queue.
+    //
+    span = now - last_update;
+    if (span == 0) span = 1;
+    if (span > 0xffff) {
+        // first call, or audio has been stalled
+        last_update = now - 0xffff;
+        span = 0xffff;
+    }
+
+    nkeys      = collectEvents(EVENT_KEY,       span, key_pos,       key_state);
+    nscheduled = collectEvents(EVENT_SCHEDULED, span, scheduled_pos, scheduled_state);
+    nmutes     = collectEvents(EVENT_MUTE,      span, mute_pos,      mute_state);
+
+    //
+    // Merge the scheduled key events into the others, by position
+    //
+    if (nscheduled) {
+        i = nkeys - 1;
+        n = nscheduled - 1;
+        for (e = nkeys + nscheduled - 1; n >= 0; e--) {
+            if (i >= 0 && key_pos[i] > scheduled_pos[n]) {
+                key_pos[e]   = key_pos[i];
+                key_state[e] = key_state[i--];
+            } else {
+                key_pos[e]   = scheduled_pos[n];
+                key_state[e] = scheduled_state[n--];
             }
-        } else if (windowindex) {
-            // Apply ramp down until 0 window index
-            if (windowindex > WINDOW_TABLE_LENGTH) windowindex = WINDOW_TABLE_LENGTH;
-            for (i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
-                if (windowindex) {
-                    t = multiply_32x32_rshift32(block_sine->data[i] << 1, window_table[--windowindex]);
-                } else {
-                    t = 0;
-                }
-                if (block_inl && !mute) {
-                  block_sidel->data[i]=(t+(int32_t) block_inl->data[i]) >> 1;
-                } else {
-                  block_sidel->data[i]= t >> 1;
-                }
-                if (block_inr && !mute) {
-                  block_sider->data[i]=(t+(int32_t)block_inr->data[i]) >> 1;
-                } else {
-                  block_sider->data[i]= t >> 1;
-                }
+        }
+        nkeys += nscheduled;
+    }
+    last_update = now;
+
+    //
+    // Work in place on the RX audio blocks. These are normally not shared,
+    // so receiveWritable() does not need to allocate a copy.
+    //
+    block_inl  = receiveWritable(0);
+    block_inr  = receiveWritable(1);
+
+    //
+    // RX filter, see rxFilter()
+    //
+    uint8_t filter_to = rx_filter_request;
+    if (filter_to == RX_FILTER_HOLD) filter_to = rx_filter_selected;
+    if (filter_to != RX_FILTER_OFF || rx_filter_selected != RX_FILTER_OFF) {
+        uint32_t t0 = ARM_DWT_CYCCNT;
+        rxFilterBlock(block_inl ? block_inl->data : NULL, 0, rx_filter_selected, filter_to);
+        rxFilterBlock(block_inr ? block_inr->data : NULL, 1, rx_filter_selected, filter_to);
+        rx_filter_selected = filter_to;
+        rx_filter_cycles = ARM_DWT_CYCCNT - t0;
+        if (rx_filter_cycles > rx_filter_cycles_max) rx_filter_cycles_max = rx_filter_cycles;
+    }
+
+    keying = sidetone_enabled && (tone || windowindex || nkeys);
+
+    if (keying) {
+        //
+        // Render the side tone, applying the ramp up window while the
+        // key is down and the ramp down window after key-up. Key events
+        // switch the tone state at their sample position.
+        //
+        ph = phase_accumulator;
+        inc = phase_increment;
+        target = side_gain_target;
+        i = 0;
+        for (e = 0; e <= nkeys; e++) {
+            int16_t end = (e < nkeys) ? key_pos[e] : AUDIO_BLOCK_SAMPLES;
+            if (end < i) end = i;   // never render backwards
+            if (tone) {
+                n = (int16_t) window_length - (int16_t) windowindex;
+                if (n < 0) n = 0;
+                if (n > end - i) n = end - i;
+                ph = render_side<SIDE_RAMP_UP>(side + i, ph, inc, side_gain, target, window_table + windowindex, n);
+                windowindex += n;
+                i += n;
+                ph = render_side<SIDE_STEADY>(side + i, ph, inc, side_gain, target, NULL, end - i);
+            } else {
+                n = windowindex;
+                if (n > end - i) n = end - i;
+                ph = render_side<SIDE_RAMP_DOWN>(side + i, ph, inc, side_gain, target, window_table + windowindex, n);
+                windowindex -= n;
+                i += n;
+                ph = render_side<SIDE_SILENCE>(side + i, ph, inc, side_gain, target, NULL, end - i);
             }
-        } else {
-          //
-          // mute set but not within a "window": send silence
-          //
-          // NOTE: in the very un-probable case that tone == windowindex == mute == 0,
-          //       (since there was a spike on "tone")
-          //       we also arrive here and send one block of silence
-          //
-          for (i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
-            block_sider->data[i] = 0;
-            block_sidel->data[i] = 0;
-          }
-        }
-        // Use same data for both ears
-        transmit(block_sidel,0);
-        transmit(block_sider,1);
-        release(block_sidel);
-        release(block_sider);
+            i = end;
+            if (e < nkeys) tone = key_state[e];
+        }
+        phase_accumulator = ph;
     } else {
+        //
+        // Side tone disabled (or idle): just keep track of the key
+        //
+        if (nkeys) tone = key_state[nkeys - 1];
+        windowindex = 0;
+        side_gain = side_gain_target;
+    }
+
+    //
+    // Per-channel gain targets for side tone (master volume and pan)
+    // and RX audio (master volume and balance). After volumeJump(),
+    // the gains start at the new master gain, without a ramp.
+    //
+    master_target = master_gain_target;
+    master_jump   = master_gain_jump;
+    master_gain_jump = -1;
+    for (i = 0; i < 2; i++) {
+        side_target[i] = ((int64_t) master_target * side_pan[i])   >> 15;
+        rx_target[i]   = ((int64_t) master_target * rx_balance[i]) >> 15;
+        if (master_jump >= 0) {
+            side_gain_ch[i] = ((int64_t) master_jump * side_pan[i])   >> 15;
+            rx_gain_ch[i]   = ((int64_t) master_jump * rx_balance[i]) >> 15;
+        }
+        rx_gain[i]     = rx_gain_ch[i];
+    }
+
+    //
+    // RX audio ducking (while "mute" is set). The ducking gain goes down with
+    // the attack rate and up with the release rate, starting at the sample
+    // where the mute event occured. While it and the RX gains are constant
+    // it is folded into the RX gains, and at unity the cheap paths below
+    // are used.
+    //
+    depth       = duck_depth;
+    duck_target = mute ? depth : (1 << 30);
+    duck_ptr    = NULL;
+    if (nmutes || duck_gain != duck_target) {
+        e = 0;
+        for (i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+            while (e < nmutes && mute_pos[e] <= i) {
+                mute = mute_state[e++];
+                duck_target = mute ? depth : (1 << 30);
+            }
+            d = duck_target - duck_gain;
+            if (d < -duck_attack) {
+                d = -duck_attack;
+            } else if (d > duck_release) {
+                d = duck_release;
+            }
+            duck_gain  += d;
+            duck_env[i] = duck_gain >> 15;
+        }
+        duck_ptr = duck_env;
+    } else if (duck_gain != (1 << 30)) {
+        if (rx_gain[0] == rx_target[0] && rx_gain[1] == rx_target[1]) {
+            for (i = 0; i < 2; i++) {
+                rx_gain[i]   = ((int64_t) rx_gain[i]   * duck_gain) >> 30;
+                rx_target[i] = ((int64_t) rx_target[i] * duck_gain) >> 30;
+            }
+        } else {
+            //
+            // The RX gains are ramping. The ramp must run on the gains
+            // without ducking, as rx_gain_ch does (see below), otherwise
+            // the gain would jump at the next block: apply the ducking
+            // as a (constant) envelope instead.
+            //
+            for (i = 0; i < AUDIO_BLOCK_SAMPLES; i++) duck_env[i] = duck_gain >> 15;
+            duck_ptr = duck_env;
+        }
+    }
 
-        windowindex = tone = mute = 0;  // just in case we arrive here because of a failed allocation
+    if (keying) {
+        //
+        // A channel without RX audio gets the side tone only. If both channels
+        // lack RX audio and have the same side tone gain, they share one block,
+        // so at most one block is allocated (two if the side tone is panned).
+        // If allocation fails, the channel is silent for one block but the
+        // keying envelope goes on.
+        //
+        block_sidel = block_sider = NULL;
+        shared = !block_inl && !block_inr &&
+                 side_gain_ch[0] == side_gain_ch[1] && side_target[0] == side_target[1];
+        if (!block_inl) {
+            block_sidel = allocate();
+            if (block_sidel) {
+                mix<true>(block_sidel->data, side, NULL, side_gain_ch[0], side_target[0], 0, 0, NULL);
+            } else {
+                alloc_failures++;
+            }
+        }
+        if (!block_inr && !shared) {
+            block_sider = allocate();
+            if (block_sider) {
+                mix<true>(block_sider->data, side, NULL, side_gain_ch[1], side_target[1], 0, 0, NULL);
+            } else {
+                alloc_failures++;
+            }
+        }
+        //
+        // Mix side tone and (ducked) RX audio in place
+        //
+        if (block_inl) {
+            mix<true>(block_inl->data, side, block_inl->data,
+                      side_gain_ch[0], side_target[0], rx_gain[0], rx_target[0], duck_ptr);
+            transmit(block_inl, 0);
+        } else if (block_sidel) {
+            transmit(block_sidel, 0);
+            if (shared) transmit(block_sidel, 1);
+            release(block_sidel);
+        }
+        if (block_inr) {
+            mix<true>(block_inr->data, side, block_inr->data,
+                      side_gain_ch[1], side_target[1], rx_gain[1], rx_target[1], duck_ptr);
+            transmit(block_inr, 1);
+        } else if (block_sider) {
+            transmit(block_sider, 1);
+            release(block_sider);
+        }
+    } else {
         //
+        // No side tone: RX audio only (possibly ducked).
         // During keying, the "blending" of the RX and side tone is Out = (In + Side) / 2
         // so the Out amplitude needs to be divided by 2 here as well.
         //
         if (block_inl) {
-          for (i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
-            block_inl->data[i] >>= 1;
-          }
-          transmit(block_inl,0);
+            mix<false>(block_inl->data, NULL, block_inl->data, 0, 0, rx_gain[0], rx_target[0], duck_ptr);
+            transmit(block_inl,0);
         }
         if (block_inr) {
-          for (i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
-            block_inr->data[i] >>= 1;
-          }
-          transmit(block_inr,1);
+            mix<false>(block_inr->data, NULL, block_inr->data, 0, 0, rx_gain[1], rx_target[1], duck_ptr);
+            transmit(block_inr,1);
         }
     }
 
-    if (block_sine) release(block_sine);
+    //
+    // The kernels above ran the gain ramps on local copies,
+    // now advance the gains themselves
+    //
+    settled = 1;
+    for (i = 0; i < 2; i++) {
+        target = ((int64_t) master_target * rx_balance[i]) >> 15;
+        side_gain_ch[i] = ramp_block(side_gain_ch[i], side_target[i]);
+        rx_gain_ch[i]   = ramp_block(rx_gain_ch[i],   target);
+        if (side_gain_ch[i] != side_target[i] || rx_gain_ch[i] != target) settled = 0;
+    }
+    master_settled = settled;
+
     if (block_inl)  release(block_inl);
     if (block_inr)  release(block_inr);
 
 }
 
-
-#undef WINDOW_TABLE_LENGTH
 #endif
@@ -28,39 +28,257 @@
 #include "AudioStream.h"
 #include "arm_math.h"
 
+//
+// Shapes of the keying ramp, see TeensyAudioTone.cpp
+//
+enum window_shape {
+    WINDOW_RAISED_COSINE            = 0,
+    WINDOW_INTEGRATED_RAISED_COSINE = 1,
+    WINDOW_BLACKMAN_HARRIS          = 2,
+    WINDOW_NSHAPE                   = 3
+};
+
+//
+// Number of different rise times (2 ... 6 msec) available for each shape
+//
+#define WINDOW_NRISE 5
+
 class TeensyAudioTone : public AudioStream
 {
 public:
-    TeensyAudioTone() : AudioStream(3, inputQueueArray) {
+    TeensyAudioTone() : AudioStream(2, inputQueueArray) {
         sidetone_enabled = 1;
         tone = 0;
         mute = 0;
         windowindex = 0;
+        phase_accumulator = 0;
+        phase_increment = 0;
+        side_gain = side_gain_target = 0;
+        master_gain_target = 1 << 30;
+        master_gain_jump = -1;
+        master_settled = 1;
+        for (int i = 0; i < 2; i++) {
+            side_gain_ch[i] = rx_gain_ch[i] = 1 << 30;
+            side_pan[i] = rx_balance[i] = 32768;
+        }
+        window_table = NULL;
+        window_length = 0;
+        window_selected = 0;
+        window_request = WINDOW_BLACKMAN_HARRIS * WINDOW_NRISE + 1;  // Blackman-Harris, 3 msec
+        for (int q = 0; q < EVENT_NQUEUES; q++) event_head[q] = event_tail[q] = 0;
+        last_update = 0;
+        dropped_events = 0;
+        late_events = 0;
+        alloc_failures = 0;
+        duck_gain = 1 << 30;
+        duck_depth = 0;
+        duck(0.0F, 2.0F, 10.0F);
+        rx_filter_freq = 800.0F;
+        rx_filter_bandwidth = 0;
+        rx_filter_selected = rx_filter_request = RX_FILTER_OFF;
+        rx_filter_cycles = rx_filter_cycles_max = 0;
+        for (int b = 0; b < 2; b++) {
+            for (int c = 0; c < 2; c++) {
+                arm_biquad_cascade_df1_init_q15(&rx_filter[b][c], RX_FILTER_STAGES,
+                                                rx_filter_coeffs[b], rx_filter_state[b][c], 1);
+            }
+        }
     }
 
     virtual void update(void);
 
+    //
+    // update() for a block that ends at time "now" (micros() time base).
+    // update() uses the current time. Calling updateAt() directly with a
+    // simulated clock renders key events deterministically and as fast as
+    // possible, e.g. for offline rendering of keying patterns. Time stamps
+    // passed to keyEvent() must then use the same clock.
+    //
+    void updateAt(uint32_t now);
+
+    //
+    // Side tone frequency (Hz) and amplitude (0.0 ... 1.0).
+    // The frequency can be changed while the tone is playing, the
+    // oscillator phase stays continuous.
+    //
+    void frequency(float freq);
+    void amplitude(float level);
+
+    //
+    // Master volume (0.0 ... 1.0), applied to side tone and RX audio.
+    // Amplitude and volume changes are ramped sample by sample
+    // in update(), so they are click-free.
+    //
+    void volume(float level);
+
+    //
+    // For a master volume handed over to a codec: volumeJump() sets the
+    // master gain to "from" with the next update(), without a ramp, and
+    // ramps it to "to" from there (call it with audio interrupts off).
+    // volumeSettled() is true once the gains have reached their targets.
+    //
+    void volumeJump(float from, float to);
+    bool volumeSettled(void) { return master_settled; }
+
+    //
+    // Left/right gain factors (0.0 ... 1.0) for the side tone (pan)
+    // and for the RX audio (balance), ramped like the master volume.
+    //
+    void pan(float left, float right);
+    void balance(float left, float right);
+
     void setTone(uint8_t state) {
-        tone = state;
+        keyEvent(state, micros());
+    }
+
+    //
+    // Queue a key-up/key-down event that happened at time "when"
+    // (micros() time base). update() starts/stops the ramp at the
+    // sample within the audio block that corresponds to this time.
+    // Must only be called from a single context (normally loop()).
+    //
+    void keyEvent(uint8_t state, uint32_t when) {
+        queueEvent(EVENT_KEY, state, when);
     }
+
+    //
+    // Queue a key-up/key-down event to be played at time "when", which
+    // may lie in the future (e.g. keying from a playout buffer). These
+    // events have a queue of their own, merged with the keyEvent() ones
+    // by time, so key and mute events queued in the meantime are not
+    // held up behind them. Must only be called from a single context.
+    //
+    void scheduleKeyEvent(uint8_t state, uint32_t when) {
+        queueEvent(EVENT_SCHEDULED, state, when);
+    }
+
+    //
+    // CPU cycles spent in the last (longest) update() call, as measured
+    // by the audio library (which counts in units of 64 cycles)
+    //
+    uint32_t updateCycles(void)    { return (uint32_t) cpu_cycles << 6; }
+    uint32_t updateCyclesMax(void) { return (uint32_t) cpu_cycles_max << 6; }
+
+    uint16_t droppedEvents(void) { return dropped_events; }
+    uint16_t lateEvents(void)    { return late_events; }
+    uint16_t allocFailures(void) { return alloc_failures; }
+
+    //
+    // Select shape and rise time (in milli-seconds) of the keying ramp.
+    // Rise times are limited to the range of pre-computed tables (2 ... 6 msec)
+    //
+    void setWindow(uint8_t shape, uint8_t rise_ms);
+
     void sidetoneenable(uint8_t state) {
       sidetone_enabled = state;
     }
 
     void muteAudioIn(uint8_t state) {
         //
-        // mute/unmute audio from PC
+        // duck/unduck audio from PC, starting at the sample
+        // corresponding to the current time
         //
-        mute = state;
+        queueEvent(EVENT_MUTE, state, micros());
     }
 
+    //
+    // Ducking of the audio from PC while muted: remaining gain (0.0 = full mute,
+    // 1.0 = no ducking), and attack/release time (milli-seconds, full scale)
+    //
+    void duck(float depth, float attack_ms, float release_ms);
+
+    //
+    // Narrow band-pass filter for the audio from PC, centred on the side tone
+    // frequency. The bandwidth (Hz) is rounded to the nearest one available,
+    // zero switches the filter off. Changes are cross-faded over one block.
+    //
+    void rxFilter(uint16_t bandwidth);
+
+    //
+    // CPU cycles spent in the RX filter in the last (longest) update() call
+    //
+    uint32_t rxFilterCycles(void)    { return rx_filter_cycles; }
+    uint32_t rxFilterCyclesMax(void) { return rx_filter_cycles_max; }
+
 private:
-    audio_block_t *inputQueueArray[3];
+    audio_block_t *inputQueueArray[2];
 
     uint8_t  sidetone_enabled;
     uint8_t  tone;         // tone on/off flag
-    uint8_t  mute;         // mute on/off flag
-    uint8_t  windowindex;  // pointer into the "ramp"
+    uint8_t  mute;         // mute (duck) on/off flag
+    uint16_t windowindex;  // pointer into the "ramp"
+
+    uint32_t          phase_accumulator;  // side tone oscillator phase
+    volatile uint32_t phase_increment;    // side tone oscillator frequency
+
+    //
+    // Gains in Q30 format (1 << 30 = unity). The targets are set from loop(),
+    // update() ramps the actual gains towards them.
+    //
+    int32_t           side_gain;           // side tone amplitude
+    volatile int32_t  side_gain_target;
+    volatile int32_t  master_gain_target;  // master volume
+    volatile int32_t  master_gain_jump;    // master gain to start from without a ramp, or -1
+    volatile uint8_t  master_settled;      // gains at their targets
+    int32_t           side_gain_ch[2];     // side tone gain per channel (master volume and pan)
+    int32_t           rx_gain_ch[2];       // RX audio gain per channel (master volume and balance)
+
+    volatile int32_t  side_pan[2];         // Q15 (32768 = unity)
+    volatile int32_t  rx_balance[2];       // Q15 (32768 = unity)
+
+    int32_t           duck_gain;           // RX ducking gain
+    volatile int32_t  duck_depth;          // RX ducking gain while muted
+    volatile int32_t  duck_attack;         // max. gain decrease per sample
+    volatile int32_t  duck_release;        // max. gain increase per sample
+
+    const int32_t    *window_table;     // ramp currently in use
+    uint16_t          window_length;    // number of entries in window_table
+    uint8_t           window_selected;  // index of the ramp currently in use
+    volatile uint8_t  window_request;   // index of the ramp requested by setWindow()
+
+    //
+    // Key and mute events are passed from loop() to the audio interrupt through
+    // lock-free single-producer/single-consumer ring buffers, one per kind
+    // of event, each in time order. Only queueEvent() advances event_head,
+    // only update() advances event_tail.
+    //
+    static const uint8_t EVENT_QUEUE_LENGTH = 16;  // must be a power of two
+    enum { EVENT_KEY, EVENT_SCHEDULED, EVENT_MUTE, EVENT_NQUEUES };
+    struct key_event {
+        uint32_t when;     // micros() time stamp
+        uint8_t  state;    // new tone or mute state
+    };
+    void queueEvent(uint8_t queue, uint8_t state, uint32_t when);
+    uint8_t collectEvents(uint8_t queue, uint32_t span, uint8_t *pos, uint8_t *state);
+    key_event         events[EVENT_NQUEUES][EVENT_QUEUE_LENGTH];
+    volatile uint8_t  event_head[EVENT_NQUEUES];
+    volatile uint8_t  event_tail[EVENT_NQUEUES];
+
+    //
+    // RX filter: two banks of coefficients, each with its own filter state
+    // per channel. rxFilter() and frequency() write the bank not in use and
+    // then request it, update() cross-fades from the selected bank (or from
+    // the unfiltered audio) to the requested one.
+    //
+    static const uint8_t RX_FILTER_STAGES = 2;
+    static const uint8_t RX_FILTER_OFF    = 2;
+    static const uint8_t RX_FILTER_HOLD   = 3;    // request: keep the selected bank
+    float             rx_filter_freq;       // centre frequency (Hz)
+    uint16_t          rx_filter_bandwidth;  // bandwidth (Hz), 0 = off
+    q15_t             rx_filter_coeffs[2][6 * RX_FILTER_STAGES];
+    q15_t             rx_filter_state[2][2][4 * RX_FILTER_STAGES];  // [bank][channel]
+    arm_biquad_casd_df1_inst_q15 rx_filter[2][2];                   // [bank][channel]
+    volatile uint8_t  rx_filter_selected;   // bank in use, or RX_FILTER_OFF
+    volatile uint8_t  rx_filter_request;    // bank requested, RX_FILTER_OFF or _HOLD
+    uint32_t          rx_filter_cycles;
+    uint32_t          rx_filter_cycles_max;
+    void rxFilterDesign(void);
+    void rxFilterBlock(int16_t *data, uint8_t channel, uint8_t from, uint8_t to);
+
+    uint32_t last_update;     // micros() time stamp of the previous update()
+    uint16_t dropped_events;  // events lost because the queue was full
+    uint16_t late_events;     // events that arrived after their block was rendered
+    uint16_t alloc_failures;  // audio blocks that could not be allocated
 };
 
 #endif
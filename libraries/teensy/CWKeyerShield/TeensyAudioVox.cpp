@@ -0,0 +1,138 @@
+/* VOX for Teensy 4.X
+ * Copyright (c) 2021, kf7o, Steve Haynal, steve@softerhardware.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+//
+// See TeensyAudioTone.cpp why there is an ifndef here
+//
+#ifndef __AVR__
+
+#include <Arduino.h>
+#include "TeensyAudioVox.h"
+
+namespace {
+
+//
+// Block duration (milli-seconds)
+//
+const float BLOCK_MS = 1000.0F * AUDIO_BLOCK_SAMPLES / AUDIO_SAMPLE_RATE_EXACT;
+
+//
+// Decay of the microphone and RX envelopes per block (about 20 and 200 msec)
+//
+const float MIC_DECAY = 0.86F;
+const float RX_DECAY  = 0.985F;
+
+//
+// Peak amplitude of a block (full scale = 32768)
+//
+inline int32_t peak(const audio_block_t *block)
+{
+    int32_t p = 0;
+
+    if (!block) return 0;
+    for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+        int32_t v = block->data[i];
+        if (v < 0) v = -v;
+        if (v > p) p = v;
+    }
+    return p;
+}
+
+} // namespace
+
+void TeensyAudioVox::threshold(float dbfs)
+{
+    vox_threshold = powf(10.0F, dbfs / 20.0F);
+}
+
+void TeensyAudioVox::times(float attack_ms, float hold_ms)
+{
+    if (attack_ms < BLOCK_MS) attack_ms = BLOCK_MS;
+    if (hold_ms < 0.0F) hold_ms = 0.0F;
+    vox_attack = 1.0F - expf(-BLOCK_MS / attack_ms);
+    vox_hold   = hold_ms / BLOCK_MS + 0.5F;
+}
+
+void TeensyAudioVox::antivox(float gain)
+{
+    vox_antivox = (gain < 0.0F) ? 0.0F : gain;
+}
+
+void TeensyAudioVox::update(void)
+{
+    audio_block_t *block_l, *block_r, *block_rx;
+    float mic, rx;
+
+    block_l  = receiveReadOnly(0);
+    block_r  = receiveReadOnly(1);
+    block_rx = receiveReadOnly(2);
+
+    if (enabled) {
+        //
+        // Envelopes: the microphone level rises with the attack time, so short
+        // clicks do not trigger, the RX level follows peaks immediately
+        //
+        int32_t pl = peak(block_l);
+        int32_t pr = peak(block_r);
+        mic = ((pl > pr) ? pl : pr) * (1.0F / 32768.0F);
+        rx  = peak(block_rx)        * (1.0F / 32768.0F);
+
+        if (mic > mic_env) {
+            mic_env += (mic - mic_env) * vox_attack;
+        } else {
+            mic_env *= MIC_DECAY;
+        }
+        if (rx > rx_env) {
+            rx_env = rx;
+        } else {
+            rx_env *= RX_DECAY;
+        }
+
+        if (mic_env > vox_threshold + vox_antivox * rx_env) {
+            vox_state = 1;
+            hold_count = vox_hold;
+        } else if (hold_count) {
+            hold_count--;
+        } else {
+            vox_state = 0;
+        }
+    } else {
+        vox_state = 0;
+        hold_count = 0;
+        mic_env = rx_env = 0.0F;
+    }
+
+    //
+    // Microphone audio passes through unchanged
+    //
+    if (block_l) {
+        transmit(block_l, 0);
+        release(block_l);
+    }
+    if (block_r) {
+        transmit(block_r, 1);
+        release(block_r);
+    }
+    if (block_rx) release(block_rx);
+}
+
+#endif
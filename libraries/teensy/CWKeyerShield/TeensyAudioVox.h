@@ -0,0 +1,95 @@
+/* VOX for Teensy 4.X
+ * Copyright (c) 2021, kf7o, Steve Haynal, steve@softerhardware.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef TeensyAudioVox_h_
+#define TeensyAudioVox_h_
+
+#include "Arduino.h"
+#include "Audio.h"
+#include "AudioStream.h"
+
+//
+// VOX on the microphone path. Inputs 0 and 1 (microphone L/R) are passed
+// unchanged to outputs 0 and 1, input 2 is the RX audio used for anti-VOX.
+// The VOX state is updated once per audio block, see ptt().
+//
+class TeensyAudioVox : public AudioStream
+{
+public:
+    TeensyAudioVox() : AudioStream(3, inputQueueArray) {
+        enabled = 0;
+        vox_state = 0;
+        mic_env = rx_env = 0.0F;
+        hold_count = 0;
+        threshold(-40.0F);
+        times(1.0F, 500.0F);
+        antivox(0.0F);
+    }
+
+    virtual void update(void);
+
+    void enable(uint8_t state) {
+        enabled = state;
+    }
+
+    //
+    // Microphone level (dBFS) above which PTT is asserted
+    //
+    void threshold(float dbfs);
+
+    //
+    // Attack time constant of the microphone level (milli-seconds),
+    // and hold time of PTT once the level has dropped (milli-seconds)
+    //
+    void times(float attack_ms, float hold_ms);
+
+    //
+    // Anti-VOX: the RX audio level, multiplied by this gain, is added to the
+    // threshold, such that audio from the speaker does not trigger the VOX.
+    // Zero disables anti-VOX.
+    //
+    void antivox(float gain);
+
+    //
+    // Current VOX state (PTT requested)
+    //
+    uint8_t ptt(void) { return vox_state; }
+
+private:
+    audio_block_t *inputQueueArray[3];
+
+    volatile uint8_t enabled;
+    volatile uint8_t vox_state;
+
+    //
+    // Levels are peak amplitudes (full scale = 1.0)
+    //
+    float   mic_env;                  // microphone envelope
+    float   rx_env;                   // RX audio envelope
+    uint16_t hold_count;              // blocks left until PTT is released
+    volatile float    vox_threshold;
+    volatile float    vox_attack;     // envelope attack coefficient per block
+    volatile uint16_t vox_hold;       // hold time in blocks
+    volatile float    vox_antivox;
+};
+
+#endif
@@ -0,0 +1,117 @@
+/* Background scanning of potentiometers for Teensy 4.X
+ * Copyright (c) 2021, kf7o, Steve Haynal, steve@softerhardware.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+//
+// See TeensyAudioTone.cpp why there is an ifndef here
+//
+#ifndef __AVR__
+
+#include <Arduino.h>
+#include "TeensyPots.h"
+
+#if defined(__IMXRT1062__)
+
+//
+// Pin to ADC channel table of the Teensy core (analog.c).
+// Bit 7 set means the channel is only available on ADC2.
+//
+extern "C" const uint8_t pin_to_channel[];
+
+namespace {
+
+IntervalTimer scan_timer;
+TeensyPots   *scanner = NULL;      // there is only one set of pots
+
+} // namespace
+
+void TeensyPots::begin(const int pins[NPOTS])
+{
+    for (uint8_t pot = 0; pot < NPOTS; pot++) {
+        channel[pot] = (pins[pot] >= 0) ? pin_to_channel[pins[pot]] : 0xff;
+        started[pot] = 0;
+    }
+    current = NPOTS;
+    scanner = this;
+    attachInterruptVector(IRQ_ADC1, adc_isr);
+    attachInterruptVector(IRQ_ADC2, adc_isr);
+    NVIC_ENABLE_IRQ(IRQ_ADC1);
+    NVIC_ENABLE_IRQ(IRQ_ADC2);
+    scan_timer.begin(timer_isr, CWKEYER_POTS_SCAN_US);
+}
+
+void TeensyPots::end(void)
+{
+    scan_timer.end();
+    NVIC_DISABLE_IRQ(IRQ_ADC1);
+    NVIC_DISABLE_IRQ(IRQ_ADC2);
+    current = NPOTS;
+}
+
+void TeensyPots::start(uint8_t pot)
+{
+    //
+    // Find the next pot in use, and start its conversion. The ADC
+    // averages in hardware, as set up by analogReadAveraging().
+    //
+    while (pot < NPOTS && channel[pot] == 0xff) pot++;
+    current = pot;
+    if (pot == NPOTS) {
+        scan_count++;
+        return;
+    }
+    if (channel[pot] & 0x80) {
+        ADC2_HC0 = (channel[pot] & 0x7f) | ADC_HC_AIEN;
+    } else {
+        ADC1_HC0 = channel[pot] | ADC_HC_AIEN;
+    }
+}
+
+void TeensyPots::timer_isr(void)
+{
+    // skip a scan if the last one is still running
+    if (scanner->current != NPOTS) return;
+    scanner->start(0);
+}
+
+void TeensyPots::adc_isr(void)
+{
+    uint8_t pot = scanner->current;
+
+    if (pot == NPOTS) {
+        // not ours, just clear the flags
+        (void) ADC1_R0;
+        (void) ADC2_R0;
+    } else {
+        // reading the result clears the interrupt
+        scanner->sample(pot, (scanner->channel[pot] & 0x80) ? ADC2_R0 : ADC1_R0);
+        scanner->start(pot + 1);
+    }
+    asm volatile("dsb");
+}
+
+#elif !defined(CWKEYER_HOST)
+
+#error "TeensyPots needs the ADC of the Teensy 4.X"
+
+#endif
+
+#endif
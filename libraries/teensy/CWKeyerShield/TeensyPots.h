@@ -0,0 +1,116 @@
+/* Background scanning of potentiometers for Teensy 4.X
+ * Copyright (c) 2021, kf7o, Steve Haynal, steve@softerhardware.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef TeensyPots_h_
+#define TeensyPots_h_
+
+#include "Arduino.h"
+
+//
+// Time between two scans of all pots (micro-seconds)
+//
+#ifndef CWKEYER_POTS_SCAN_US
+#define CWKEYER_POTS_SCAN_US 1000
+#endif
+
+//
+// Continuous scanning of up to four pots in the background. A timer
+// starts one scan per CWKEYER_POTS_SCAN_US, and the conversion complete
+// interrupt of the ADC starts the conversion of the next pot, so no
+// one waits for the ADC. The ADCs must not be used with analogRead()
+// while the scan is running.
+//
+// Only the Teensy 4.X is supported. A host build of the library
+// (CWKEYER_HOST, see test/host) brings its own begin(), end() and
+// timer_isr(), which feed the pot values of the harness to sample(),
+// so the filter and the mapping in CWKeyerShield::pots() can be
+// exercised without hardware.
+//
+class TeensyPots
+{
+public:
+    static const uint8_t NPOTS = 4;
+
+    //
+    // Start scanning the given pins (negative: pot not used). The ADC
+    // resolution must be 12 bits, see analogReadRes().
+    //
+    void begin(const int pins[NPOTS]);
+    void end(void);
+
+    //
+    // Enter one conversion result (12 bits) of a pot. Called from the
+    // ADC interrupt (or the host stand-in, see above).
+    //
+    void sample(uint8_t pot, uint16_t raw) {
+        //
+        // First order low pass, the time constant is four scans.
+        // filtered holds four times the value, the first sample
+        // initializes it, so the pots are not ramped up at startup.
+        //
+        if (!started[pot]) {
+            filtered[pot] = raw << 2;
+            started[pot] = 1;
+        } else {
+            filtered[pot] += raw - (filtered[pot] >> 2);
+        }
+    }
+
+    //
+    // Latest filtered value of a pot, 13 bits (0 ... 8191)
+    //
+    uint16_t value(uint8_t pot) { return filtered[pot] >> 1; }
+
+    //
+    // Number of scans completed since begin()
+    //
+    uint32_t scans(void) { return scan_count; }
+
+    //
+    // Discretization with hysteresis: a 13-bit value is accepted if it
+    // deviates from the last accepted one by more than one step of
+    // (1 << shift). Returns the new step (value >> shift), or -1 if the
+    // value is not accepted. last is then set to the mid-point of the
+    // new step, such that both neighbouring steps can be reached.
+    //
+    static int step(uint16_t value, uint16_t &last, uint8_t shift) {
+        int diff = (int) value - (int) last;
+
+        if (diff < 0) diff = -diff;
+        if (diff <= (1 << shift)) return -1;
+        last = ((value >> shift) << shift) + (1 << (shift - 1));
+        return value >> shift;
+    }
+
+private:
+    static void timer_isr(void);
+    static void adc_isr(void);
+    void start(uint8_t pot);
+
+    uint8_t  channel[NPOTS];                  // ADC channel (bit 7: ADC2), 0xff: not used
+    volatile uint16_t filtered[NPOTS] = {};
+    volatile uint8_t  started[NPOTS]  = {};
+    volatile uint8_t  current = NPOTS;        // pot being converted, NPOTS: scan complete
+    volatile uint32_t scan_count = 0;
+};
+
+#endif
@@ -6,50 +6,22 @@ SCH  = 1   ## Send channel, Python starts at 0 for 0-15, Teensy is 1-16
 RECV = "Teensy MIDI/Audio:Teensy MIDI/Audio MIDI 1 24:0"
 RCH  = 0   ## Receive channel, Python starts at 0 for 0-15, Teensy is 1-16
 
-## Control selection codes, must match those used in TeensyUSBAudioMidi
-
-
-MIDI_SET_A                    = 0    ## Set 7-bit accumulator A
-MIDI_SET_B                    = 1    ## Set 7-bit accumulator B
-MIDI_SET_C                    = 2    ## Set 7-bit accumulator C
-
-MIDI_MASTER_VOLUME            = 4    ## set master volume
-MIDI_SIDETONE_VOLUME          = 5    ## set sidetone volume
-MIDI_SIDETONE_FREQUENCY       = 6    ## set sidetone frequency
-MIDI_CW_SPEED                 = 7    ## set CW speed
-MIDI_ENABLE_POTS              = 8    ## enable/disable potentiometers
-MIDI_KEYER_AUTOPTT            = 9    ## enable/disable auto-PTT from CW keyer
-MIDI_KEYER_LEADIN             = 10   ## set Keyer lead-in time (if auto-PTT active)
-MIDI_KEYER_HANG               = 11   ## set Keyer hang time (if auto-PTT active)
-MIDI_RESPONSE                 = 12   ## enable/disable reporting back to MIDI controller
-MIDI_MUTE_CWPTT               = 13   ## enable/disable muting of RX audio during auto-PTT
-MIDI_MICPTT_HWPTT             = 14   ## enable/disable that MICIN triggers the hardware PTT output
-
-MIDI_RX_CH                    = 16   ## set MIDI channel to/from controller
-MIDI_TX_CH                    = 17   ## set MIDI channel to radio
-
-MIDI_KEYDOWN_NOTE             = 18   ## set MIDI note for key-down (to radio)
-MIDI_PTT_MIC_NOTE             = 19
-MIDI_PTT_IN_NOTE              = 20
-MIDI_CWPTT_NOTE               = 21   ## set MIDI note for PTT activation (to radio)
-MIDI_SPEED_CTRL               = 22   ## set MIDI controller for cw speed (to radio)
-MIDI_FREQ_CTRL                = 23   ## set MIDI controller for side tone frequency (to radio)
-
-MIDI_WM8960_ENABLE            = 40
-MIDI_WM8960_INPUT_LEVEL       = 41
-MIDI_WM8960_INPUT_SELECT      = 42
-MIDI_WM8960_VOLUME            = 43
-MIDI_WM8960_HEADPHONE_VOLUME  = 44
-MIDI_WM8960_HEADPHONE_POWER   = 45
-MIDI_WM8960_SPEAKER_VOLUME    = 46
-MIDI_WM8960_SPEAKER_POWER     = 47
-MIDI_WM8960_DISABLE_ADCHPF    = 48
-MIDI_WM8960_ENABLE_MICBIAS    = 49
-MIDI_WM8960_ENABLE_ALC        = 50
-MIDI_WM8960_MIC_POWER         = 51
-MIDI_WM8960_LINEIN_POWER      = 52
-MIDI_WM8960_RAW_WRITE         = 53
-
+## Control and NRPN numbers are generated from the firmware, see genparams.py
+from cwkeyer_params import *
+
+## SysEx commands, must match those in CWKeyerShield.h
+SYSEX_VERSION       = 1
+SYSEX_DUMP_REQUEST  = 1
+SYSEX_NRPN_DUMP     = 2
+SYSEX_CTRL_DUMP     = 3
+SYSEX_RESULT        = 4
+SYSEX_REPORT        = 5
+SYSEX_EVENT         = 6
+SYSEX_CLOCK_REQUEST = 7
+SYSEX_CLOCK         = 8
+SYSEX_KEY           = 9
+SYSEX_EVENT_KEY     = 0
+SYSEX_EVENT_PTT     = 1
 
 
 def midi_callback(message):
@@ -66,7 +38,7 @@ class CWKeyer:
 
   ## Send a control change message
   ## c is the control selecton: 0 to 127
-  ## v is the value: 0 to 127 (Larger values may be accumulated)
+  ## v is the value: 0 to 127
   def txcc(self,c,v):
     v = int(v)
     msg = mido.Message('control_change', channel=self.tc, control=c&0x7f, value=v&0x7f)
@@ -79,131 +51,195 @@ class CWKeyer:
     v = int(v*127.5)
     self.txcc(c,v)
 
+  ## Send a NRPN: n is the NRPN number, v the 14-bit value
+  def txnrpn(self,n,v):
+    v = int(v)
+    self.txcc(MIDI_NRPN_CC_MSB,(n>>7)&0x7f)
+    self.txcc(MIDI_NRPN_CC_LSB,n&0x7f)
+    self.txcc(MIDI_NRPN_VAL_MSB,(v>>7)&0x7f)
+    self.txcc(MIDI_NRPN_VAL_LSB,v&0x7f)
+
+  ## Set any parameter by name, e.g. set('MIDI_NRPN_VOX_HOLD', 300)
+  def set(self,name,v):
+    p = PARAMS[name]
+    if p['kind'] not in ('cc','nrpn'):
+      raise ValueError(name + " cannot be set")
+    v = int(v)
+    if v < p['min'] or v > p['max']:
+      raise ValueError("%s: %d out of range %d..%d" % (name,v,p['min'],p['max']))
+    if p['kind'] == 'cc':
+      self.txcc(p['number'],v)
+    else:
+      self.txnrpn(p['number'],v)
+
+  ## Ask for the value of a status NRPN, the answer arrives in midi_callback
+  def query(self,name): self.txnrpn(PARAMS[name]['number'],0)
+
+  ## Send a SysEx message: F0 7D 'C' 'W' version command payload checksum F7
+  def txsysex(self,cmd,payload=[]):
+    data = [SYSEX_VERSION,cmd] + list(payload)
+    data.append(-sum(data) & 0x7f)
+    self.tx.send(mido.Message('sysex', data=[0x7d,ord('C'),ord('W')] + data))
+
+  ## Ask for the complete state, the keyer answers with SYSEX_NRPN_DUMP
+  ## and SYSEX_CTRL_DUMP (see parse_dump). Send these back unchanged
+  ## with restore() to restore the state.
+  def request_dump(self): self.txsysex(SYSEX_DUMP_REQUEST)
+  def restore(self,message): self.tx.send(message)
+
+  ## Decode a dump into {number: value}, None if it is not a dump
+  @staticmethod
+  def parse_dump(message):
+    d = list(message.data)
+    if message.type != 'sysex' or d[:4] != [0x7d,ord('C'),ord('W'),SYSEX_VERSION]: return None
+    if sum(d[3:]) & 0x7f: return None
+    cmd, payload = d[4], d[5:-1]
+    if cmd not in (SYSEX_NRPN_DUMP,SYSEX_CTRL_DUMP): return None
+    size = 2 if cmd == SYSEX_NRPN_DUMP else 1
+    values, pos = {}, 19
+    for n in range(128):
+      if payload[n//7] & (1 << (n%7)):
+        v = payload[pos:pos+size]
+        values[n] = (v[0] << 7) | v[1] if size == 2 else v[0]
+        pos += size
+    return values
+
+  ## Subscribe to changes of a parameter (by name), None means all persistent ones.
+  ## Changes arrive as SYSEX_REPORT, see parse_report.
+  def _report_index(self,name):
+    if name is None: return 256
+    p = PARAMS[name]
+    return p['number'] if p['kind'] == 'cc' else 128 + p['number']
+  def subscribe(self,name=None): self.txnrpn(MIDI_NRPN_SUBSCRIBE,self._report_index(name))
+  def unsubscribe(self,name=None): self.txnrpn(MIDI_NRPN_UNSUBSCRIBE,self._report_index(name))
+
+  ## After a gap in the sequence numbers: seq is the last one received
+  def resync(self,seq): self.txnrpn(MIDI_NRPN_RESYNC,seq)
+
+  ## Decode a report into (sequence number, {index: value}), None if it is not one.
+  ## Index is the CC number, or 128 + the NRPN number.
+  @staticmethod
+  def parse_report(message):
+    p = CWKeyer._payload(message,SYSEX_REPORT)
+    if p is None: return None
+    values = {}
+    for i in range(2,len(p)-3,4):
+      values[(p[i] << 7) | p[i+1]] = (p[i+2] << 7) | p[i+3]
+    return ((p[0] << 7) | p[1], values)
+
+  ## Timestamped key/PTT events and clock messages on/off
+  def timestamps(self,v): self.txnrpn(MIDI_NRPN_TIMESTAMPS,1 if v else 0)
+
+  ## Ask for the keyer time, the answer is a SYSEX_CLOCK with this tag
+  def clock_request(self,tag): self.txsysex(SYSEX_CLOCK_REQUEST,[(tag>>7)&0x7f,tag&0x7f])
+
+  ## Key transition at time t (micro-seconds of any host clock), played
+  ## MIDI_NRPN_PLAYOUT_DELAY after the time stamp, see playout_delay
+  def key_at(self,state,t):
+    t &= 0xffffffff
+    self.txsysex(SYSEX_KEY,[1 if state else 0,(t>>28)&0x0f,(t>>21)&0x7f,(t>>14)&0x7f,(t>>7)&0x7f,t&0x7f])
+
+  ## Playout delay (ms) of key_at and of key notes, 0 keys notes immediately
+  def playout_delay(self,v): self.set('MIDI_NRPN_PLAYOUT_DELAY',v)
+
+  ## Payload of a keyer message with the given command, None if it is not one
+  @staticmethod
+  def _payload(message,cmd):
+    d = list(message.data)
+    if message.type != 'sysex' or d[:5] != [0x7d,ord('C'),ord('W'),SYSEX_VERSION,cmd]: return None
+    if sum(d[3:]) & 0x7f: return None
+    return d[5:-1]
+
+  @staticmethod
+  def _time(p):
+    return (p[0] << 28) | (p[1] << 21) | (p[2] << 14) | (p[3] << 7) | p[4]
+
+  ## Decode a SYSEX_EVENT into (event, state, sequence number, keyer time in us)
+  @staticmethod
+  def parse_event(message):
+    p = CWKeyer._payload(message,SYSEX_EVENT)
+    if p is None or len(p) != 8: return None
+    return (p[0], p[1], p[2], CWKeyer._time(p[3:8]))
+
+  ## Decode a SYSEX_CLOCK into (keyer time in us, tag)
+  @staticmethod
+  def parse_clock(message):
+    p = CWKeyer._payload(message,SYSEX_CLOCK)
+    if p is None or len(p) != 7: return None
+    return (CWKeyer._time(p[0:5]), (p[5] << 7) | p[6])
+
   ## 0.0 to 1.0
   def master_volume(self,v): self.txccf(MIDI_MASTER_VOLUME,v)
 
   ## 0.0 to 1.0
   def sidetone_volume(self,v): self.txccf(MIDI_SIDETONE_VOLUME,v)
 
-  ## 250Hz to ~1270Hz
-  def sidetone_frequency(self,v):
-    if v < 250:  v = 250
-    if v > 1270: v = 1270
-    v = (v - 250) >> 3
-    self.txcc(MIDI_SIDETONE_FREQUENCY,v)
+  ## 0 to 5000 Hz, 1 Hz steps
+  def sidetone_frequency(self,v): self.set('MIDI_NRPN_SIDETONE_FREQUENCY',v)
 
   ## 1 to 127 WPM
-  def cw_speed(self,v): self.txcc(MIDI_CW_SPEED,v)
-
-  ## Set the accumulator with v, overwrites any accumulated value
-  def set_accum_a(self,v): self.txcc(MIDI_SET_A,v)
-  def set_accum_b(self,v): self.txcc(MIDI_SET_B,v)
-  def set_accum_c(self,v): self.txcc(MIDI_SET_C,v)
-
-  ## Set the RX channel for the keyer, keyer responds to this command on any channel
-  def rx_ch(self,v): self.txcc(MIDI_RX_CH,v)
-
-  ## Set the TX channel the keyer will use for notes and responses
-  def tx_ch(self,v): self.txcc(MIDI_TX_CH,v)
-
-  def keydown_note(self,v): self.txcc(MIDI_KEYDOWN_NOTE,v)
-  def cwptt_note(self,v): self.txcc(MIDI_CWPTT_NOTE, v)
-  def ptt_mic_note(self,v): self.txcc(MIDI_PTT_MIC_NOTE,v)
-  def ptt_in_note(self,v): self.txcc(MIDI_PTT_IN_NOTE,v)
-
-  ## Enable/disable MIDI responses
-  def response(self,v): self.txcc(MIDI_RESPONSE,v)
-
-  ## Enable/disable POTs
-  def enable_pots(self,v): self.txcc(MIDI_ENABLE_POTS,v)
-
-  ## Enable/disable CW PTT
-  def keyer_autoptt(self,v): self.txcc(MIDI_KEYER_AUTOPTT,v)
-
-  def keyer_leadin(self,v): self.txcc(MIDI_KEYER_LEADIN,v)
-  def keyer_hang(self,v): self.txcc(MIDI_KEYER_HANG,v)
-
-  def mute_cwptt(self,v): self.txcc(MIDI_MUTE_CWPTT,v)
-
-  ## enable/disable that MICIN triggers the hardware PTT output
-  def micptt_hwptt(self,v): self.txcc(MIDI_MICPTT_HWPTT,v)
-
-  ## piHPSDR specfic
-  def speed_ctrl(self,v): self.txcc(MIDI_SPEED_CTRL,v)
-  def freq_ctrl(self,v): self.txcc(MIDI_FREQ_CTRL,v)
-
-  def wm8960_enable(self,v): self.txcc(MIDI_WM8960_ENABLE,v)
-
-  def wm8960_input_level(self,l,r=None):
-    if r:
-      ## Send right as accumulator first
-      self.txccf(MIDI_SET_A,r)
-    self.txccf(MIDI_WM8960_INPUT_LEVEL,l)
-
-  def wm8960_input_select(self,v): self.txcc(MIDI_WM8960_INPUT_SELECT,v)
-
-  def wm8960_volume(self,l,r=None):
-    if r:
-      ## Send right as accumulator first
-      self.txccf(MIDI_SET_A,r)
-    self.txccf(MIDI_WM8960_VOLUME,l)
-
-  def wm8960_headphone_volume(self,l,r=None):
-    if r:
-      ## Send right as accumulator first
-      self.txccf(MIDI_SET_A,r)
-    self.txccf(MIDI_WM8960_HEADPHONE_VOLUME,l)
-
-  def wm8960_headphone_power(self,l,r):
-    v = 0
-    if l: v = 2
-    if r: v = v | 1
-    self.txcc(MIDI_WM8960_HEADPHONE_POWER,v)
-
-  def wm8960_speaker_volume(self,l,r=None):
-    if r:
-      ## Send right as accumulator first
-      self.txccf(MIDI_SET_A,r)
-    self.txccf(MIDI_WM8960_SPEAKER_VOLUME,l)
-
-  def wm8960_speaker_power(self,l,r):
-    v = 0
-    if l: v = 2
-    if r: v = v | 1
-    self.txcc(MIDI_WM8960_SPEAKER_POWER,v)
-
-  def wm8960_disable_adchpf(self,v): self.txcc(MIDI_WM8960_DISABLE_ADCHPF,v)
-  def wm8960_enable_micbias(self,v): self.txcc(MIDI_WM8960_ENABLE_MICBIAS,v)
-
-  def wm8960_enable_alc(self,l,r):
-    v = 0
-    if l: v = 2
-    if r: v = v | 1
-    self.txcc(MIDI_WM8960_ENABLE_ALC,v)
-
-  def wm8960_enable_mic_power(self,l,r):
-    v = 0
-    if l: v = 2
-    if r: v = v | 1
-    self.txcc(MIDI_WM8960_ENABLE_MIC_POWER,v)
-
-  def wm8960_enable_linein_power(self,l,r):
-    v = 0
-    if l: v = 2
-    if r: v = v | 1
-    self.txcc(MIDI_WM8960_ENABLE_MIC_POWER,v)
-
+  def cw_speed(self,v): self.set('MIDI_CW_SPEED',v)
+
+  ## Set MIDI channel (1-16, 0 = off), accepted on any channel
+  def midi_channel(self,v): self.set('MIDI_SET_CHANNEL',v)
+
+  ## MIDI notes to the radio, 128 to 255 turn the note off
+  def keydown_note(self,v): self.set('MIDI_NRPN_KEYDOWN_NOTE',v)
+  def ptt_note(self,v): self.set('MIDI_NRPN_PTT_NOTE',v)
+
+  ## Enable/disable control change responses to the controller
+  def response(self,v): self.txcc(MIDI_RESPONSE,127 if v else 0)
+
+  ## Enable/disable pots
+  def enable_pots(self,v): self.txcc(MIDI_ENABLE_POTS,127 if v else 0)
+
+  ## Enable/disable auto-PTT, lead-in time (10 ms units), hang time (dits)
+  def keyer_autoptt(self,v): self.txcc(MIDI_KEYER_AUTOPTT,127 if v else 0)
+  def keyer_leadin(self,v): self.set('MIDI_KEYER_LEADIN',v)
+  def keyer_hang(self,v): self.set('MIDI_KEYER_HANG',v)
+
+  ## Enable/disable muting of RX audio during auto-PTT
+  def mute_cwptt(self,v): self.txcc(MIDI_MUTE_CWPTT,127 if v else 0)
+
+  ## Enable/disable that MICIN/CWPTT trigger the hardware PTT output
+  def micptt_hwptt(self,v): self.txcc(MIDI_MICPTT_HWPTT,127 if v else 0)
+  def cwptt_hwptt(self,v): self.txcc(MIDI_CWPTT_HWPTT,127 if v else 0)
+
+  ## PTT-in de-bouncing time (ms), and PTT-out latency histogram: the keyer
+  ## answers with NRPN_PTT_LATENCY_COUNT, edges within 2^n ... 2^(n+1)-1 CPU cycles
+  def ptt_debounce(self,v): self.set('MIDI_NRPN_PTT_DEBOUNCE',v)
+  def ptt_latency_bin(self,n): self.set('MIDI_NRPN_PTT_LATENCY_BIN',n)
+
+  ## Left and right levels 0.0 to 1.0, packed into 7 bits each
+  def _lr(self,l,r):
+    if r is None: r = l
+    l = min(max(l,0.0),1.0)
+    r = min(max(r,0.0),1.0)
+    return (int(l*127.5) << 7) | int(r*127.5)
+
+  ## Left and right on/off, packed into 2 bits
+  def _onoff(self,l,r):
+    return (2 if l else 0) | (1 if r else 0)
+
+  def wm8960_enable(self,v): self.txnrpn(MIDI_NRPN_WM8960_ENABLE,1 if v else 0)
+  def wm8960_input_level(self,l,r=None): self.txnrpn(MIDI_NRPN_WM8960_INPUT_LEVEL,self._lr(l,r))
+  def wm8960_input_select(self,v): self.txnrpn(MIDI_NRPN_WM8960_INPUT_SELECT,v)
+  def wm8960_volume(self,l,r=None): self.txnrpn(MIDI_NRPN_WM8960_VOLUME,self._lr(l,r))
+  def wm8960_headphone_volume(self,l,r=None): self.txnrpn(MIDI_NRPN_WM8960_HEADPHONE_VOLUME,self._lr(l,r))
+  def wm8960_headphone_power(self,l,r): self.txnrpn(MIDI_NRPN_WM8960_HEADPHONE_POWER,self._onoff(l,r))
+  def wm8960_speaker_volume(self,l,r=None): self.txnrpn(MIDI_NRPN_WM8960_SPEAKER_VOLUME,self._lr(l,r))
+  def wm8960_speaker_power(self,l,r): self.txnrpn(MIDI_NRPN_WM8960_SPEAKER_POWER,self._onoff(l,r))
+  def wm8960_disable_adchpf(self,v): self.txnrpn(MIDI_NRPN_WM8960_DISABLE_ADCHPF,1 if v else 0)
+  def wm8960_enable_micbias(self,v): self.txnrpn(MIDI_NRPN_WM8960_ENABLE_MICBIAS,1 if v else 0)
+  def wm8960_enable_alc(self,l,r): self.txnrpn(MIDI_NRPN_WM8960_ENABLE_ALC,self._onoff(l,r))
+  def wm8960_enable_mic_power(self,l,r): self.txnrpn(MIDI_NRPN_WM8960_MIC_POWER,self._onoff(l,r))
+  def wm8960_enable_linein_power(self,l,r): self.txnrpn(MIDI_NRPN_WM8960_LINEIN_POWER,self._onoff(l,r))
+
+  ## Write 9-bit value under 9-bit mask to register reg (0 to 63)
   def wm8960_raw_write(self,reg,val,mask,force=False):
-    ## Repacking as midi has 7-bit values but wm8960 uses 9-bit values
-    a = val   & 0x7f          ## a is lower 7 bits of value
-    b = mask & 0x7f           ## b is lower 7 bits of mask
-    c = 0x10 if force else 0  ## force is bit 4 of c
-    c = c | ((mask >> 5) & 0b01100) ## mask upper bits are c[3:2]
-    c = c | ((val >> 7) & 0b011)    ## value upper bits are c[1:0]
-    self.txcc(MIDI_SET_A,a)
-    self.txcc(MIDI_SET_B,b)
-    self.txcc(MIDI_SET_C,c)
-    self.txcc(MIDI_WM8960_RAW_WRITE,reg)
+    self.txnrpn(MIDI_NRPN_WM8960_RAW_MASK,mask & 0x1ff)
+    self.txnrpn(MIDI_NRPN_WM8960_RAW_DATA,val & 0x1ff)
+    self.txnrpn(MIDI_NRPN_WM8960_RAW_WRITE,(reg & 0x3f) | (0x40 if force else 0))
 
 
 if __name__ == "__main__":
@@ -0,0 +1,207 @@
+## Generated by genparams.py from CWKeyerParameters.h, do not edit
+
+MIDI_NRPN_CC_MSB                     =    99  ## cc NRPN number, high 7 bits
+MIDI_NRPN_CC_LSB                     =    98  ## cc NRPN number, low 7 bits
+MIDI_NRPN_VAL_MSB                    =     6  ## cc NRPN value, high 7 bits
+MIDI_NRPN_VAL_LSB                    =    38  ## cc NRPN value, low 7 bits, sets the NRPN
+MIDI_MASTER_VOLUME                   =     7  ## cc set master volume
+MIDI_MASTER_BALANCE                  =     8  ## cc stereo balance of RX audio (64 = center)
+MIDI_MASTER_PAN                      =    10  ## cc stereo position of CW tone (64 = center)
+MIDI_SIDETONE_VOLUME                 =    12  ## cc set sidetone volume
+MIDI_SIDETONE_FREQUENCY              =    13  ## cc set sidetone frequency
+MIDI_INPUT_LEVEL                     =    16  ## cc TODO
+MIDI_ENABLE_POTS                     =    64  ## cc enable/disable potentiometers
+MIDI_KEYER_AUTOPTT                   =    65  ## cc enable/disable auto-PTT from CW keyer
+MIDI_RESPONSE                        =    66  ## cc enable/disable reporting back to SDR and MIDI controller
+MIDI_MUTE_CWPTT                      =    67  ## cc enable/disable muting of RX audio during auto-PTT
+MIDI_MICPTT_HWPTT                    =    68  ## cc enable/disable that MICIN triggers the hardware PTT output
+MIDI_CWPTT_HWPTT                     =    69  ## cc enable/disable that CWPTT triggers the hardware PTT output
+MIDI_KEYER_HANG                      =    72  ## cc set Keyer hang time (if auto-PTT active)
+MIDI_KEYER_LEADIN                    =    73  ## cc set Keyer lead-in time (if auto-PTT active)
+MIDI_CW_SPEED                        =    74  ## cc set CW speed
+MIDI_INPUT_SELECT                    =    75  ## cc TODO
+MIDI_SET_CHANNEL                     =   119  ## cc Change the default channel to use (accepted on any channel)
+NRPN_ID_KEYER                        =     1  ## status identify this keyer for the correspondent
+NRPN_ID_VERSION                      =     2  ## status identify this keyer version for the correspondent
+NRPN_NNRPN                           =     3  ## status return how many NRPNs are allocated
+NRPN_NRPN_QUERY                      =     4  ## nrpn take the value as a nrpn number and send that nrpns value, no response if no value set
+NRPN_NRPN_UNSET                      =     5  ## nrpn take the value as a nrpn number and make that nrpn NRPNV_NOTSET
+NRPN_TONE_CYCLES                     =     6  ## status return CPU cycles of the last side tone mixer update
+NRPN_TONE_CYCLES_MAX                 =     7  ## status return max. CPU cycles of a side tone mixer update
+NRPN_AUDIO_MEMORY_MAX                =     8  ## status return max. number of audio blocks in use
+NRPN_AUDIO_ALLOC_FAILURES            =     9  ## status return number of failed audio block allocations in the side tone mixer
+MIDI_NRPN_WM8960_ENABLE              =    11  ## nrpn 
+MIDI_NRPN_WM8960_INPUT_LEVEL         =    12  ## nrpn 
+MIDI_NRPN_WM8960_INPUT_SELECT        =    13  ## nrpn 
+MIDI_NRPN_WM8960_VOLUME              =    14  ## nrpn 
+MIDI_NRPN_WM8960_HEADPHONE_VOLUME    =    15  ## nrpn 
+MIDI_NRPN_WM8960_HEADPHONE_POWER     =    16  ## nrpn 
+MIDI_NRPN_WM8960_SPEAKER_VOLUME      =    17  ## nrpn 
+MIDI_NRPN_WM8960_SPEAKER_POWER       =    18  ## nrpn 
+MIDI_NRPN_WM8960_DISABLE_ADCHPF      =    19  ## nrpn 
+MIDI_NRPN_WM8960_ENABLE_MICBIAS      =    20  ## nrpn 
+MIDI_NRPN_WM8960_ENABLE_ALC          =    21  ## nrpn 
+MIDI_NRPN_WM8960_MIC_POWER           =    22  ## nrpn 
+MIDI_NRPN_WM8960_LINEIN_POWER        =    23  ## nrpn 
+MIDI_NRPN_WM8960_RAW_MASK            =    24  ## nrpn 
+MIDI_NRPN_WM8960_RAW_DATA            =    25  ## nrpn 
+MIDI_NRPN_WM8960_RAW_WRITE           =    26  ## nrpn register number, +64 to force the write
+MIDI_NRPN_KEYDOWN_NOTE               =    27  ## nrpn MIDI note for key-down (128-255: off)
+MIDI_NRPN_PTT_NOTE                   =    28  ## nrpn MIDI note for PTT (128-255: off)
+MIDI_NRPN_WINDOW_SHAPE               =    29  ## nrpn shape of the keying ramp (enum window_shape)
+MIDI_NRPN_WINDOW_RISETIME            =    30  ## nrpn rise time of the keying ramp
+MIDI_NRPN_SIDETONE_FREQUENCY         =    31  ## nrpn set sidetone frequency
+NRPN_CODEC_QUEUE_DEPTH               =    32  ## status return number of pending codec commands
+NRPN_CODEC_TIME                      =    33  ## status return codec (I2C) time in the last loop() (micro-seconds)
+NRPN_CODEC_TIME_MAX                  =    34  ## status return max. codec (I2C) time in a loop() (micro-seconds)
+MIDI_NRPN_DUCK_DEPTH                 =    35  ## nrpn RX audio attenuation during PTT (100 means full mute)
+MIDI_NRPN_DUCK_ATTACK                =    36  ## nrpn RX audio ducking attack time
+MIDI_NRPN_DUCK_RELEASE               =    37  ## nrpn RX audio ducking release time
+MIDI_NRPN_DECODER_ENABLE             =    38  ## nrpn enable/disable the CW decoder on the RX audio
+MIDI_NRPN_DECODER_FREQUENCY          =    39  ## nrpn set CW decoder frequency
+NRPN_DECODER_CHAR                    =    40  ## report character decoded from the RX audio (ASCII)
+NRPN_DECODER_WPM                     =    41  ## report estimated speed of the RX signal
+NRPN_DECODER_CYCLES_MAX              =    42  ## status return max. CPU cycles of a CW decoder update
+MIDI_NRPN_RX_FILTER_BANDWIDTH        =    43  ## nrpn RX audio CW filter bandwidth (0 = off)
+NRPN_RX_FILTER_CYCLES_MAX            =    44  ## status return max. CPU cycles of the RX audio CW filter per block
+MIDI_NRPN_VOX_ENABLE                 =    45  ## nrpn enable/disable VOX on the microphone audio
+MIDI_NRPN_VOX_THRESHOLD              =    46  ## nrpn VOX threshold
+MIDI_NRPN_VOX_ATTACK                 =    47  ## nrpn VOX attack time
+MIDI_NRPN_VOX_HOLD                   =    48  ## nrpn VOX hold time
+MIDI_NRPN_VOX_ANTIVOX                =    49  ## nrpn anti-VOX: attenuation of the RX level added to the threshold (100 means off)
+NRPN_MIDI_DROPPED                    =    50  ## status return number of MIDI control changes dropped (queue full)
+NRPN_MIDI_DEFERRED                   =    51  ## status return number of MIDI control changes executed in a later loop()
+NRPN_MIDI_LATE                       =    52  ## status return number of MIDI control changes executed more than 10 msec late
+MIDI_NRPN_MIDI_CC_INTERVAL           =    53  ## nrpn min. interval between control change responses
+NRPN_MIDI_OUT_QUEUE_DEPTH            =    54  ## status return number of pending control change responses
+NRPN_MIDI_OUT_LATENCY                =    55  ## status return latency of the last control change response (micro-seconds)
+NRPN_MIDI_OUT_LATENCY_MAX            =    56  ## status return max. latency of a control change response (micro-seconds)
+NRPN_MIDI_CC_CYCLES                  =    57  ## status return CPU cycles spent on the last MIDI control change
+NRPN_MIDI_CC_CYCLES_MAX              =    58  ## status return max. CPU cycles spent on a MIDI control change
+MIDI_NRPN_SUBSCRIBE                  =    59  ## nrpn report changes of a control (0-127) or NRPN (128 + number) with SYSEX_REPORT, 256 = all persistent ones
+MIDI_NRPN_UNSUBSCRIBE                =    60  ## nrpn stop reporting a control (0-127) or NRPN (128 + number), 256 = all
+MIDI_NRPN_RESYNC                     =    61  ## nrpn take the value as the last report sequence number received, report everything subscribed that changed since
+NRPN_REPORT_SEQUENCE                 =    62  ## status return sequence number of the last SYSEX_REPORT
+MIDI_NRPN_PERSIST_CLEAR              =    63  ## nrpn forget the saved settings, the next startup uses the defaults
+NRPN_PERSIST_WRITES                  =    64  ## status return number of settings records written to EEPROM since startup
+NRPN_PERSIST_TIME_MAX                =    65  ## status return max. EEPROM write time in a loop() (micro-seconds)
+MIDI_NRPN_BOOT_TIMELINE              =    66  ## nrpn take the value as a startup stage (enum setup_stage), report the time it was completed
+NRPN_BOOT_TIME_HIGH                  =    67  ## report time a startup stage was completed (micro-seconds since reset), upper 14 bits
+NRPN_BOOT_TIME_LOW                   =    68  ## report time a startup stage was completed (micro-seconds since reset), lower 14 bits
+NRPN_BOOT_STAGE                      =    69  ## status return the startup stage to be executed next (enum setup_stage, SETUP_DONE when complete)
+MIDI_NRPN_TIMESTAMPS                 =    70  ## nrpn enable/disable SYSEX_EVENT after key and PTT notes, and periodic SYSEX_CLOCK
+MIDI_NRPN_CLOCK_INTERVAL             =    71  ## nrpn time between periodic SYSEX_CLOCK messages
+MIDI_NRPN_PLAYOUT_DELAY              =    72  ## nrpn delay of host keying (key notes and SYSEX_KEY) in the playout buffer, 0 = key notes immediately
+NRPN_PLAYOUT_DEPTH                   =    73  ## status return number of key transitions waiting in the playout buffer
+NRPN_PLAYOUT_DEPTH_MAX               =    74  ## status return max. number of key transitions in the playout buffer
+NRPN_PLAYOUT_LATE                    =    75  ## status return number of key transitions that arrived after their playout time
+NRPN_PLAYOUT_DROPPED                 =    76  ## status return number of key transitions dropped (playout buffer full)
+MIDI_NRPN_PTT_DEBOUNCE               =    77  ## nrpn PTT-in de-bouncing: edges within this time after an accepted edge are ignored
+MIDI_NRPN_PTT_LATENCY_BIN            =    78  ## nrpn take the value as a bin n of the PTT-out latency histogram, report its count
+NRPN_PTT_LATENCY_COUNT               =    79  ## report number of PTT-in edges that reached PTT-out within 2^n ... 2^(n+1)-1 CPU cycles
+NRPN_PTT_BOUNCES                     =    80  ## status return number of PTT-in edges ignored by de-bouncing
+NRPN_PTT_MIDI_LATENCY_MAX            =    81  ## status return max. time from a PTT-in edge to the MIDI PTT note (micro-seconds)
+
+PARAMS = {
+  'MIDI_NRPN_CC_MSB': {'name': 'MIDI_NRPN_CC_MSB', 'kind': 'cc', 'number': 99, 'min': 0, 'max': 127, 'flags': [], 'unit': '', 'doc': 'NRPN number, high 7 bits'},
+  'MIDI_NRPN_CC_LSB': {'name': 'MIDI_NRPN_CC_LSB', 'kind': 'cc', 'number': 98, 'min': 0, 'max': 127, 'flags': [], 'unit': '', 'doc': 'NRPN number, low 7 bits'},
+  'MIDI_NRPN_VAL_MSB': {'name': 'MIDI_NRPN_VAL_MSB', 'kind': 'cc', 'number': 6, 'min': 0, 'max': 127, 'flags': [], 'unit': '', 'doc': 'NRPN value, high 7 bits'},
+  'MIDI_NRPN_VAL_LSB': {'name': 'MIDI_NRPN_VAL_LSB', 'kind': 'cc', 'number': 38, 'min': 0, 'max': 127, 'flags': [], 'unit': '', 'doc': 'NRPN value, low 7 bits, sets the NRPN'},
+  'MIDI_MASTER_VOLUME': {'name': 'MIDI_MASTER_VOLUME', 'kind': 'cc', 'number': 7, 'min': 0, 'max': 127, 'flags': ['persist'], 'unit': '', 'doc': 'set master volume'},
+  'MIDI_MASTER_BALANCE': {'name': 'MIDI_MASTER_BALANCE', 'kind': 'cc', 'number': 8, 'min': 0, 'max': 127, 'flags': ['persist'], 'unit': '', 'doc': 'stereo balance of RX audio (64 = center)'},
+  'MIDI_MASTER_PAN': {'name': 'MIDI_MASTER_PAN', 'kind': 'cc', 'number': 10, 'min': 0, 'max': 127, 'flags': ['persist'], 'unit': '', 'doc': 'stereo position of CW tone (64 = center)'},
+  'MIDI_SIDETONE_VOLUME': {'name': 'MIDI_SIDETONE_VOLUME', 'kind': 'cc', 'number': 12, 'min': 0, 'max': 127, 'flags': ['persist'], 'unit': '', 'doc': 'set sidetone volume'},
+  'MIDI_SIDETONE_FREQUENCY': {'name': 'MIDI_SIDETONE_FREQUENCY', 'kind': 'cc', 'number': 13, 'min': 0, 'max': 127, 'flags': ['persist'], 'unit': '10Hz', 'doc': 'set sidetone frequency'},
+  'MIDI_INPUT_LEVEL': {'name': 'MIDI_INPUT_LEVEL', 'kind': 'cc', 'number': 16, 'min': 0, 'max': 127, 'flags': [], 'unit': '', 'doc': 'TODO'},
+  'MIDI_ENABLE_POTS': {'name': 'MIDI_ENABLE_POTS', 'kind': 'cc', 'number': 64, 'min': 0, 'max': 127, 'flags': ['bool', 'persist'], 'unit': '', 'doc': 'enable/disable potentiometers'},
+  'MIDI_KEYER_AUTOPTT': {'name': 'MIDI_KEYER_AUTOPTT', 'kind': 'cc', 'number': 65, 'min': 0, 'max': 127, 'flags': ['bool', 'persist'], 'unit': '', 'doc': 'enable/disable auto-PTT from CW keyer'},
+  'MIDI_RESPONSE': {'name': 'MIDI_RESPONSE', 'kind': 'cc', 'number': 66, 'min': 0, 'max': 127, 'flags': ['bool', 'persist'], 'unit': '', 'doc': 'enable/disable reporting back to SDR and MIDI controller'},
+  'MIDI_MUTE_CWPTT': {'name': 'MIDI_MUTE_CWPTT', 'kind': 'cc', 'number': 67, 'min': 0, 'max': 127, 'flags': ['bool', 'persist'], 'unit': '', 'doc': 'enable/disable muting of RX audio during auto-PTT'},
+  'MIDI_MICPTT_HWPTT': {'name': 'MIDI_MICPTT_HWPTT', 'kind': 'cc', 'number': 68, 'min': 0, 'max': 127, 'flags': ['bool', 'persist'], 'unit': '', 'doc': 'enable/disable that MICIN triggers the hardware PTT output'},
+  'MIDI_CWPTT_HWPTT': {'name': 'MIDI_CWPTT_HWPTT', 'kind': 'cc', 'number': 69, 'min': 0, 'max': 127, 'flags': ['bool', 'persist'], 'unit': '', 'doc': 'enable/disable that CWPTT triggers the hardware PTT output'},
+  'MIDI_KEYER_HANG': {'name': 'MIDI_KEYER_HANG', 'kind': 'cc', 'number': 72, 'min': 0, 'max': 127, 'flags': ['persist'], 'unit': 'dits', 'doc': 'set Keyer hang time (if auto-PTT active)'},
+  'MIDI_KEYER_LEADIN': {'name': 'MIDI_KEYER_LEADIN', 'kind': 'cc', 'number': 73, 'min': 0, 'max': 127, 'flags': ['persist'], 'unit': '10ms', 'doc': 'set Keyer lead-in time (if auto-PTT active)'},
+  'MIDI_CW_SPEED': {'name': 'MIDI_CW_SPEED', 'kind': 'cc', 'number': 74, 'min': 1, 'max': 127, 'flags': ['persist'], 'unit': 'wpm', 'doc': 'set CW speed'},
+  'MIDI_INPUT_SELECT': {'name': 'MIDI_INPUT_SELECT', 'kind': 'cc', 'number': 75, 'min': 0, 'max': 127, 'flags': [], 'unit': '', 'doc': 'TODO'},
+  'MIDI_SET_CHANNEL': {'name': 'MIDI_SET_CHANNEL', 'kind': 'cc', 'number': 119, 'min': 0, 'max': 127, 'flags': [], 'unit': '', 'doc': 'Change the default channel to use (accepted on any channel)'},
+  'NRPN_ID_KEYER': {'name': 'NRPN_ID_KEYER', 'kind': 'status', 'number': 1, 'doc': 'identify this keyer for the correspondent'},
+  'NRPN_ID_VERSION': {'name': 'NRPN_ID_VERSION', 'kind': 'status', 'number': 2, 'doc': 'identify this keyer version for the correspondent'},
+  'NRPN_NNRPN': {'name': 'NRPN_NNRPN', 'kind': 'status', 'number': 3, 'doc': 'return how many NRPNs are allocated'},
+  'NRPN_NRPN_QUERY': {'name': 'NRPN_NRPN_QUERY', 'kind': 'nrpn', 'number': 4, 'min': 0, 'max': 16383, 'flags': [], 'unit': '', 'doc': 'take the value as a nrpn number and send that nrpns value, no response if no value set'},
+  'NRPN_NRPN_UNSET': {'name': 'NRPN_NRPN_UNSET', 'kind': 'nrpn', 'number': 5, 'min': 0, 'max': 16383, 'flags': [], 'unit': '', 'doc': 'take the value as a nrpn number and make that nrpn NRPNV_NOTSET'},
+  'NRPN_TONE_CYCLES': {'name': 'NRPN_TONE_CYCLES', 'kind': 'status', 'number': 6, 'doc': 'return CPU cycles of the last side tone mixer update'},
+  'NRPN_TONE_CYCLES_MAX': {'name': 'NRPN_TONE_CYCLES_MAX', 'kind': 'status', 'number': 7, 'doc': 'return max. CPU cycles of a side tone mixer update'},
+  'NRPN_AUDIO_MEMORY_MAX': {'name': 'NRPN_AUDIO_MEMORY_MAX', 'kind': 'status', 'number': 8, 'doc': 'return max. number of audio blocks in use'},
+  'NRPN_AUDIO_ALLOC_FAILURES': {'name': 'NRPN_AUDIO_ALLOC_FAILURES', 'kind': 'status', 'number': 9, 'doc': 'return number of failed audio block allocations in the side tone mixer'},
+  'MIDI_NRPN_WM8960_ENABLE': {'name': 'MIDI_NRPN_WM8960_ENABLE', 'kind': 'nrpn', 'number': 11, 'min': 0, 'max': 16383, 'flags': ['persist'], 'unit': '', 'doc': ''},
+  'MIDI_NRPN_WM8960_INPUT_LEVEL': {'name': 'MIDI_NRPN_WM8960_INPUT_LEVEL', 'kind': 'nrpn', 'number': 12, 'min': 0, 'max': 16383, 'flags': ['persist'], 'unit': 'l7r7', 'doc': ''},
+  'MIDI_NRPN_WM8960_INPUT_SELECT': {'name': 'MIDI_NRPN_WM8960_INPUT_SELECT', 'kind': 'nrpn', 'number': 13, 'min': 0, 'max': 16383, 'flags': ['persist'], 'unit': '', 'doc': ''},
+  'MIDI_NRPN_WM8960_VOLUME': {'name': 'MIDI_NRPN_WM8960_VOLUME', 'kind': 'nrpn', 'number': 14, 'min': 0, 'max': 16383, 'flags': ['persist'], 'unit': 'l7r7', 'doc': ''},
+  'MIDI_NRPN_WM8960_HEADPHONE_VOLUME': {'name': 'MIDI_NRPN_WM8960_HEADPHONE_VOLUME', 'kind': 'nrpn', 'number': 15, 'min': 0, 'max': 16383, 'flags': ['persist'], 'unit': 'l7r7', 'doc': ''},
+  'MIDI_NRPN_WM8960_HEADPHONE_POWER': {'name': 'MIDI_NRPN_WM8960_HEADPHONE_POWER', 'kind': 'nrpn', 'number': 16, 'min': 0, 'max': 16383, 'flags': ['persist'], 'unit': '', 'doc': ''},
+  'MIDI_NRPN_WM8960_SPEAKER_VOLUME': {'name': 'MIDI_NRPN_WM8960_SPEAKER_VOLUME', 'kind': 'nrpn', 'number': 17, 'min': 0, 'max': 16383, 'flags': ['persist'], 'unit': 'l7r7', 'doc': ''},
+  'MIDI_NRPN_WM8960_SPEAKER_POWER': {'name': 'MIDI_NRPN_WM8960_SPEAKER_POWER', 'kind': 'nrpn', 'number': 18, 'min': 0, 'max': 16383, 'flags': ['persist'], 'unit': '', 'doc': ''},
+  'MIDI_NRPN_WM8960_DISABLE_ADCHPF': {'name': 'MIDI_NRPN_WM8960_DISABLE_ADCHPF', 'kind': 'nrpn', 'number': 19, 'min': 0, 'max': 16383, 'flags': ['persist'], 'unit': '', 'doc': ''},
+  'MIDI_NRPN_WM8960_ENABLE_MICBIAS': {'name': 'MIDI_NRPN_WM8960_ENABLE_MICBIAS', 'kind': 'nrpn', 'number': 20, 'min': 0, 'max': 16383, 'flags': ['persist'], 'unit': '', 'doc': ''},
+  'MIDI_NRPN_WM8960_ENABLE_ALC': {'name': 'MIDI_NRPN_WM8960_ENABLE_ALC', 'kind': 'nrpn', 'number': 21, 'min': 0, 'max': 16383, 'flags': ['persist'], 'unit': '', 'doc': ''},
+  'MIDI_NRPN_WM8960_MIC_POWER': {'name': 'MIDI_NRPN_WM8960_MIC_POWER', 'kind': 'nrpn', 'number': 22, 'min': 0, 'max': 16383, 'flags': ['persist'], 'unit': '', 'doc': ''},
+  'MIDI_NRPN_WM8960_LINEIN_POWER': {'name': 'MIDI_NRPN_WM8960_LINEIN_POWER', 'kind': 'nrpn', 'number': 23, 'min': 0, 'max': 16383, 'flags': ['persist'], 'unit': '', 'doc': ''},
+  'MIDI_NRPN_WM8960_RAW_MASK': {'name': 'MIDI_NRPN_WM8960_RAW_MASK', 'kind': 'nrpn', 'number': 24, 'min': 0, 'max': 511, 'flags': [], 'unit': '', 'doc': ''},
+  'MIDI_NRPN_WM8960_RAW_DATA': {'name': 'MIDI_NRPN_WM8960_RAW_DATA', 'kind': 'nrpn', 'number': 25, 'min': 0, 'max': 511, 'flags': [], 'unit': '', 'doc': ''},
+  'MIDI_NRPN_WM8960_RAW_WRITE': {'name': 'MIDI_NRPN_WM8960_RAW_WRITE', 'kind': 'nrpn', 'number': 26, 'min': 0, 'max': 127, 'flags': [], 'unit': '', 'doc': 'register number, +64 to force the write'},
+  'MIDI_NRPN_KEYDOWN_NOTE': {'name': 'MIDI_NRPN_KEYDOWN_NOTE', 'kind': 'nrpn', 'number': 27, 'min': 0, 'max': 255, 'flags': ['persist'], 'unit': '', 'doc': 'MIDI note for key-down (128-255: off)'},
+  'MIDI_NRPN_PTT_NOTE': {'name': 'MIDI_NRPN_PTT_NOTE', 'kind': 'nrpn', 'number': 28, 'min': 0, 'max': 255, 'flags': ['persist'], 'unit': '', 'doc': 'MIDI note for PTT (128-255: off)'},
+  'MIDI_NRPN_WINDOW_SHAPE': {'name': 'MIDI_NRPN_WINDOW_SHAPE', 'kind': 'nrpn', 'number': 29, 'min': 0, 'max': 2, 'flags': ['persist'], 'unit': '', 'doc': 'shape of the keying ramp (enum window_shape)'},
+  'MIDI_NRPN_WINDOW_RISETIME': {'name': 'MIDI_NRPN_WINDOW_RISETIME', 'kind': 'nrpn', 'number': 30, 'min': 2, 'max': 6, 'flags': ['persist'], 'unit': 'ms', 'doc': 'rise time of the keying ramp'},
+  'MIDI_NRPN_SIDETONE_FREQUENCY': {'name': 'MIDI_NRPN_SIDETONE_FREQUENCY', 'kind': 'nrpn', 'number': 31, 'min': 0, 'max': 5000, 'flags': ['persist'], 'unit': 'Hz', 'doc': 'set sidetone frequency'},
+  'NRPN_CODEC_QUEUE_DEPTH': {'name': 'NRPN_CODEC_QUEUE_DEPTH', 'kind': 'status', 'number': 32, 'doc': 'return number of pending codec commands'},
+  'NRPN_CODEC_TIME': {'name': 'NRPN_CODEC_TIME', 'kind': 'status', 'number': 33, 'doc': 'return codec (I2C) time in the last loop() (micro-seconds)'},
+  'NRPN_CODEC_TIME_MAX': {'name': 'NRPN_CODEC_TIME_MAX', 'kind': 'status', 'number': 34, 'doc': 'return max. codec (I2C) time in a loop() (micro-seconds)'},
+  'MIDI_NRPN_DUCK_DEPTH': {'name': 'MIDI_NRPN_DUCK_DEPTH', 'kind': 'nrpn', 'number': 35, 'min': 0, 'max': 100, 'flags': ['persist'], 'unit': 'dB', 'doc': 'RX audio attenuation during PTT (100 means full mute)'},
+  'MIDI_NRPN_DUCK_ATTACK': {'name': 'MIDI_NRPN_DUCK_ATTACK', 'kind': 'nrpn', 'number': 36, 'min': 0, 'max': 100, 'flags': ['persist'], 'unit': 'ms', 'doc': 'RX audio ducking attack time'},
+  'MIDI_NRPN_DUCK_RELEASE': {'name': 'MIDI_NRPN_DUCK_RELEASE', 'kind': 'nrpn', 'number': 37, 'min': 0, 'max': 100, 'flags': ['persist'], 'unit': 'ms', 'doc': 'RX audio ducking release time'},
+  'MIDI_NRPN_DECODER_ENABLE': {'name': 'MIDI_NRPN_DECODER_ENABLE', 'kind': 'nrpn', 'number': 38, 'min': 0, 'max': 1, 'flags': ['persist'], 'unit': '', 'doc': 'enable/disable the CW decoder on the RX audio'},
+  'MIDI_NRPN_DECODER_FREQUENCY': {'name': 'MIDI_NRPN_DECODER_FREQUENCY', 'kind': 'nrpn', 'number': 39, 'min': 100, 'max': 3000, 'flags': ['persist'], 'unit': 'Hz', 'doc': 'set CW decoder frequency'},
+  'NRPN_DECODER_CHAR': {'name': 'NRPN_DECODER_CHAR', 'kind': 'report', 'number': 40, 'doc': 'character decoded from the RX audio (ASCII)'},
+  'NRPN_DECODER_WPM': {'name': 'NRPN_DECODER_WPM', 'kind': 'report', 'number': 41, 'doc': 'estimated speed of the RX signal'},
+  'NRPN_DECODER_CYCLES_MAX': {'name': 'NRPN_DECODER_CYCLES_MAX', 'kind': 'status', 'number': 42, 'doc': 'return max. CPU cycles of a CW decoder update'},
+  'MIDI_NRPN_RX_FILTER_BANDWIDTH': {'name': 'MIDI_NRPN_RX_FILTER_BANDWIDTH', 'kind': 'nrpn', 'number': 43, 'min': 0, 'max': 1000, 'flags': ['persist'], 'unit': 'Hz', 'doc': 'RX audio CW filter bandwidth (0 = off)'},
+  'NRPN_RX_FILTER_CYCLES_MAX': {'name': 'NRPN_RX_FILTER_CYCLES_MAX', 'kind': 'status', 'number': 44, 'doc': 'return max. CPU cycles of the RX audio CW filter per block'},
+  'MIDI_NRPN_VOX_ENABLE': {'name': 'MIDI_NRPN_VOX_ENABLE', 'kind': 'nrpn', 'number': 45, 'min': 0, 'max': 1, 'flags': ['persist'], 'unit': '', 'doc': 'enable/disable VOX on the microphone audio'},
+  'MIDI_NRPN_VOX_THRESHOLD': {'name': 'MIDI_NRPN_VOX_THRESHOLD', 'kind': 'nrpn', 'number': 46, 'min': 0, 'max': 100, 'flags': ['persist'], 'unit': '-dBFS', 'doc': 'VOX threshold'},
+  'MIDI_NRPN_VOX_ATTACK': {'name': 'MIDI_NRPN_VOX_ATTACK', 'kind': 'nrpn', 'number': 47, 'min': 0, 'max': 1000, 'flags': ['persist'], 'unit': 'ms', 'doc': 'VOX attack time'},
+  'MIDI_NRPN_VOX_HOLD': {'name': 'MIDI_NRPN_VOX_HOLD', 'kind': 'nrpn', 'number': 48, 'min': 0, 'max': 10000, 'flags': ['persist'], 'unit': 'ms', 'doc': 'VOX hold time'},
+  'MIDI_NRPN_VOX_ANTIVOX': {'name': 'MIDI_NRPN_VOX_ANTIVOX', 'kind': 'nrpn', 'number': 49, 'min': 0, 'max': 100, 'flags': ['persist'], 'unit': 'dB', 'doc': 'anti-VOX: attenuation of the RX level added to the threshold (100 means off)'},
+  'NRPN_MIDI_DROPPED': {'name': 'NRPN_MIDI_DROPPED', 'kind': 'status', 'number': 50, 'doc': 'return number of MIDI control changes dropped (queue full)'},
+  'NRPN_MIDI_DEFERRED': {'name': 'NRPN_MIDI_DEFERRED', 'kind': 'status', 'number': 51, 'doc': 'return number of MIDI control changes executed in a later loop()'},
+  'NRPN_MIDI_LATE': {'name': 'NRPN_MIDI_LATE', 'kind': 'status', 'number': 52, 'doc': 'return number of MIDI control changes executed more than 10 msec late'},
+  'MIDI_NRPN_MIDI_CC_INTERVAL': {'name': 'MIDI_NRPN_MIDI_CC_INTERVAL', 'kind': 'nrpn', 'number': 53, 'min': 0, 'max': 1000, 'flags': ['persist'], 'unit': 'ms', 'doc': 'min. interval between control change responses'},
+  'NRPN_MIDI_OUT_QUEUE_DEPTH': {'name': 'NRPN_MIDI_OUT_QUEUE_DEPTH', 'kind': 'status', 'number': 54, 'doc': 'return number of pending control change responses'},
+  'NRPN_MIDI_OUT_LATENCY': {'name': 'NRPN_MIDI_OUT_LATENCY', 'kind': 'status', 'number': 55, 'doc': 'return latency of the last control change response (micro-seconds)'},
+  'NRPN_MIDI_OUT_LATENCY_MAX': {'name': 'NRPN_MIDI_OUT_LATENCY_MAX', 'kind': 'status', 'number': 56, 'doc': 'return max. latency of a control change response (micro-seconds)'},
+  'NRPN_MIDI_CC_CYCLES': {'name': 'NRPN_MIDI_CC_CYCLES', 'kind': 'status', 'number': 57, 'doc': 'return CPU cycles spent on the last MIDI control change'},
+  'NRPN_MIDI_CC_CYCLES_MAX': {'name': 'NRPN_MIDI_CC_CYCLES_MAX', 'kind': 'status', 'number': 58, 'doc': 'return max. CPU cycles spent on a MIDI control change'},
+  'MIDI_NRPN_SUBSCRIBE': {'name': 'MIDI_NRPN_SUBSCRIBE', 'kind': 'nrpn', 'number': 59, 'min': 0, 'max': 256, 'flags': [], 'unit': '', 'doc': 'report changes of a control (0-127) or NRPN (128 + number) with SYSEX_REPORT, 256 = all persistent ones'},
+  'MIDI_NRPN_UNSUBSCRIBE': {'name': 'MIDI_NRPN_UNSUBSCRIBE', 'kind': 'nrpn', 'number': 60, 'min': 0, 'max': 256, 'flags': [], 'unit': '', 'doc': 'stop reporting a control (0-127) or NRPN (128 + number), 256 = all'},
+  'MIDI_NRPN_RESYNC': {'name': 'MIDI_NRPN_RESYNC', 'kind': 'nrpn', 'number': 61, 'min': 0, 'max': 16383, 'flags': [], 'unit': '', 'doc': 'take the value as the last report sequence number received, report everything subscribed that changed since'},
+  'NRPN_REPORT_SEQUENCE': {'name': 'NRPN_REPORT_SEQUENCE', 'kind': 'status', 'number': 62, 'doc': 'return sequence number of the last SYSEX_REPORT'},
+  'MIDI_NRPN_PERSIST_CLEAR': {'name': 'MIDI_NRPN_PERSIST_CLEAR', 'kind': 'nrpn', 'number': 63, 'min': 0, 'max': 1, 'flags': [], 'unit': '', 'doc': 'forget the saved settings, the next startup uses the defaults'},
+  'NRPN_PERSIST_WRITES': {'name': 'NRPN_PERSIST_WRITES', 'kind': 'status', 'number': 64, 'doc': 'return number of settings records written to EEPROM since startup'},
+  'NRPN_PERSIST_TIME_MAX': {'name': 'NRPN_PERSIST_TIME_MAX', 'kind': 'status', 'number': 65, 'doc': 'return max. EEPROM write time in a loop() (micro-seconds)'},
+  'MIDI_NRPN_BOOT_TIMELINE': {'name': 'MIDI_NRPN_BOOT_TIMELINE', 'kind': 'nrpn', 'number': 66, 'min': 0, 'max': 15, 'flags': [], 'unit': '', 'doc': 'take the value as a startup stage (enum setup_stage), report the time it was completed'},
+  'NRPN_BOOT_TIME_HIGH': {'name': 'NRPN_BOOT_TIME_HIGH', 'kind': 'report', 'number': 67, 'doc': 'time a startup stage was completed (micro-seconds since reset), upper 14 bits'},
+  'NRPN_BOOT_TIME_LOW': {'name': 'NRPN_BOOT_TIME_LOW', 'kind': 'report', 'number': 68, 'doc': 'time a startup stage was completed (micro-seconds since reset), lower 14 bits'},
+  'NRPN_BOOT_STAGE': {'name': 'NRPN_BOOT_STAGE', 'kind': 'status', 'number': 69, 'doc': 'return the startup stage to be executed next (enum setup_stage, SETUP_DONE when complete)'},
+  'MIDI_NRPN_TIMESTAMPS': {'name': 'MIDI_NRPN_TIMESTAMPS', 'kind': 'nrpn', 'number': 70, 'min': 0, 'max': 1, 'flags': [], 'unit': '', 'doc': 'enable/disable SYSEX_EVENT after key and PTT notes, and periodic SYSEX_CLOCK'},
+  'MIDI_NRPN_CLOCK_INTERVAL': {'name': 'MIDI_NRPN_CLOCK_INTERVAL', 'kind': 'nrpn', 'number': 71, 'min': 100, 'max': 10000, 'flags': [], 'unit': 'ms', 'doc': 'time between periodic SYSEX_CLOCK messages'},
+  'MIDI_NRPN_PLAYOUT_DELAY': {'name': 'MIDI_NRPN_PLAYOUT_DELAY', 'kind': 'nrpn', 'number': 72, 'min': 0, 'max': 1000, 'flags': ['persist'], 'unit': 'ms', 'doc': 'delay of host keying (key notes and SYSEX_KEY) in the playout buffer, 0 = key notes immediately'},
+  'NRPN_PLAYOUT_DEPTH': {'name': 'NRPN_PLAYOUT_DEPTH', 'kind': 'status', 'number': 73, 'doc': 'return number of key transitions waiting in the playout buffer'},
+  'NRPN_PLAYOUT_DEPTH_MAX': {'name': 'NRPN_PLAYOUT_DEPTH_MAX', 'kind': 'status', 'number': 74, 'doc': 'return max. number of key transitions in the playout buffer'},
+  'NRPN_PLAYOUT_LATE': {'name': 'NRPN_PLAYOUT_LATE', 'kind': 'status', 'number': 75, 'doc': 'return number of key transitions that arrived after their playout time'},
+  'NRPN_PLAYOUT_DROPPED': {'name': 'NRPN_PLAYOUT_DROPPED', 'kind': 'status', 'number': 76, 'doc': 'return number of key transitions dropped (playout buffer full)'},
+  'MIDI_NRPN_PTT_DEBOUNCE': {'name': 'MIDI_NRPN_PTT_DEBOUNCE', 'kind': 'nrpn', 'number': 77, 'min': 0, 'max': 100, 'flags': ['persist'], 'unit': 'ms', 'doc': 'PTT-in de-bouncing: edges within this time after an accepted edge are ignored'},
+  'MIDI_NRPN_PTT_LATENCY_BIN': {'name': 'MIDI_NRPN_PTT_LATENCY_BIN', 'kind': 'nrpn', 'number': 78, 'min': 0, 'max': 15, 'flags': [], 'unit': '', 'doc': 'take the value as a bin n of the PTT-out latency histogram, report its count'},
+  'NRPN_PTT_LATENCY_COUNT': {'name': 'NRPN_PTT_LATENCY_COUNT', 'kind': 'report', 'number': 79, 'doc': 'number of PTT-in edges that reached PTT-out within 2^n ... 2^(n+1)-1 CPU cycles'},
+  'NRPN_PTT_BOUNCES': {'name': 'NRPN_PTT_BOUNCES', 'kind': 'status', 'number': 80, 'doc': 'return number of PTT-in edges ignored by de-bouncing'},
+  'NRPN_PTT_MIDI_LATENCY_MAX': {'name': 'NRPN_PTT_MIDI_LATENCY_MAX', 'kind': 'status', 'number': 81, 'doc': 'return max. time from a PTT-in edge to the MIDI PTT note (micro-seconds)'},
+}
@@ -0,0 +1,74 @@
+## Generate cwkeyer_params.py from the firmware parameter list
+##
+## The MIDI controls and NRPNs of the keyer are defined in one place,
+## libraries/teensy/CWKeyerShield/CWKeyerParameters.h. Run this script
+## whenever that file changes:
+##
+##   python3 genparams.py [path/to/CWKeyerParameters.h] [output.py]
+
+import os
+import re
+import sys
+
+HERE   = os.path.dirname(os.path.abspath(__file__))
+HEADER = os.path.join(HERE, "..", "..", "libraries", "teensy", "CWKeyerShield", "CWKeyerParameters.h")
+OUTPUT = os.path.join(HERE, "cwkeyer_params.py")
+
+## One entry per line:  KIND(name, number, ..., "unit", "description")
+ENTRY = re.compile(r'^\s*(CC|NRPN|STATUS|REPORT)\s*\((.*)\)\s*\\?\s*$')
+
+
+def split_args(s):
+  ## Split at commas outside of string literals
+  args, cur, quoted = [], "", False
+  for ch in s:
+    if ch == '"':
+      quoted = not quoted
+    if ch == ',' and not quoted:
+      args.append(cur.strip())
+      cur = ""
+    else:
+      cur += ch
+  args.append(cur.strip())
+  return args
+
+
+def flags(s):
+  return [f.strip()[len("PARAM_"):].lower() for f in s.split('|') if f.strip().startswith("PARAM_")]
+
+
+def parse(path):
+  params = []
+  for line in open(path):
+    m = ENTRY.match(line)
+    if not m: continue
+    kind, args = m.group(1), split_args(m.group(2))
+    p = {'name': args[0], 'kind': kind.lower(), 'number': int(args[1], 0)}
+    if kind in ("CC", "NRPN"):
+      p.update(min=int(args[2], 0), max=int(args[3], 0), flags=flags(args[4]),
+               unit=args[6].strip('"'), doc=args[7].strip('"'))
+    else:
+      p.update(doc=args[-1].strip('"'))
+    params.append(p)
+  return params
+
+
+def generate(params, out):
+  out.write("## Generated by genparams.py from CWKeyerParameters.h, do not edit\n\n")
+  for p in params:
+    out.write("%-36s = %5d  ## %s %s\n" % (p['name'], p['number'], p['kind'], p['doc']))
+  out.write("\nPARAMS = {\n")
+  for p in params:
+    out.write("  %r: %r,\n" % (p['name'], p))
+  out.write("}\n")
+
+
+if __name__ == "__main__":
+  header = sys.argv[1] if len(sys.argv) > 1 else HEADER
+  output = sys.argv[2] if len(sys.argv) > 2 else OUTPUT
+  params = parse(header)
+  if not params:
+    sys.exit("no parameters found in " + header)
+  with open(output, "w") as out:
+    generate(params, out)
+  print("%d parameters written to %s" % (len(params), output))
@@ -0,0 +1,85 @@
+//
+// Time base of the host benchmarks: the time stamp counter on x86
+// (host CPU cycles), steady_clock nano-seconds elsewhere. The figures
+// compare variants on the same machine, they are not Teensy cycles.
+//
+#ifndef bench_h_
+#define bench_h_
+
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+inline uint64_t bench_ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+inline const char *bench_unit(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return "tsc_cycles";
+#else
+    return "ns";
+#endif
+}
+
+//
+// Median of a set of measurements, robust against interrupts and
+// frequency changes of the host
+//
+inline double bench_median(std::vector<uint64_t> v)
+{
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    return v[v.size() / 2];
+}
+
+//
+// Mean of the fastest 95% of a set of measurements, for workloads that
+// differ from block to block (the median would pick one kind of block)
+//
+inline double bench_mean(std::vector<uint64_t> v)
+{
+    double sum = 0;
+    size_t n = v.size() - v.size() / 20;
+
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    for (size_t i = 0; i < n; i++) sum += v[i];
+    return sum / n;
+}
+
+//
+// Time of one run of a fixed integer workload (a 128-sample
+// multiply-accumulate loop). It is the unit of figures compared across
+// machines: "cost" = ticks / calibration ticks. Run it interleaved with
+// the code measured, so that it follows changes of the host clock rate.
+//
+inline uint64_t bench_calibration(void)
+{
+    static uint32_t seed = 1;
+    volatile int32_t sink;
+    uint32_t x = seed++;
+    int64_t  acc = 0;
+    uint64_t t0 = bench_ticks();
+
+    for (int i = 0; i < 128; i++) {
+        x = x * 1664525 + 1013904223;
+        acc += (int64_t) (int32_t) x * (int16_t) (x >> 16);
+    }
+    sink = (int32_t) (acc >> 32);
+    (void) sink;
+    return bench_ticks() - t0;
+}
+
+#endif
@@ -0,0 +1,241 @@
+//
+// Cost per block of the side tone rendering and mixing in
+// TeensyAudioTone::updateAt(), compared with per-sample loops in the style
+// of the code the kernels replaced: the envelope state is tested for every
+// sample, and there is one mixing loop per channel and input case.
+//
+// The reference does the same work as updateAt() with constant gains
+// (oscillator, keying envelope, gains, 16-bit saturation, block handling),
+// and its output is checked against updateAt() where the two use the same
+// ramp (steady key-down and idle). So the figures show what the kernel
+// structure saves, not what later features cost.
+//
+// Prints CSV: reference and kernel cost per block (best median of
+// several runs, units of bench.h) and the saving. The costs are only
+// reported, as they depend on the host; the run fails only if the
+// outputs differ.
+//
+#include <stdio.h>
+#include "bench.h"
+#include "tone_rig.h"
+#include "utility/dspinst.h"
+
+extern "C" const int16_t AudioWaveformSine[257];
+
+namespace {
+
+const int      NBLOCKS = 4000;
+const int      REPEAT  = 5;                 // runs per case, alternating, best median counts
+const int      WARMUP  = 8;                 // blocks until all gain ramps are done
+const int      WINDOW_LENGTH = 144;         // 3 msec at 48 kHz, as the kernels use
+const float    FREQUENCY = 800.0F;
+const float    AMPLITUDE = 0.4F;
+int32_t        window[WINDOW_LENGTH];
+
+//
+// Per-sample version of updateAt() for unity master volume, centred
+// pan and balance, and no ducking
+//
+class ReferenceTone : public AudioStream
+{
+public:
+    ReferenceTone() : AudioStream(2, inputQueueArray) {}
+    virtual void update(void) {}
+
+    void process(uint8_t nevents, const uint8_t *event_pos, const uint8_t *event_state) {
+        audio_block_t *block_in[2], *block_side[2];
+        int16_t side[AUDIO_BLOCK_SAMPLES];
+        int16_t i, e, ch;
+        int32_t t, val1, val2;
+        uint32_t index, scale;
+        const uint32_t g = pack_16b_16b(side_gain >> 16, rx_gain >> 16);
+
+        block_in[0] = receiveWritable(0);
+        block_in[1] = receiveWritable(1);
+
+        if (tone || windowindex || nevents) {
+            i = 0;
+            for (e = 0; e <= nevents; e++) {
+                int16_t end = (e < nevents) ? event_pos[e] : AUDIO_BLOCK_SAMPLES;
+                for (; i < end; i++) {
+                    index = phase >> 24;
+                    val1  = AudioWaveformSine[index];
+                    val2  = AudioWaveformSine[index+1];
+                    scale = (phase >> 8) & 0xFFFF;
+                    val2 *= scale;
+                    val1 *= 0x10000 - scale;
+                    t = multiply_32x32_rshift32(val1 + val2, gain >> 14);
+                    phase += inc;
+                    if (tone) {
+                        if (windowindex < WINDOW_LENGTH) {
+                            t = multiply_32x32_rshift32(t << 1, window[windowindex++]);
+                        }
+                    } else if (windowindex) {
+                        t = multiply_32x32_rshift32(t << 1, window[--windowindex]);
+                    } else {
+                        t = 0;
+                    }
+                    side[i] = t;
+                }
+                if (e < nevents) tone = event_state[e];
+            }
+            for (ch = 0; ch < 2; ch++) {
+                if (block_in[ch]) {
+                    int16_t *d = block_in[ch]->data;
+                    for (i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+                        d[i] = signed_saturate_rshift(multiply_16tx16t_add_16bx16b(pack_16b_16b(side[i], d[i]), g), 16, 15);
+                    }
+                    transmit(block_in[ch], ch);
+                } else if ((block_side[ch] = allocate()) != NULL) {
+                    int16_t *d = block_side[ch]->data;
+                    for (i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+                        d[i] = signed_saturate_rshift(multiply_16tx16t_add_16bx16b(pack_16b_16b(side[i], 0), g), 16, 15);
+                    }
+                    transmit(block_side[ch], ch);
+                    release(block_side[ch]);
+                }
+            }
+        } else {
+            for (ch = 0; ch < 2; ch++) {
+                if (!block_in[ch]) continue;
+                int16_t *d = block_in[ch]->data;
+                for (i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+                    d[i] = signed_saturate_rshift(multiply_16tx16t_add_16bx16b(pack_16b_16b(0, d[i]), g), 16, 15);
+                }
+                transmit(block_in[ch], ch);
+            }
+        }
+        if (block_in[0]) release(block_in[0]);
+        if (block_in[1]) release(block_in[1]);
+    }
+
+    uint32_t phase = 0;
+    uint32_t inc   = FREQUENCY * (4294967296.0F / AUDIO_SAMPLE_RATE_EXACT);
+    int32_t  gain  = AMPLITUDE * 1073741824.0F;
+    uint8_t  tone  = 0;
+    uint16_t windowindex = 0;
+    int32_t  side_gain = 1 << 30;      // per channel, Q30
+    int32_t  rx_gain   = 1 << 30;
+
+private:
+    audio_block_t *inputQueueArray[2];
+};
+
+enum keying { KEY_UP, KEY_DOWN, KEY_RAMPS };
+
+struct bench_case {
+    const char *name;
+    keying      key;
+    bool        rx;
+};
+
+const bench_case cases[] = {
+    { "steady_rx",   KEY_DOWN,  true  },
+    { "steady_norx", KEY_DOWN,  false },
+    { "ramps_rx",    KEY_RAMPS, true  },
+    { "ramps_norx",  KEY_RAMPS, false },
+    { "idle_rx",     KEY_UP,    true  },
+};
+
+struct result {
+    double ticks;
+    std::vector<int16_t> out[2];    // output after the warm-up
+};
+
+//
+// Key down at the start of each block and key up in the middle
+// (ramps), key down at the start of the first block (steady), or no
+// keying at all (idle)
+//
+result reference_run(const bench_case &c)
+{
+    ReferenceTone ref;
+    AudioCapture  capture;
+    AudioFeed     feed;
+    AudioConnection patchl(ref, 0, capture, 0), patchr(ref, 1, capture, 1);
+    AudioConnection feedl(feed, 0, ref, 0), feedr(feed, 0, ref, 1);
+    std::vector<uint64_t> ticks;
+    std::vector<int16_t> discard[2];
+    const uint8_t pos[2] = {0, AUDIO_BLOCK_SAMPLES / 2}, state[2] = {1, 0};
+    result r;
+
+    for (int b = 0; b < NBLOCKS; b++) {
+        uint8_t n = (c.key == KEY_RAMPS) ? 2 : (c.key == KEY_DOWN && b == 0) ? 1 : 0;
+        if (c.rx) feed.push(0x1234);
+        uint64_t t0 = bench_ticks();
+        ref.process(n, pos, state);
+        uint64_t t1 = bench_ticks();
+        for (int ch = 0; ch < 2; ch++) capture.take(ch, b < WARMUP ? discard[ch] : r.out[ch]);
+        if (b >= WARMUP) ticks.push_back(t1 - t0);
+    }
+    r.ticks = bench_median(ticks);
+    return r;
+}
+
+result kernel_run(const bench_case &c)
+{
+    ToneRig rig;
+    std::vector<uint64_t> ticks;
+    result r;
+
+    rig.tone.setWindow(WINDOW_RAISED_COSINE, 3);
+    rig.tone.frequency(FREQUENCY);
+    rig.tone.amplitude(AMPLITUDE);
+    rig.rx = c.rx ? 0x1234 : 0;
+    rig.begin();
+    for (int b = 0; b < NBLOCKS; b++) {
+        uint32_t start = ToneRig::now(rig.next() - 1);
+        if (c.key == KEY_RAMPS) {
+            rig.tone.keyEvent(1, start);
+            rig.tone.keyEvent(0, start + 1333);     // sample 64
+        } else if (c.key == KEY_DOWN && b == 0) {
+            rig.tone.keyEvent(1, start);
+        }
+        rig.block();
+        if (b >= WARMUP) ticks.push_back(rig.ticks);
+    }
+    for (int ch = 0; ch < 2; ch++) {
+        r.out[ch].assign(rig.out[ch].begin() + WARMUP * AUDIO_BLOCK_SAMPLES, rig.out[ch].end());
+    }
+    r.ticks = bench_median(ticks);
+    return r;
+}
+
+} // namespace
+
+int main(void)
+{
+    double total_ref = 0, total_new = 0;
+    int failures = 0;
+
+    //
+    // A raised cosine ramp of the length the kernels use. Its values only
+    // matter for the output check, which skips the ramps.
+    //
+    for (int i = 0; i < WINDOW_LENGTH; i++) {
+        window[i] = (int32_t) (2147483647.0 * 0.5 * (1.0 - cos(PI * (i + 1) / WINDOW_LENGTH)));
+    }
+    AudioMemory(16);
+    printf("case,reference_%s_per_block,kernel_%s_per_block,saving_per_block,saving_percent\n",
+           bench_unit(), bench_unit());
+    for (const bench_case &c : cases) {
+        result ref, ker;
+        for (int k = 0; k < REPEAT; k++) {
+            result r = reference_run(c);
+            result n = kernel_run(c);
+            if (k == 0 || r.ticks < ref.ticks) ref = r;
+            if (k == 0 || n.ticks < ker.ticks) ker = n;
+        }
+        if (c.key != KEY_RAMPS && (ref.out[0] != ker.out[0] || ref.out[1] != ker.out[1])) {
+            fprintf(stderr, "%s: reference and kernel output differ\n", c.name);
+            failures++;
+        }
+        total_ref += ref.ticks;
+        total_new += ker.ticks;
+        printf("%s,%.0f,%.0f,%.0f,%.1f\n", c.name, ref.ticks, ker.ticks,
+               ref.ticks - ker.ticks, 100.0 * (ref.ticks - ker.ticks) / ref.ticks);
+    }
+    printf("total,%.0f,%.0f,%.0f,%.1f\n", total_ref, total_new, total_ref - total_new,
+           100.0 * (total_ref - total_new) / total_ref);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,49 @@
+//
+// Rendering speed of the complete audio path: side tone keyed at 30 wpm,
+// mixed with an RX tone, decoder and VOX running. Prints samples/s and
+// the real-time factor; fails if rendering is slower than real time.
+//
+// usage: bench_render [seconds of audio, default 60]
+//
+#include <chrono>
+#include <iostream>
+#include "sim.h"
+#include "morse.h"
+
+int main(int argc, char **argv)
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 60;
+    ShieldSim sim;
+    double phase = 0;
+
+    sim.begin();
+    sim.usb_in = [&phase](uint8_t channel, int16_t *data) {
+        double p = phase;
+        for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+            data[i] = (int16_t) lrint(8000 * sin(p));
+            p += 2 * M_PI * 700 / AUDIO_SAMPLE_RATE_EXACT;
+        }
+        if (channel == 1) phase = fmod(p, 2 * M_PI);
+        return true;
+    };
+
+    uint64_t t = host_time_ns, end = t + (uint64_t) (seconds * 1e9);
+    while (t < end) {
+        std::vector<morse_edge> edges;
+        t = morse_edges("CQ CQ DE DL1YCF K ", 30, t, edges);
+        for (const morse_edge &e : edges) {
+            int state = e.state;
+            sim.at(e.t, [&sim, state]() { sim.shield.key(state); });
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    sim.run_until(end);
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double rate = sim.out[0].size() / secs;
+
+    std::cout << "samples " << sim.out[0].size() << " time_s " << secs
+              << " samples_per_s " << rate
+              << " realtime_x " << rate / AUDIO_SAMPLE_RATE_EXACT << std::endl;
+    return rate >= AUDIO_SAMPLE_RATE_EXACT ? 0 : 1;
+}
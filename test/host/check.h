@@ -0,0 +1,31 @@
+//
+// Minimal checks for the host tests: CHECK() reports a failed condition
+// and the test exits with a non-zero status through check_result().
+//
+#ifndef check_h_
+#define check_h_
+
+#include <stdio.h>
+
+static int check_failures = 0;
+
+#define CHECK(cond, ...) do {                                           \
+        if (!(cond)) {                                                  \
+            check_failures++;                                           \
+            fprintf(stderr, "%s:%d: %s: ", __FILE__, __LINE__, #cond);  \
+            fprintf(stderr, __VA_ARGS__);                               \
+            fprintf(stderr, "\n");                                      \
+        }                                                               \
+    } while (0)
+
+inline int check_result(const char *name)
+{
+    if (check_failures) {
+        fprintf(stderr, "%s: %d check(s) failed\n", name, check_failures);
+        return 1;
+    }
+    printf("%s: passed\n", name);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,250 @@
+//
+// CW decoder benchmark: synthetic CW with white Gaussian noise is fed to
+// CWDecoder block by block, for several speeds and signal-to-noise
+// ratios. Per case it reports
+//
+//   cer          character error rate: edit distance between the decoded
+//                and the sent text (spaces included), divided by the
+//                length of the sent text
+//   wpm_est      speed estimate of the decoder at the end
+//   ticks        CPU time per update() (mean, units of bench.h)
+//   cost         ticks per update() in units of bench_calibration(),
+//                which runs after each block
+//
+// The SNR is the ratio of the tone power (key down) to the noise power
+// in the full audio band (0 ... 24 kHz). The tone has 5 msec raised
+// cosine edges, the noise is the same for every run (fixed seed).
+//
+// Usage: decoder_bench [baseline.csv [result.csv]]
+//
+// The results are printed (and written to result.csv) as CSV. With a
+// baseline, a case whose error rate exceeds the baseline by more than
+// TOL_CER fails the run. The cost is reported next to the baseline cost,
+// but not checked: it depends on the host and its load.
+//
+#include <math.h>
+#include <stdio.h>
+#include <map>
+#include <random>
+#include <string>
+#include "bench.h"
+#include "host.h"
+#include "morse.h"
+#include "CWDecoder.h"
+
+namespace {
+
+const char    *TEXT         = "CQ CQ DE DL1YCF DL1YCF K  TNX FER CALL UR RST 599 5NN  "
+                              "NAME IS CHRIS QTH BONN  HW? = 73 TU";
+const float    CARRIER      = 800.0F;   // Hz, the decoder default
+const double   AMPLITUDE    = 8000.0;
+const double   RAMP_MS      = 5.0;
+const uint64_t LEAD_NS      = 500000000ULL;     // noise only, before and ...
+const uint64_t TAIL_NS      = 1500000000ULL;    // ... after the text
+const int      SPEEDS[]     = { 5, 12, 20, 30, 40 };
+const int      SNRS[]       = { 30, 10, 3, 0 };
+
+//
+// Tolerances against the baseline
+//
+const double   TOL_CER      = 0.02;
+
+struct row {
+    int         wpm, snr;
+    double      cer;
+    int         wpm_est;
+    double      ticks, cost;
+    std::string text;
+};
+
+//
+// The audio source of the decoder
+//
+class AudioFeed : public AudioStream
+{
+public:
+    AudioFeed() : AudioStream(0, NULL) {}
+    virtual void update(void) {}
+
+    void push(const int16_t *data) {
+        audio_block_t *block = allocate();
+        if (!block) return;
+        memcpy(block->data, data, sizeof(block->data));
+        transmit(block, 0);
+        release(block);
+    }
+};
+
+//
+// Gaussian noise from a fixed seed (Box-Muller), the same on every host
+//
+class Noise
+{
+public:
+    Noise(uint32_t seed) : rng(seed) {}
+    double next(void) {
+        double u1 = (rng() + 1.0) / 4294967297.0, u2 = rng() / 4294967296.0;
+        return sqrt(-2.0 * log(u1)) * cos(2 * M_PI * u2);
+    }
+private:
+    std::mt19937 rng;
+};
+
+//
+// Text with runs of spaces collapsed and leading/trailing spaces removed
+//
+std::string normalize(const std::string &s)
+{
+    std::string out;
+
+    for (char c : s) {
+        if (c == ' ' && (out.empty() || out.back() == ' ')) continue;
+        out += c;
+    }
+    while (!out.empty() && out.back() == ' ') out.pop_back();
+    return out;
+}
+
+size_t edit_distance(const std::string &a, const std::string &b)
+{
+    std::vector<size_t> d(b.size() + 1), prev(b.size() + 1);
+
+    for (size_t j = 0; j <= b.size(); j++) prev[j] = j;
+    for (size_t i = 1; i <= a.size(); i++) {
+        d[0] = i;
+        for (size_t j = 1; j <= b.size(); j++) {
+            d[j] = std::min(std::min(prev[j] + 1, d[j - 1] + 1),
+                            prev[j - 1] + (a[i - 1] != b[j - 1]));
+        }
+        std::swap(d, prev);
+    }
+    return prev[b.size()];
+}
+
+row run(int wpm, int snr)
+{
+    CWDecoder dec;
+    AudioFeed feed;
+    AudioConnection patch(feed, 0, dec, 0);
+    std::vector<morse_edge> edges;
+    std::vector<uint64_t> ticks, calib;
+    Noise noise(1234 + wpm * 100 + snr);
+    const double sample_ns = 1e9 / AUDIO_SAMPLE_RATE_EXACT;
+    const double ramp = 1.0 / (RAMP_MS * 1e-3 * AUDIO_SAMPLE_RATE_EXACT);
+    double sigma = AMPLITUDE / sqrt(2.0 * pow(10.0, snr / 10.0));
+    double env = 0, phase = 0;
+    uint64_t end = morse_edges(TEXT, wpm, LEAD_NS, edges) + TAIL_NS;
+    size_t e = 0;
+    int state = 0, c;
+    int16_t data[AUDIO_BLOCK_SAMPLES];
+    row r;
+
+    dec.frequency(CARRIER);
+    dec.enable(1);
+    for (uint64_t n = 0; n * sample_ns < end; ) {
+        for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++, n++) {
+            while (e < edges.size() && edges[e].t <= n * sample_ns) state = edges[e++].state;
+            env = state ? std::min(1.0, env + ramp) : std::max(0.0, env - ramp);
+            double v = AMPLITUDE * 0.5 * (1 - cos(M_PI * env)) * sin(phase) + sigma * noise.next();
+            phase += 2 * M_PI * CARRIER / AUDIO_SAMPLE_RATE_EXACT;
+            data[i] = (int16_t) std::max(-32768.0, std::min(32767.0, round(v)));
+        }
+        feed.push(data);
+        uint64_t t0 = bench_ticks();
+        dec.update();
+        ticks.push_back(bench_ticks() - t0);
+        calib.push_back(bench_calibration());
+        while ((c = dec.read()) >= 0) r.text += (char) c;
+    }
+
+    r.wpm     = wpm;
+    r.snr     = snr;
+    r.text    = normalize(r.text);
+    r.cer     = (double) edit_distance(r.text, normalize(TEXT)) / normalize(TEXT).size();
+    r.wpm_est = dec.wpm();
+    r.ticks   = bench_mean(ticks);
+    r.cost    = r.ticks / bench_mean(calib);
+    return r;
+}
+
+const char *HEADER = "wpm,snr_db,cer,wpm_est,ticks,cost";
+
+void print_row(FILE *f, const row &r)
+{
+    fprintf(f, "%d,%d,%.4f,%d,%.0f,%.3f\n", r.wpm, r.snr, r.cer, r.wpm_est, r.ticks, r.cost);
+}
+
+std::map<std::string, row> read_baseline(const char *path)
+{
+    std::map<std::string, row> rows;
+    char line[256];
+    FILE *f = fopen(path, "r");
+
+    if (!f) return rows;
+    while (fgets(line, sizeof(line), f)) {
+        row r;
+        if (sscanf(line, "%d,%d,%lf,%d,%lf,%lf", &r.wpm, &r.snr, &r.cer,
+                   &r.wpm_est, &r.ticks, &r.cost) != 6) {
+            continue;   // header
+        }
+        rows[std::to_string(r.wpm) + "/" + std::to_string(r.snr)] = r;
+    }
+    fclose(f);
+    return rows;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    std::map<std::string, row> baseline;
+    FILE *result = NULL;
+    double cost = 0, baseline_cost = 0;
+    int failures = 0;
+
+    if (argc > 1) {
+        baseline = read_baseline(argv[1]);
+        if (baseline.empty()) {
+            fprintf(stderr, "decoder_bench: cannot read baseline %s\n", argv[1]);
+            return 1;
+        }
+    }
+    if (argc > 2 && !(result = fopen(argv[2], "w"))) {
+        fprintf(stderr, "decoder_bench: cannot write %s\n", argv[2]);
+        return 1;
+    }
+
+    AudioMemory(8);
+    printf("%s\n", HEADER);
+    if (result) fprintf(result, "%s\n", HEADER);
+    for (int snr : SNRS) {
+        for (int wpm : SPEEDS) {
+            row r = run(wpm, snr);
+            cost += r.cost;
+            print_row(stdout, r);
+            if (result) print_row(result, r);
+            if (r.cer > 0) fprintf(stderr, "%d wpm, %d dB: \"%s\"\n", wpm, snr, r.text.c_str());
+
+            if (!baseline.empty()) {
+                auto b = baseline.find(std::to_string(wpm) + "/" + std::to_string(snr));
+                if (b == baseline.end()) {
+                    fprintf(stderr, "%d wpm, %d dB: not in the baseline\n", wpm, snr);
+                    failures++;
+                } else {
+                    baseline_cost += b->second.cost;
+                    if (r.cer > b->second.cer + TOL_CER) {
+                        fprintf(stderr, "%d wpm, %d dB: error rate %.4f, baseline %.4f\n",
+                                wpm, snr, r.cer, b->second.cer);
+                        failures++;
+                    }
+                }
+            }
+        }
+    }
+    if (result) fclose(result);
+    fprintf(stderr, "decoder_bench: total cost %.1f", cost);
+    if (!baseline.empty()) fprintf(stderr, ", baseline %.1f", baseline_cost);
+    fprintf(stderr, "\n");
+    if (failures) fprintf(stderr, "decoder_bench: %d regression(s)\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,201 @@
+//
+// Cost of the MIDI control dispatch per message. A batch of messages is
+// queued, and one loop() pass reads and executes them all (simulated time
+// stands still during a pass, so the time budget of midi_cc_run() never
+// ends it early). Per message the cost is
+//
+//   (loop() with the batch - loop() without messages) / BATCH
+//
+// both measured alternately and in units of bench_calibration(), which
+// runs after each pass. The setters are part of the cost, as they are of
+// each message on the target. cc_other_channel is read and queued, but
+// not dispatched: the difference to it is the cost of the table lookup,
+// the clamping and the setter.
+//
+// Per case, the first run also counts
+//
+//   responses    MIDI messages sent by the keyer
+//   unread       messages still queued after the pass with the batch
+//
+// Usage: dispatch_bench [baseline.csv [result.csv]]
+//
+// The results are printed (and written to result.csv) as CSV. With a
+// baseline, a case whose counts differ from the baseline fails the run.
+// The cost is reported next to the baseline cost, but not checked: it
+// depends on the host and its load.
+//
+#include <stdio.h>
+#include <map>
+#include <string>
+#include "bench.h"
+#include "sim.h"
+
+namespace {
+
+const int      CHANNEL      = 10;       // the default control channel
+const int      BATCH        = 16;       // messages per loop(), 64 CCs for NRPNs
+const int      NBATCH       = 500;
+const int      REPEAT       = 3;        // runs per case, the cheapest counts
+
+ShieldSim sim;
+
+//
+// SysEx message of the keyer, with checksum
+//
+void send_sysex(uint8_t command, std::vector<uint8_t> payload)
+{
+    std::vector<uint8_t> m = { 0xF0, 0x7D, 'C', 'W', CWKEYER_SYSEX_VERSION, command };
+    uint8_t sum = CWKEYER_SYSEX_VERSION + command;
+
+    for (uint8_t b : payload) {
+        m.push_back(b);
+        sum += b;
+    }
+    m.push_back(-sum & 0x7f);
+    m.push_back(0xF7);
+    host_send_sysex(m);
+}
+
+struct bench_case {
+    const char *name;
+    void      (*send)(int i);       // queue message number i
+};
+
+const bench_case cases[] = {
+    { "cc_master_volume",      [](int i) { host_send_cc(CHANNEL, MIDI_MASTER_VOLUME, i & 127); } },
+    { "cc_sidetone_frequency", [](int i) { host_send_cc(CHANNEL, MIDI_SIDETONE_FREQUENCY, 40 + i % 80); } },
+    { "cc_switch",             [](int i) { host_send_cc(CHANNEL, MIDI_KEYER_AUTOPTT, (i & 1) ? 127 : 0); } },
+    { "cc_unassigned",         [](int i) { host_send_cc(CHANNEL, 20, i & 127); } },
+    { "cc_other_channel",      [](int i) { host_send_cc(CHANNEL + 1, MIDI_MASTER_VOLUME, i & 127); } },
+    { "nrpn_setting",          [](int i) { host_send_nrpn(CHANNEL, MIDI_NRPN_DUCK_DEPTH, i % 100); } },
+    { "nrpn_status",           [](int i) { host_send_nrpn(CHANNEL, NRPN_MIDI_CC_CYCLES, 0); } },
+    { "sysex_clock_request",   [](int i) { send_sysex(SYSEX_CLOCK_REQUEST, { (uint8_t) ((i >> 7) & 127), (uint8_t) (i & 127) }); } },
+    { "sysex_dump_request",    [](int i) { send_sysex(SYSEX_DUMP_REQUEST, {}); } },
+};
+
+struct row {
+    std::string name;
+    double      ticks, cost;
+    long        responses, unread;
+};
+
+//
+// One loop() pass, the calibration after it
+//
+void pass(std::vector<uint64_t> &ticks, std::vector<uint64_t> &calib)
+{
+    host_advance_ns(ShieldSim::LOOP_NS);
+    uint64_t t0 = bench_ticks();
+    sim.shield.loop();
+    ticks.push_back(bench_ticks() - t0);
+    calib.push_back(bench_calibration());
+}
+
+row run(const bench_case &c)
+{
+    std::vector<uint64_t> empty, loaded, calib;
+    row r;
+
+    r.responses = r.unread = 0;
+    for (int b = 0; b < NBATCH; b++) {
+        pass(empty, calib);
+        for (int i = 0; i < BATCH; i++) c.send(b * BATCH + i);
+        pass(loaded, calib);
+        r.unread    += host_midi_in.size();
+        r.responses += host_midi_out.size();
+        host_midi_out.clear();
+    }
+    r.name  = c.name;
+    r.ticks = (bench_mean(loaded) - bench_mean(empty)) / BATCH;
+    if (r.ticks < 0) r.ticks = 0;
+    r.cost  = r.ticks / bench_mean(calib);
+    return r;
+}
+
+const char *HEADER = "case,ticks_per_message,cost_per_message,responses,unread";
+
+void print_row(FILE *f, const row &r)
+{
+    fprintf(f, "%s,%.0f,%.3f,%ld,%ld\n", r.name.c_str(), r.ticks, r.cost, r.responses, r.unread);
+}
+
+std::map<std::string, row> read_baseline(const char *path)
+{
+    std::map<std::string, row> rows;
+    char line[256], name[64];
+    FILE *f = fopen(path, "r");
+
+    if (!f) return rows;
+    while (fgets(line, sizeof(line), f)) {
+        row r;
+        if (sscanf(line, "%63[^,],%lf,%lf,%ld,%ld", name, &r.ticks, &r.cost, &r.responses, &r.unread) != 5) {
+            continue;   // header
+        }
+        r.name = name;
+        rows[r.name] = r;
+    }
+    fclose(f);
+    return rows;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    std::map<std::string, row> baseline;
+    FILE *result = NULL;
+    double cost = 0, baseline_cost = 0;
+    int failures = 0;
+
+    if (argc > 1) {
+        baseline = read_baseline(argv[1]);
+        if (baseline.empty()) {
+            fprintf(stderr, "dispatch_bench: cannot read baseline %s\n", argv[1]);
+            return 1;
+        }
+    }
+    if (argc > 2 && !(result = fopen(argv[2], "w"))) {
+        fprintf(stderr, "dispatch_bench: cannot write %s\n", argv[2]);
+        return 1;
+    }
+
+    sim.begin();
+    printf("%s\n", HEADER);
+    if (result) fprintf(result, "%s\n", HEADER);
+    for (const bench_case &c : cases) {
+        row r;
+        for (int k = 0; k < REPEAT; k++) {
+            row n = run(c);
+            if (k == 0) {
+                r = n;
+            } else if (n.cost < r.cost) {
+                r.ticks = n.ticks;          // the counts of the first run
+                r.cost  = n.cost;
+            }
+        }
+        cost += r.cost;
+        print_row(stdout, r);
+        if (result) print_row(result, r);
+
+        if (!baseline.empty()) {
+            auto b = baseline.find(r.name);
+            if (b == baseline.end()) {
+                fprintf(stderr, "%s: not in the baseline\n", c.name);
+                failures++;
+            } else {
+                baseline_cost += b->second.cost;
+                if (r.responses != b->second.responses || r.unread != b->second.unread) {
+                    fprintf(stderr, "%s: %ld responses, %ld unread, baseline %ld, %ld\n", c.name,
+                            r.responses, r.unread, b->second.responses, b->second.unread);
+                    failures++;
+                }
+            }
+        }
+    }
+    if (result) fclose(result);
+    fprintf(stderr, "dispatch_bench: total cost %.1f", cost);
+    if (!baseline.empty()) fprintf(stderr, ", baseline %.1f", baseline_cost);
+    fprintf(stderr, "\n");
+    if (failures) fprintf(stderr, "dispatch_bench: %d regression(s)\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,88 @@
+//
+// Host harness for the CWKeyerShield library: simulated clock, MIDI,
+// I/O lines, EEPROM and audio ports, see stubs/ for the stand-ins of the
+// Teensy core and audio library they drive.
+//
+#ifndef host_h_
+#define host_h_
+
+#include <stdint.h>
+#include <deque>
+#include <vector>
+#include "Arduino.h"
+#include "Audio.h"
+#include "EEPROM.h"
+
+//
+// Simulated time. micros(), millis() and ARM_DWT_CYCCNT are derived from
+// it, they only change when the harness advances the clock. Advancing it
+// runs the IntervalTimer functions that are due, at their time.
+//
+extern uint64_t host_time_ns;
+void host_advance_ns(uint64_t ns);
+
+//
+// Time (ns) at which audio block number n (n = 0, 1, ...) ends
+//
+inline uint64_t host_block_end_ns(uint64_t n)
+{
+    return (n + 1) * AUDIO_BLOCK_SAMPLES * 1000000000ULL / (uint64_t) AUDIO_SAMPLE_RATE_EXACT;
+}
+
+//
+// MIDI messages. Outgoing NRPNs arrive as the four control changes
+// usbMIDI sends for them.
+//
+struct host_midi_message {
+    uint8_t type;                   // usbMIDI.NoteOn, ControlChange, ...
+    uint8_t channel;
+    uint8_t data1;
+    uint8_t data2;
+    std::vector<uint8_t> sysex;     // complete message, F0 ... F7
+};
+extern std::deque<host_midi_message>  host_midi_in;
+extern std::vector<host_midi_message> host_midi_out;
+
+void host_send_cc(uint8_t channel, uint8_t cc, uint8_t value);
+void host_send_nrpn(uint8_t channel, uint16_t nrpn, uint16_t value);
+void host_send_note(uint8_t channel, uint8_t note, uint8_t velocity);
+void host_send_sysex(const std::vector<uint8_t> &message);
+
+//
+// Digital and analog input/output lines. The pot scan of TeensyPots
+// samples host_analog[] (12 bits) every CWKEYER_POTS_SCAN_US.
+//
+extern int host_pins[64];
+extern int host_analog[64];
+
+//
+// Interrupt handler attached to a pin (NULL if there is none)
+//
+extern void (*host_pin_isr[64])(void);
+
+//
+// Drive an input line, the attached interrupt handler (if any) is
+// called if the level changes
+//
+void host_drive_pin(int pin, int value);
+
+//
+// EEPROM contents and number of bytes written
+//
+extern uint8_t  host_eeprom[E2END + 1];
+extern unsigned host_eeprom_writes;
+
+//
+// Audio ports. A source fills one block of a channel (0 = left, 1 = right)
+// and returns false if there is no audio; a sink gets each block an
+// output receives (NULL if it received none). Both may be left NULL.
+//
+extern bool (*host_audio_source)(uint8_t port, uint8_t channel, int16_t *data);
+extern void (*host_audio_sink)(uint8_t port, uint8_t channel, const int16_t *data);
+
+//
+// Functions the keyer sketch has to provide, the values last set
+//
+extern int host_keyer_speed;
+
+#endif
@@ -0,0 +1,344 @@
+//
+// Keying spectrum and key-click regression suite. For each keying ramp
+// (shape and rise time, see setWindow()) and speed from 5 to 60 WPM, a
+// stream of dots is rendered through TeensyAudioTone::updateAt() and its
+// spectrum is measured (Welch method, Hann window):
+//
+//   bw_hz        occupied bandwidth, 99% of the power
+//   click_dbc    highest level at 500 Hz or more from the carrier, in dB
+//                relative to the carrier bin (key clicks)
+//   ticks        CPU time per block (mean, units of bench.h)
+//   cost         ticks per block in units of bench_calibration(), which
+//                runs after each block
+//
+// Per ramp, the keying envelope is measured with a constant carrier:
+//
+//   rise         10% to 90% rise time (samples)
+//   mirror_err   key-up ramp vs. time-reversed key-down ramp, max. error
+//   point_err    point symmetry of the key-down ramp, max. error
+//                (both relative to the steady level)
+//
+// Usage: keying_spectrum [baseline.csv [result.csv]]
+//
+// The results are printed (and written to result.csv) as CSV. With a
+// baseline, a row whose bandwidth, click level or symmetry is worse than
+// the baseline by more than the tolerances below fails the run. The cost
+// is reported next to the baseline cost, but not checked: it depends on
+// the host and its load.
+//
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <complex>
+#include <map>
+#include <string>
+#include "bench.h"
+#include "tone_rig.h"
+
+namespace {
+
+const float    CARRIER      = 800.0F;   // Hz
+const int      NFFT         = 8192;     // 5.86 Hz per bin
+const int      NSEGMENTS    = 15;       // 50% overlap, 64k samples analysed
+const int      NSAMPLES     = (NSEGMENTS + 1) * NFFT / 2;
+const double   CLICK_OFFSET = 500.0;    // Hz
+const int      SPEEDS[]     = { 5, 10, 20, 30, 45, 60 };
+const int      REPEAT       = 3;        // renderings per row, the cheapest counts
+const int      MIN_RISE_MS  = 2;        // rise times 2 ... 6 msec, see WINDOW_NRISE
+
+//
+// Tolerances against the baseline
+//
+const double   TOL_BW_REL   = 0.05;     // +5% bandwidth ...
+const double   TOL_BW_HZ    = 6.0;      // ... plus one bin
+const double   TOL_CLICK_DB = 1.0;
+const double   TOL_SYMMETRY = 1e-4;
+
+struct row {
+    std::string window;
+    int         wpm;
+    double      bw_hz, click_dbc;
+    int         rise;
+    double      mirror_err, point_err;
+    double      ticks, cost;
+};
+
+const char *shape_name(int shape)
+{
+    switch (shape) {
+        case WINDOW_RAISED_COSINE:            return "rc";
+        case WINDOW_INTEGRATED_RAISED_COSINE: return "irc";
+        default:                              return "bh";
+    }
+}
+
+//
+// In-place radix-2 FFT
+//
+void fft(std::vector<std::complex<double> > &x)
+{
+    size_t n = x.size();
+
+    for (size_t i = 1, j = 0; i < n; i++) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) std::swap(x[i], x[j]);
+    }
+    for (size_t len = 2; len <= n; len <<= 1) {
+        std::complex<double> w(cos(-2 * M_PI / len), sin(-2 * M_PI / len));
+        for (size_t i = 0; i < n; i += len) {
+            std::complex<double> wk(1, 0);
+            for (size_t k = 0; k < len / 2; k++) {
+                std::complex<double> u = x[i + k], v = x[i + k + len / 2] * wk;
+                x[i + k]           = u + v;
+                x[i + k + len / 2] = u - v;
+                wk *= w;
+            }
+        }
+    }
+}
+
+//
+// Averaged power spectrum (bins 0 ... NFFT/2) of a signal
+//
+std::vector<double> spectrum(const std::vector<int16_t> &s)
+{
+    std::vector<double> psd(NFFT / 2 + 1, 0.0);
+    std::vector<std::complex<double> > x(NFFT);
+
+    for (int seg = 0; seg < NSEGMENTS; seg++) {
+        for (int i = 0; i < NFFT; i++) {
+            double w = 0.5 * (1.0 - cos(2 * M_PI * i / NFFT));
+            x[i] = w * s[seg * NFFT / 2 + i];
+        }
+        fft(x);
+        for (int i = 0; i <= NFFT / 2; i++) psd[i] += std::norm(x[i]);
+    }
+    return psd;
+}
+
+//
+// Render NSAMPLES of dots (and equal spaces) at the given speed
+// with the ramp currently selected, after the gains have settled
+//
+std::vector<int16_t> render_dots(ToneRig &rig, int wpm, double &ticks, double &cost)
+{
+    std::vector<uint64_t> t, c;
+    double   dot = 1.2e6 / wpm;                     // micro-seconds
+    uint32_t t0;
+    uint64_t k0;
+    int      n = 0;
+
+    t0 = ToneRig::now(rig.next() - 1);
+    k0 = rig.next();
+    while (rig.first_sample(rig.next()) - rig.first_sample(k0) < (size_t) NSAMPLES) {
+        uint32_t end = ToneRig::now(rig.next());
+        while (t0 + (uint32_t) (n * dot) < end) {
+            rig.tone.keyEvent(!(n & 1), t0 + (uint32_t) (n * dot));
+            n++;
+        }
+        rig.block();
+        t.push_back(rig.ticks);
+        c.push_back(bench_calibration());
+    }
+    ticks = bench_mean(t);
+    cost  = ticks / bench_mean(c);
+
+    //
+    // Key up, and let the ramp finish
+    //
+    rig.tone.keyEvent(0, ToneRig::now(rig.next() - 1));
+    rig.blocks(4);
+    return std::vector<int16_t>(rig.out[0].begin() + rig.first_sample(k0),
+                                rig.out[0].begin() + rig.first_sample(k0) + NSAMPLES);
+}
+
+void measure_spectrum(const std::vector<int16_t> &s, row &r)
+{
+    std::vector<double> psd = spectrum(s);
+    double binhz = AUDIO_SAMPLE_RATE_EXACT / NFFT;
+    double total = 0, sum = 0, peak = 0, click = 0;
+    int    lo = -1, hi = -1;
+
+    for (double p : psd) total += p;
+    for (int i = 0; i <= NFFT / 2; i++) {
+        sum += psd[i];
+        if (lo < 0 && sum >= 0.005 * total) lo = i;
+        if (hi < 0 && sum >= 0.995 * total) hi = i;
+        if (psd[i] > peak) peak = psd[i];
+        if (fabs(i * binhz - CARRIER) >= CLICK_OFFSET && psd[i] > click) click = psd[i];
+    }
+    r.bw_hz     = (hi - lo + 1) * binhz;
+    r.click_dbc = 10 * log10((click + 1e-30) / peak);
+}
+
+//
+// Key-up and key-down ramps with a constant carrier: with the key down,
+// run the oscillator at 93.75 Hz (a quarter cycle per block) for 9 blocks,
+// until the side tone gain has settled, then stop it at its peak
+//
+void measure_ramp(ToneRig &rig, int rise_ms, row &r)
+{
+    const std::vector<int16_t> &out = rig.out[0];
+    size_t  up, down;
+    int     length;
+    int16_t level;
+
+    rig.tone.frequency(93.75F);
+    rig.tone.keyEvent(1, ToneRig::now(rig.next() - 1));
+    rig.blocks(9);
+    rig.tone.frequency(0.0F);
+    rig.blocks(1);
+
+    down = rig.first_sample(rig.next());
+    rig.tone.keyEvent(0, ToneRig::now(rig.next() - 1));
+    rig.blocks(4);
+    up = rig.first_sample(rig.next());
+    rig.tone.keyEvent(1, ToneRig::now(rig.next() - 1));
+    rig.blocks(4);
+
+    //
+    // The ramp tables have rise_ms * 48 entries at 48 kHz. Near both ends
+    // the ramp values round to zero or the steady level, so the length
+    // cannot be found in the output; the 10% to 90% rise time can.
+    //
+    level  = out[down - 1];
+    length = rise_ms * (int) AUDIO_SAMPLE_RATE_EXACT / 1000;
+    r.rise = 0;
+    for (int i = 0; i < length; i++) {
+        double v = (double) out[up + i] / level;
+        if (v >= 0.1 && v < 0.9) r.rise++;
+    }
+    r.mirror_err = r.point_err = 0;
+    for (int i = 0; i < length; i++) {
+        double mirror = fabs(out[up + i] - out[down + length - 1 - i]) / abs(level);
+        double point  = fabs(out[up + i] + out[up + length - 1 - i] - level) / abs(level);
+        if (mirror > r.mirror_err) r.mirror_err = mirror;
+        if (point  > r.point_err)  r.point_err  = point;
+    }
+    rig.tone.frequency(CARRIER);
+}
+
+void print_row(FILE *f, const row &r)
+{
+    fprintf(f, "%s,%d,%.1f,%.1f,%d,%.6f,%.6f,%.0f,%.3f\n", r.window.c_str(), r.wpm,
+            r.bw_hz, r.click_dbc, r.rise, r.mirror_err, r.point_err, r.ticks, r.cost);
+}
+
+const char *HEADER = "window,wpm,bw_hz,click_dbc,rise,mirror_err,point_err,ticks,cost";
+
+std::map<std::string, row> read_baseline(const char *path)
+{
+    std::map<std::string, row> rows;
+    char line[256], window[32];
+    FILE *f = fopen(path, "r");
+
+    if (!f) return rows;
+    while (fgets(line, sizeof(line), f)) {
+        row r;
+        if (sscanf(line, "%31[^,],%d,%lf,%lf,%d,%lf,%lf,%lf,%lf", window, &r.wpm, &r.bw_hz,
+                   &r.click_dbc, &r.rise, &r.mirror_err, &r.point_err, &r.ticks, &r.cost) != 9) {
+            continue;   // header
+        }
+        r.window = window;
+        rows[r.window + "/" + std::to_string(r.wpm)] = r;
+    }
+    fclose(f);
+    return rows;
+}
+
+int compare(const row &r, const row &b)
+{
+    int failures = 0;
+    const char *name = r.window.c_str();
+
+    if (r.bw_hz > b.bw_hz * (1 + TOL_BW_REL) + TOL_BW_HZ) {
+        fprintf(stderr, "%s %d wpm: bandwidth %.1f Hz, baseline %.1f Hz\n", name, r.wpm, r.bw_hz, b.bw_hz);
+        failures++;
+    }
+    if (r.click_dbc > b.click_dbc + TOL_CLICK_DB) {
+        fprintf(stderr, "%s %d wpm: clicks %.1f dBc, baseline %.1f dBc\n", name, r.wpm, r.click_dbc, b.click_dbc);
+        failures++;
+    }
+    if (r.rise != b.rise || r.mirror_err > b.mirror_err + TOL_SYMMETRY ||
+        r.point_err > b.point_err + TOL_SYMMETRY) {
+        fprintf(stderr, "%s: ramp of %d samples, errors %.6f/%.6f, baseline %d samples, %.6f/%.6f\n",
+                name, r.rise, r.mirror_err, r.point_err, b.rise, b.mirror_err, b.point_err);
+        failures++;
+    }
+    return failures;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    std::map<std::string, row> baseline;
+    FILE *result = NULL;
+    double cost = 0, baseline_cost = 0;
+    int failures = 0;
+
+    if (argc > 1) {
+        baseline = read_baseline(argv[1]);
+        if (baseline.empty()) {
+            fprintf(stderr, "keying_spectrum: cannot read baseline %s\n", argv[1]);
+            return 1;
+        }
+    }
+    if (argc > 2 && !(result = fopen(argv[2], "w"))) {
+        fprintf(stderr, "keying_spectrum: cannot write %s\n", argv[2]);
+        return 1;
+    }
+
+    AudioMemory(16);
+    printf("%s\n", HEADER);
+    if (result) fprintf(result, "%s\n", HEADER);
+    for (int shape = 0; shape < WINDOW_NSHAPE; shape++) {
+        for (int rise = MIN_RISE_MS; rise < MIN_RISE_MS + WINDOW_NRISE; rise++) {
+            ToneRig rig;
+            row ramp;
+
+            rig.tone.setWindow(shape, rise);
+            rig.tone.amplitude(1.0F);
+            rig.tone.volume(1.0F);
+            rig.begin();
+            measure_ramp(rig, rise, ramp);
+
+            for (int wpm : SPEEDS) {
+                row r = ramp;
+                r.window = std::string(shape_name(shape)) + "_" + std::to_string(rise) + "ms";
+                r.wpm    = wpm;
+                for (int k = 0; k < REPEAT; k++) {
+                    double t, c;
+                    std::vector<int16_t> s = render_dots(rig, wpm, t, c);
+                    if (k == 0 || c < r.cost) {
+                        r.ticks = t;
+                        r.cost  = c;
+                    }
+                    if (k == 0) measure_spectrum(s, r);
+                }
+                cost += r.cost;
+                print_row(stdout, r);
+                if (result) print_row(result, r);
+
+                if (!baseline.empty()) {
+                    auto b = baseline.find(r.window + "/" + std::to_string(wpm));
+                    if (b == baseline.end()) {
+                        fprintf(stderr, "%s %d wpm: not in the baseline\n", r.window.c_str(), wpm);
+                        failures++;
+                    } else {
+                        failures += compare(r, b->second);
+                        baseline_cost += b->second.cost;
+                    }
+                }
+            }
+        }
+    }
+    if (result) fclose(result);
+    fprintf(stderr, "keying_spectrum: total cost %.1f", cost);
+    if (!baseline.empty()) fprintf(stderr, ", baseline %.1f", baseline_cost);
+    fprintf(stderr, "\n");
+    if (failures) fprintf(stderr, "keying_spectrum: %d regression(s)\n", failures);
+    return failures ? 1 : 0;
+}
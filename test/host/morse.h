@@ -0,0 +1,70 @@
+//
+// Morse code timing for rendered keying: text is turned into a list of
+// key transitions (PARIS timing, one dot = 1.2 / wpm seconds).
+//
+#ifndef morse_h_
+#define morse_h_
+
+#include <ctype.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct morse_edge {
+    uint64_t t;         // ns
+    int      state;     // 1 = key down
+};
+
+inline const char *morse_code(char c)
+{
+    static const char *letters[26] = {
+        ".-", "-...", "-.-.", "-..", ".", "..-.", "--.", "....", "..", ".---",
+        "-.-", ".-..", "--", "-.", "---", ".--.", "--.-", ".-.", "...", "-",
+        "..-", "...-", ".--", "-..-", "-.--", "--.."
+    };
+    static const char *digits[10] = {
+        "-----", ".----", "..---", "...--", "....-",
+        ".....", "-....", "--...", "---..", "----."
+    };
+
+    c = toupper(c);
+    if (c >= 'A' && c <= 'Z') return letters[c - 'A'];
+    if (c >= '0' && c <= '9') return digits[c - '0'];
+    switch (c) {
+    case '/': return "-..-.";
+    case '?': return "..--..";
+    case '.': return ".-.-.-";
+    case ',': return "--..--";
+    case '=': return "-...-";
+    }
+    return NULL;
+}
+
+//
+// Key transitions for text sent at wpm words per minute, starting at t0 (ns).
+// Returns the time at which the last element ends.
+//
+inline uint64_t morse_edges(const std::string &text, double wpm, uint64_t t0,
+                            std::vector<morse_edge> &edges)
+{
+    const uint64_t dot = (uint64_t) (1.2e9 / wpm);
+    uint64_t t = t0;
+
+    for (size_t i = 0; i < text.size(); i++) {
+        const char *code = morse_code(text[i]);
+        if (code == NULL) {
+            t += 4 * dot;           // word gap, 3 dots are added below
+        } else {
+            for (const char *e = code; *e; e++) {
+                edges.push_back({t, 1});
+                t += (*e == '-') ? 3 * dot : dot;
+                edges.push_back({t, 0});
+                t += dot;
+            }
+        }
+        t += 2 * dot;               // letter gap
+    }
+    return t;
+}
+
+#endif
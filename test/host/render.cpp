@@ -0,0 +1,123 @@
+//
+// Render a scripted keying session to a WAV file (headphone output).
+//
+// usage: render script.txt out.wav
+//
+// Each script line is "<time in ms> <command> <arguments>", '#' starts a
+// comment. Commands:
+//
+//   key  <0|1>                 key up/down (CWKeyerShield::key())
+//   note <note> <velocity>     MIDI note on (velocity 0: note off)
+//   cc   <cc> <value>          MIDI control change
+//   nrpn <nrpn> <value>        MIDI NRPN
+//   text <wpm> <text ...>      key the text in Morse code
+//   rx   <freq> <level>        RX audio from USB: sine wave, level 0 ... 1 (0: off)
+//   end                        stop rendering
+//
+// MIDI messages go to channel 10, the default of CWKeyerShield.
+//
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include "sim.h"
+#include "morse.h"
+#include "wav.h"
+
+static const uint8_t MIDI_CHANNEL = 10;
+
+int main(int argc, char **argv)
+{
+    if (argc != 3) {
+        std::cerr << "usage: render script.txt out.wav" << std::endl;
+        return 2;
+    }
+    std::ifstream script(argv[1]);
+    if (!script) {
+        std::cerr << argv[1] << ": cannot open" << std::endl;
+        return 1;
+    }
+
+    ShieldSim sim;
+    double rx_freq = 0, rx_level = 0, rx_phase = 0;
+    uint64_t end = 0;
+    std::string line;
+    int lineno = 0;
+
+    sim.begin();
+    uint64_t t0 = host_time_ns;
+
+    sim.usb_in = [&](uint8_t channel, int16_t *data) {
+        if (rx_level == 0) return false;
+        double phase = rx_phase;
+        for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+            data[i] = (int16_t) lrint(32767 * rx_level * sin(phase));
+            phase += 2 * M_PI * rx_freq / AUDIO_SAMPLE_RATE_EXACT;
+        }
+        if (channel == 1) rx_phase = fmod(phase, 2 * M_PI);
+        return true;
+    };
+
+    while (std::getline(script, line)) {
+        lineno++;
+        size_t hash = line.find('#');
+        if (hash != std::string::npos) line.erase(hash);
+        std::istringstream in(line);
+        double ms;
+        std::string cmd;
+        if (!(in >> ms)) continue;
+        if (!(in >> cmd)) {
+            std::cerr << argv[1] << ":" << lineno << ": command missing" << std::endl;
+            return 1;
+        }
+        uint64_t t = t0 + (uint64_t) (ms * 1e6);
+        int a = 0, b = 0;
+
+        if (cmd == "key" && (in >> a)) {
+            sim.at(t, [&sim, a]() { sim.shield.key(a); });
+        } else if (cmd == "note" && (in >> a >> b)) {
+            sim.at(t, [a, b]() { host_send_note(MIDI_CHANNEL, a, b); });
+        } else if (cmd == "cc" && (in >> a >> b)) {
+            sim.at(t, [a, b]() { host_send_cc(MIDI_CHANNEL, a, b); });
+        } else if (cmd == "nrpn" && (in >> a >> b)) {
+            sim.at(t, [a, b]() { host_send_nrpn(MIDI_CHANNEL, a, b); });
+        } else if (cmd == "text" && (in >> ms)) {
+            std::string text;
+            std::getline(in, text);
+            std::vector<morse_edge> edges;
+            uint64_t last = morse_edges(text.substr(text.find_first_not_of(' ')), ms, t, edges);
+            for (const morse_edge &e : edges) {
+                int state = e.state;
+                sim.at(e.t, [&sim, state]() { sim.shield.key(state); });
+            }
+            if (last > end) end = last;
+        } else if (cmd == "rx") {
+            double freq, level;
+            if (!(in >> freq >> level)) {
+                std::cerr << argv[1] << ":" << lineno << ": bad arguments" << std::endl;
+                return 1;
+            }
+            sim.at(t, [&rx_freq, &rx_level, freq, level]() { rx_freq = freq; rx_level = level; });
+        } else if (cmd == "end") {
+            end = t;
+            break;
+        } else {
+            std::cerr << argv[1] << ":" << lineno << ": bad command" << std::endl;
+            return 1;
+        }
+        if (t > end) end = t;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    sim.run_until(end);
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (!wav_write(argv[2], sim.out[0], sim.out[1], (uint32_t) AUDIO_SAMPLE_RATE_EXACT)) {
+        std::cerr << argv[2] << ": cannot write" << std::endl;
+        return 1;
+    }
+    size_t samples = sim.out[0].size();
+    std::cout << "rendered " << samples << " samples in " << secs << " s, "
+              << (secs > 0 ? samples / secs : 0) << " samples/s" << std::endl;
+    return 0;
+}
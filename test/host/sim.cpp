@@ -0,0 +1,67 @@
+//
+// Simulated time for one CWKeyerShield, see sim.h
+//
+#include "sim.h"
+
+ShieldSim *ShieldSim::current = NULL;
+
+bool ShieldSim::source(uint8_t port, uint8_t channel, int16_t *data)
+{
+    const std::function<bool(uint8_t, int16_t *)> &in = (port == HOST_USB_IN) ? current->usb_in : current->line_in;
+
+    if (!in) return false;
+    return in(channel, data);
+}
+
+void ShieldSim::sink(uint8_t port, uint8_t channel, const int16_t *data)
+{
+    std::vector<int16_t> &v = (port == HOST_LINE_OUT) ? current->out[channel] : current->usb_out[channel];
+    if (data) {
+        v.insert(v.end(), data, data + AUDIO_BLOCK_SAMPLES);
+    } else {
+        v.insert(v.end(), AUDIO_BLOCK_SAMPLES, 0);
+    }
+}
+
+void ShieldSim::begin(void)
+{
+    current = this;
+    host_audio_source = source;
+    host_audio_sink = sink;
+    shield.setup();
+    //
+    // one loop() pass per startup stage
+    //
+    for (int i = 0; i < SETUP_DONE; i++) shield.loop();
+    next_loop = host_time_ns + LOOP_NS;
+}
+
+void ShieldSim::at(uint64_t t, std::function<void(void)> action)
+{
+    actions.insert(std::make_pair(t, action));
+}
+
+void ShieldSim::run_until(uint64_t t)
+{
+    while (host_time_ns < t) {
+        uint64_t block_end = host_block_end_ns(block);
+        uint64_t next = next_loop < block_end ? next_loop : block_end;
+        if (!actions.empty() && actions.begin()->first < next) next = actions.begin()->first;
+        if (next > t) next = t;
+        if (next > host_time_ns) host_advance_ns(next - host_time_ns);
+
+        while (!actions.empty() && actions.begin()->first <= host_time_ns) {
+            std::function<void(void)> action = actions.begin()->second;
+            actions.erase(actions.begin());
+            action();
+        }
+        if (host_time_ns >= next_loop) {
+            shield.loop();
+            next_loop += LOOP_NS;
+        }
+        if (host_time_ns >= block_end) {
+            AudioStream::update_all();
+            block++;
+        }
+    }
+}
@@ -0,0 +1,73 @@
+//
+// Runs one CWKeyerShield in simulated time: loop() is called at a fixed
+// interval, the audio library is updated at the end of each block, and
+// actions can be scheduled at any point in time (ns resolution).
+// The headphone (line out) audio and the USB audio to the computer are
+// captured.
+//
+#ifndef sim_h_
+#define sim_h_
+
+#include <functional>
+#include <map>
+#include <vector>
+#include "host.h"
+#include "CWKeyerShield.h"
+
+class ShieldSim
+{
+public:
+    static const uint64_t LOOP_NS = 250000;     // loop() interval (ns)
+
+    ShieldSim(int i2s = 1) : shield(i2s) {}
+
+    CWKeyerShield shield;
+
+    //
+    // Captured line out audio, one vector per channel
+    //
+    std::vector<int16_t> out[2];
+
+    //
+    // Captured USB (microphone) audio to the computer
+    //
+    std::vector<int16_t> usb_out[2];
+
+    //
+    // Sources of the USB (RX) audio and of the microphone (line in) audio,
+    // called once per block and channel; they return false if there is
+    // no audio. NULL: no audio.
+    //
+    std::function<bool(uint8_t channel, int16_t *data)> usb_in;
+    std::function<bool(uint8_t channel, int16_t *data)> line_in;
+
+    //
+    // Call setup(), and run until all startup stages are done
+    //
+    void begin(void);
+
+    //
+    // Schedule an action at simulated time t (ns). Actions at the same
+    // time run in the order they were scheduled.
+    //
+    void at(uint64_t t, std::function<void(void)> action);
+
+    //
+    // Run until simulated time t (ns), or for a number of audio blocks
+    //
+    void run_until(uint64_t t);
+    void run_blocks(unsigned nblocks) { run_until(host_block_end_ns(block + nblocks - 1)); }
+
+    uint64_t blocks(void) { return block; }
+
+private:
+    std::multimap<uint64_t, std::function<void(void)>> actions;
+    uint64_t next_loop = 0;
+    uint64_t block = 0;             // number of audio blocks done
+
+    static ShieldSim *current;
+    static bool source(uint8_t port, uint8_t channel, int16_t *data);
+    static void sink(uint8_t port, uint8_t channel, const int16_t *data);
+};
+
+#endif
@@ -0,0 +1,90 @@
+//
+// Host stand-in for the parts of the Teensy 4 core used by CWKeyerShield.
+// Time is simulated, see host.h: micros(), millis() and the cycle counter
+// only advance when the harness advances the clock.
+//
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define A1 15
+#define A2 16
+#define A3 17
+#define A8 22
+
+#define INPUT        0
+#define OUTPUT       1
+#define INPUT_PULLUP 2
+#define CHANGE       4
+
+#define FASTRUN
+#define DMAMEM
+#define PROGMEM
+#define FLASHMEM
+
+#ifndef PI
+#define PI 3.1415926535897932384626433832795
+#endif
+
+extern volatile uint32_t F_CPU_ACTUAL;
+uint32_t host_cyccnt(void);
+#define ARM_DWT_CYCCNT (host_cyccnt())
+
+uint32_t millis(void);
+uint32_t micros(void);
+
+void pinMode(int pin, int mode);
+void digitalWrite(int pin, int value);
+int  digitalRead(int pin);
+void digitalWriteFast(int pin, int value);
+int  digitalReadFast(int pin);
+int  analogRead(int pin);
+void analogReadRes(int bits);
+void analogReadAveraging(int num);
+void attachInterrupt(int irq, void (*function)(void), int mode);
+int  digitalPinToInterrupt(int pin);
+
+inline void __disable_irq(void) {}
+inline void __enable_irq(void)  {}
+
+//
+// Periodic timer, run by the simulated clock: host_advance_ns() calls
+// the function of each timer whose time has come, at that time
+//
+class IntervalTimer
+{
+public:
+    bool begin(void (*function)(void), unsigned int us);
+    void end(void);
+};
+
+class usb_midi_class
+{
+public:
+    enum {
+        NoteOff         = 0x80,
+        NoteOn          = 0x90,
+        ControlChange   = 0xB0,
+        SystemExclusive = 0xF0
+    };
+    bool     read(void);
+    uint8_t  getType(void);
+    uint8_t  getChannel(void);
+    uint8_t  getData1(void);
+    uint8_t  getData2(void);
+    const uint8_t *getSysExArray(void);
+    uint16_t getSysExArrayLength(void);
+    void sendNoteOn(uint8_t note, uint8_t velocity, uint8_t channel);
+    void sendControlChange(uint8_t control, uint8_t value, uint8_t channel);
+    void beginNrpn(uint16_t number, uint8_t channel);
+    void sendNrpnValue(uint16_t value, uint8_t channel);
+    void sendSysEx(uint32_t length, const uint8_t *data, bool has_term = false);
+    void send_now(void) {}
+};
+extern usb_midi_class usbMIDI;
+
+#endif
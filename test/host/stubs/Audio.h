@@ -0,0 +1,94 @@
+//
+// Host stand-in for the audio objects of the Teensy audio library used by
+// CWKeyerShield. Inputs take their audio from, and outputs hand theirs to,
+// the harness, see host_audio_source and host_audio_sink in host.h.
+// The codec controls only count the calls made to them.
+//
+#ifndef Audio_h_
+#define Audio_h_
+
+#include "AudioStream.h"
+
+#define AUDIO_INPUT_LINEIN 0
+#define AUDIO_INPUT_MIC    1
+
+//
+// Audio ports of the harness
+//
+enum host_audio_port {
+    HOST_USB_IN   = 0,      // RX audio from the PC
+    HOST_USB_OUT  = 1,      // microphone audio to the PC
+    HOST_LINE_IN  = 2,      // I2S input (microphone)
+    HOST_LINE_OUT = 3       // I2S or MQS output (headphones)
+};
+
+class HostAudioInput : public AudioStream
+{
+public:
+    HostAudioInput(uint8_t p) : AudioStream(0, NULL), port(p) {}
+    virtual void update(void);
+private:
+    uint8_t port;
+};
+
+class HostAudioOutput : public AudioStream
+{
+public:
+    HostAudioOutput(uint8_t p) : AudioStream(2, inputQueueArray), port(p) {}
+    virtual void update(void);
+private:
+    audio_block_t *inputQueueArray[2];
+    uint8_t port;
+};
+
+class AudioInputUSB   : public HostAudioInput  { public: AudioInputUSB()   : HostAudioInput(HOST_USB_IN)    {} };
+class AudioOutputUSB  : public HostAudioOutput { public: AudioOutputUSB()  : HostAudioOutput(HOST_USB_OUT)  {} };
+class AudioInputI2S   : public HostAudioInput  { public: AudioInputI2S()   : HostAudioInput(HOST_LINE_IN)   {} };
+class AudioOutputI2S  : public HostAudioOutput { public: AudioOutputI2S()  : HostAudioOutput(HOST_LINE_OUT) {} };
+class AudioOutputMQS  : public HostAudioOutput { public: AudioOutputMQS()  : HostAudioOutput(HOST_LINE_OUT) {} };
+
+//
+// Number of calls to the codec controls, and the last volume written
+//
+struct host_codec_log {
+    unsigned calls;
+    unsigned volume_calls;
+    float    volume;
+};
+extern host_codec_log host_codec;
+
+class AudioControlWM8960
+{
+public:
+    bool enable(void)                         { return log(); }
+    bool disable(void)                        { return log(); }
+    bool volume(float n)                      { return volume(n, n); }
+    bool volume(float l, float r)             { host_codec.volume_calls++; host_codec.volume = l; return log(); }
+    bool inputSelect(int n)                   { return log(); }
+    bool inputLevel(float l, float r)         { return log(); }
+    bool headphoneVolume(float l, float r)    { return log(); }
+    bool headphonePower(int n)                { return log(); }
+    bool speakerVolume(float l, float r)      { return log(); }
+    bool speakerPower(int n)                  { return log(); }
+    bool disableADCHPF(int n)                 { return log(); }
+    bool enableMicBias(int n)                 { return log(); }
+    bool enableALC(int n)                     { return log(); }
+    bool micPower(int n)                      { return log(); }
+    bool lineinPower(int n)                   { return log(); }
+    bool write(unsigned reg, unsigned val, unsigned mask, bool force) { return log(); }
+private:
+    bool log(void) { host_codec.calls++; return true; }
+};
+
+class AudioControlSGTL5000
+{
+public:
+    bool enable(void)                         { return log(); }
+    bool volume(float n)                      { host_codec.volume_calls++; host_codec.volume = n; return log(); }
+    bool inputSelect(int n)                   { return log(); }
+    bool micGain(unsigned int dB)             { return log(); }
+private:
+    bool log(void) { host_codec.calls++; return true; }
+};
+
+#endif
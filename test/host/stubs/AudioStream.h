@@ -0,0 +1,84 @@
+//
+// Host stand-in for the Teensy audio library core. Same block pool,
+// reference counting, connections and update order as on the Teensy:
+// update_all() runs the update() of every connected object in the order
+// of construction, blocks are passed on by transmit().
+//
+#ifndef AudioStream_h
+#define AudioStream_h
+
+#include <stdint.h>
+
+#define AUDIO_BLOCK_SAMPLES     128
+#define AUDIO_SAMPLE_RATE_EXACT 48000.0f
+#define AUDIO_SAMPLE_RATE       AUDIO_SAMPLE_RATE_EXACT
+
+typedef struct audio_block_struct {
+    uint8_t  ref_count;
+    uint8_t  reserved1;
+    uint16_t memory_pool_index;
+    int16_t  data[AUDIO_BLOCK_SAMPLES];
+} audio_block_t;
+
+class AudioStream;
+
+class AudioConnection
+{
+public:
+    AudioConnection(AudioStream &source, unsigned char sourceOutput,
+                    AudioStream &destination, unsigned char destinationInput);
+    AudioConnection(AudioStream &source, AudioStream &destination)
+        : AudioConnection(source, 0, destination, 0) {}
+    ~AudioConnection();
+
+private:
+    friend class AudioStream;
+    AudioStream     &src;
+    AudioStream     &dst;
+    unsigned char    src_index;
+    unsigned char    dest_index;
+    AudioConnection *next_dest;
+};
+
+class AudioStream
+{
+public:
+    AudioStream(unsigned char ninput, audio_block_t **iqueue);
+    virtual ~AudioStream();
+
+    static void initialize_memory(audio_block_t *data, unsigned int num);
+    static void update_all(void);
+
+    static uint16_t memory_used;
+    static uint16_t memory_used_max;
+
+protected:
+    bool          active;
+    unsigned char num_inputs;
+    uint16_t      cpu_cycles;
+    uint16_t      cpu_cycles_max;
+
+    static audio_block_t *allocate(void);
+    static void release(audio_block_t *block);
+    void transmit(audio_block_t *block, unsigned char index = 0);
+    audio_block_t *receiveReadOnly(unsigned int index = 0);
+    audio_block_t *receiveWritable(unsigned int index = 0);
+
+    virtual void update(void) = 0;
+
+private:
+    friend class AudioConnection;
+    AudioConnection  *destination_list;
+    audio_block_t   **inputQueue;
+    AudioStream      *next_update;
+    static AudioStream *first_update;
+};
+
+#define AudioMemory(num) ({ static audio_block_t data[num]; AudioStream::initialize_memory(data, num); })
+#define AudioMemoryUsage()         (AudioStream::memory_used)
+#define AudioMemoryUsageMax()      (AudioStream::memory_used_max)
+#define AudioMemoryUsageMaxReset() (AudioStream::memory_used_max = AudioStream::memory_used)
+#define AudioNoInterrupts()        ((void) 0)
+#define AudioInterrupts()          ((void) 0)
+
+#endif
@@ -0,0 +1,21 @@
+//
+// Host stand-in for the (emulated) EEPROM of the Teensy 4.0,
+// see host_eeprom in host.h
+//
+#ifndef EEPROM_h
+#define EEPROM_h
+
+#include <stdint.h>
+
+#define E2END 0x437
+
+class EEPROMClass
+{
+public:
+    uint8_t read(int idx);
+    void    write(int idx, uint8_t val);
+    void    update(int idx, uint8_t val) { if (read(idx) != val) write(idx, val); }
+};
+extern EEPROMClass EEPROM;
+
+#endif
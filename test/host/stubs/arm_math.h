@@ -0,0 +1,25 @@
+//
+// Host version of the CMSIS-DSP functions used by TeensyAudioTone
+//
+#ifndef _ARM_MATH_H
+#define _ARM_MATH_H
+
+#include <stdint.h>
+
+typedef int16_t q15_t;
+typedef int32_t q31_t;
+typedef int64_t q63_t;
+
+typedef struct {
+    int8_t  numStages;
+    q15_t  *pState;
+    const q15_t *pCoeffs;
+    int8_t  postShift;
+} arm_biquad_casd_df1_inst_q15;
+
+void arm_biquad_cascade_df1_init_q15(arm_biquad_casd_df1_inst_q15 *S, uint8_t numStages,
+                                     const q15_t *pCoeffs, q15_t *pState, int8_t postShift);
+void arm_biquad_cascade_df1_fast_q15(const arm_biquad_casd_df1_inst_q15 *S,
+                                     const q15_t *pSrc, q15_t *pDst, uint32_t blockSize);
+
+#endif
@@ -0,0 +1,507 @@
+//
+// Implementation of the host stand-ins declared in stubs/ and host.h
+//
+#include "host.h"
+#include "TeensyPots.h"
+#include "arm_math.h"
+#include "utility/dspinst.h"
+
+//
+// ======================== Time ===========================================
+//
+uint64_t host_time_ns = 0;
+volatile uint32_t F_CPU_ACTUAL = 600000000;
+
+namespace {
+
+struct host_timer {
+    IntervalTimer *timer;
+    void         (*function)(void);
+    uint64_t       period;          // ns
+    uint64_t       next;            // ns
+};
+std::vector<host_timer> timers;
+
+} // namespace
+
+bool IntervalTimer::begin(void (*function)(void), unsigned int us)
+{
+    end();
+    timers.push_back({this, function, us * 1000ULL, host_time_ns + us * 1000ULL});
+    return true;
+}
+
+void IntervalTimer::end(void)
+{
+    for (size_t i = 0; i < timers.size(); i++) {
+        if (timers[i].timer == this) timers.erase(timers.begin() + i--);
+    }
+}
+
+void host_advance_ns(uint64_t ns)
+{
+    uint64_t end = host_time_ns + ns;
+
+    for (;;) {
+        host_timer *t = NULL;
+        for (host_timer &u : timers) {
+            if (u.next <= end && (!t || u.next < t->next)) t = &u;
+        }
+        if (!t) break;
+        host_time_ns = t->next;
+        t->next += t->period;
+        t->function();
+    }
+    host_time_ns = end;
+}
+
+uint32_t micros(void)
+{
+    return (uint32_t) (host_time_ns / 1000);
+}
+
+uint32_t millis(void)
+{
+    return (uint32_t) (host_time_ns / 1000000);
+}
+
+uint32_t host_cyccnt(void)
+{
+    // 600 cycles per micro-second
+    return (uint32_t) (host_time_ns * 3 / 5);
+}
+
+//
+// ======================== I/O lines ======================================
+//
+int host_pins[64];
+int host_analog[64];
+void (*host_pin_isr[64])(void);
+
+void pinMode(int pin, int mode)
+{
+    // a pull-up reads high until the harness drives the line
+    if (mode == INPUT_PULLUP) host_pins[pin] = 1;
+}
+
+void digitalWrite(int pin, int value)     { host_pins[pin] = value; }
+int  digitalRead(int pin)                 { return host_pins[pin]; }
+void digitalWriteFast(int pin, int value) { host_pins[pin] = value; }
+int  digitalReadFast(int pin)             { return host_pins[pin]; }
+int  analogRead(int pin)                  { return host_analog[pin]; }
+void analogReadRes(int bits)              {}
+void analogReadAveraging(int num)         {}
+int  digitalPinToInterrupt(int pin)       { return pin; }
+
+void attachInterrupt(int irq, void (*function)(void), int mode)
+{
+    host_pin_isr[irq] = function;
+}
+
+void host_drive_pin(int pin, int value)
+{
+    if (host_pins[pin] == value) return;
+    host_pins[pin] = value;
+    if (host_pin_isr[pin]) (*host_pin_isr[pin])();
+}
+
+//
+// ======================== Pots ===========================================
+//
+// Stand-in for the ADC scan of TeensyPots: once per CWKEYER_POTS_SCAN_US,
+// the value of each pot line (host_analog[], 12 bits) is entered with
+// sample(), as the ADC interrupt does. channel[] holds the pins.
+//
+namespace {
+
+IntervalTimer pots_timer;
+TeensyPots   *pots_scanner = NULL;
+
+} // namespace
+
+void TeensyPots::begin(const int pins[NPOTS])
+{
+    for (uint8_t pot = 0; pot < NPOTS; pot++) {
+        channel[pot] = (pins[pot] >= 0) ? pins[pot] : 0xff;
+        started[pot] = 0;
+    }
+    current = NPOTS;
+    pots_scanner = this;
+    pots_timer.begin(timer_isr, CWKEYER_POTS_SCAN_US);
+}
+
+void TeensyPots::end(void)
+{
+    pots_timer.end();
+}
+
+void TeensyPots::timer_isr(void)
+{
+    TeensyPots *p = pots_scanner;
+
+    for (uint8_t pot = 0; pot < NPOTS; pot++) {
+        if (p->channel[pot] != 0xff) p->sample(pot, host_analog[p->channel[pot]] & 0xfff);
+    }
+    p->scan_count++;
+}
+
+//
+// ======================== EEPROM =========================================
+//
+EEPROMClass EEPROM;
+uint8_t  host_eeprom[E2END + 1];
+unsigned host_eeprom_writes = 0;
+
+uint8_t EEPROMClass::read(int idx)
+{
+    return host_eeprom[idx];
+}
+
+void EEPROMClass::write(int idx, uint8_t val)
+{
+    host_eeprom[idx] = val;
+    host_eeprom_writes++;
+}
+
+//
+// ======================== MIDI ===========================================
+//
+usb_midi_class usbMIDI;
+std::deque<host_midi_message>  host_midi_in;
+std::vector<host_midi_message> host_midi_out;
+
+namespace {
+
+host_midi_message midi_current;
+
+void midi_out(uint8_t type, uint8_t channel, uint8_t data1, uint8_t data2)
+{
+    host_midi_message m;
+
+    m.type = type;
+    m.channel = channel;
+    m.data1 = data1;
+    m.data2 = data2;
+    host_midi_out.push_back(m);
+}
+
+void midi_in(uint8_t type, uint8_t channel, uint8_t data1, uint8_t data2)
+{
+    host_midi_message m;
+
+    m.type = type;
+    m.channel = channel;
+    m.data1 = data1;
+    m.data2 = data2;
+    host_midi_in.push_back(m);
+}
+
+} // namespace
+
+bool usb_midi_class::read(void)
+{
+    if (host_midi_in.empty()) return false;
+    midi_current = host_midi_in.front();
+    host_midi_in.pop_front();
+    return true;
+}
+
+uint8_t  usb_midi_class::getType(void)             { return midi_current.type; }
+uint8_t  usb_midi_class::getChannel(void)          { return midi_current.channel; }
+uint8_t  usb_midi_class::getData1(void)            { return midi_current.data1; }
+uint8_t  usb_midi_class::getData2(void)            { return midi_current.data2; }
+const uint8_t *usb_midi_class::getSysExArray(void) { return midi_current.sysex.data(); }
+uint16_t usb_midi_class::getSysExArrayLength(void) { return midi_current.sysex.size(); }
+
+void usb_midi_class::sendNoteOn(uint8_t note, uint8_t velocity, uint8_t channel)
+{
+    midi_out(NoteOn, channel, note, velocity);
+}
+
+void usb_midi_class::sendControlChange(uint8_t control, uint8_t value, uint8_t channel)
+{
+    midi_out(ControlChange, channel, control, value);
+}
+
+void usb_midi_class::beginNrpn(uint16_t number, uint8_t channel)
+{
+    sendControlChange(99, number >> 7, channel);
+    sendControlChange(98, number & 0x7f, channel);
+}
+
+void usb_midi_class::sendNrpnValue(uint16_t value, uint8_t channel)
+{
+    sendControlChange(6, (value >> 7) & 0x7f, channel);
+    sendControlChange(38, value & 0x7f, channel);
+}
+
+void usb_midi_class::sendSysEx(uint32_t length, const uint8_t *data, bool has_term)
+{
+    host_midi_message m;
+
+    m.type = SystemExclusive;
+    m.channel = m.data1 = m.data2 = 0;
+    if (!has_term) m.sysex.push_back(0xf0);
+    m.sysex.insert(m.sysex.end(), data, data + length);
+    if (!has_term) m.sysex.push_back(0xf7);
+    host_midi_out.push_back(m);
+}
+
+void host_send_cc(uint8_t channel, uint8_t cc, uint8_t value)
+{
+    midi_in(usb_midi_class::ControlChange, channel, cc, value);
+}
+
+void host_send_nrpn(uint8_t channel, uint16_t nrpn, uint16_t value)
+{
+    host_send_cc(channel, 99, nrpn >> 7);
+    host_send_cc(channel, 98, nrpn & 0x7f);
+    host_send_cc(channel, 6, (value >> 7) & 0x7f);
+    host_send_cc(channel, 38, value & 0x7f);
+}
+
+void host_send_note(uint8_t channel, uint8_t note, uint8_t velocity)
+{
+    midi_in(velocity ? usb_midi_class::NoteOn : usb_midi_class::NoteOff, channel, note, velocity);
+}
+
+void host_send_sysex(const std::vector<uint8_t> &message)
+{
+    host_midi_message m;
+
+    m.type = usb_midi_class::SystemExclusive;
+    m.channel = m.data1 = m.data2 = 0;
+    m.sysex = message;
+    host_midi_in.push_back(m);
+}
+
+//
+// ======================== Keyer sketch ===================================
+//
+int host_keyer_speed = 0;
+
+void speed_set(int speed)          { host_keyer_speed = speed; }
+void keyer_autoptt_set(int enable) {}
+void keyer_leadin_set(int leadin)  {}
+void keyer_hang_set(int hang)      {}
+
+//
+// ======================== Audio library core =============================
+//
+uint16_t     AudioStream::memory_used = 0;
+uint16_t     AudioStream::memory_used_max = 0;
+AudioStream *AudioStream::first_update = NULL;
+
+namespace {
+
+std::vector<audio_block_t *> memory_free;
+
+} // namespace
+
+AudioStream::AudioStream(unsigned char ninput, audio_block_t **iqueue)
+    : active(false), num_inputs(ninput), cpu_cycles(0), cpu_cycles_max(0),
+      destination_list(NULL), inputQueue(iqueue), next_update(NULL)
+{
+    for (unsigned char i = 0; i < ninput; i++) inputQueue[i] = NULL;
+    //
+    // append to the update list, objects are updated in construction order
+    //
+    if (first_update == NULL) {
+        first_update = this;
+    } else {
+        AudioStream *p = first_update;
+        while (p->next_update) p = p->next_update;
+        p->next_update = this;
+    }
+}
+
+AudioStream::~AudioStream()
+{
+    AudioStream **p = &first_update;
+    while (*p && *p != this) p = &(*p)->next_update;
+    if (*p) *p = next_update;
+}
+
+void AudioStream::initialize_memory(audio_block_t *data, unsigned int num)
+{
+    memory_free.clear();
+    for (unsigned int i = num; i > 0; i--) {
+        data[i - 1].ref_count = 0;
+        data[i - 1].memory_pool_index = i - 1;
+        memory_free.push_back(&data[i - 1]);
+    }
+    memory_used = memory_used_max = 0;
+}
+
+audio_block_t *AudioStream::allocate(void)
+{
+    if (memory_free.empty()) return NULL;
+    audio_block_t *block = memory_free.back();
+    memory_free.pop_back();
+    block->ref_count = 1;
+    if (++memory_used > memory_used_max) memory_used_max = memory_used;
+    return block;
+}
+
+void AudioStream::release(audio_block_t *block)
+{
+    if (block == NULL) return;
+    if (block->ref_count > 1) {
+        block->ref_count--;
+    } else {
+        block->ref_count = 0;
+        memory_free.push_back(block);
+        memory_used--;
+    }
+}
+
+void AudioStream::transmit(audio_block_t *block, unsigned char index)
+{
+    for (AudioConnection *c = destination_list; c != NULL; c = c->next_dest) {
+        if (c->src_index != index) continue;
+        if (c->dst.inputQueue[c->dest_index] == NULL) {
+            c->dst.inputQueue[c->dest_index] = block;
+            block->ref_count++;
+        }
+    }
+}
+
+audio_block_t *AudioStream::receiveReadOnly(unsigned int index)
+{
+    if (index >= num_inputs) return NULL;
+    audio_block_t *in = inputQueue[index];
+    inputQueue[index] = NULL;
+    return in;
+}
+
+audio_block_t *AudioStream::receiveWritable(unsigned int index)
+{
+    if (index >= num_inputs) return NULL;
+    audio_block_t *in = inputQueue[index];
+    inputQueue[index] = NULL;
+    if (in && in->ref_count > 1) {
+        audio_block_t *p = allocate();
+        if (p) memcpy(p->data, in->data, sizeof(p->data));
+        in->ref_count--;
+        in = p;
+    }
+    return in;
+}
+
+void AudioStream::update_all(void)
+{
+    for (AudioStream *p = first_update; p != NULL; p = p->next_update) {
+        if (!p->active) continue;
+        uint32_t cycles = ARM_DWT_CYCCNT;
+        p->update();
+        cycles = (ARM_DWT_CYCCNT - cycles) >> 6;
+        p->cpu_cycles = cycles;
+        if (cycles > p->cpu_cycles_max) p->cpu_cycles_max = cycles;
+    }
+}
+
+AudioConnection::AudioConnection(AudioStream &source, unsigned char sourceOutput,
+                                 AudioStream &destination, unsigned char destinationInput)
+    : src(source), dst(destination), src_index(sourceOutput), dest_index(destinationInput),
+      next_dest(NULL)
+{
+    AudioConnection **p = &src.destination_list;
+    while (*p) p = &(*p)->next_dest;
+    *p = this;
+    src.active = true;
+    dst.active = true;
+}
+
+AudioConnection::~AudioConnection()
+{
+    AudioConnection **p = &src.destination_list;
+    while (*p && *p != this) p = &(*p)->next_dest;
+    if (*p) *p = next_dest;
+}
+
+//
+// ======================== Audio ports ====================================
+//
+bool (*host_audio_source)(uint8_t port, uint8_t channel, int16_t *data) = NULL;
+void (*host_audio_sink)(uint8_t port, uint8_t channel, const int16_t *data) = NULL;
+host_codec_log host_codec;
+
+void HostAudioInput::update(void)
+{
+    for (uint8_t ch = 0; ch < 2; ch++) {
+        if (!host_audio_source) return;
+        audio_block_t *block = allocate();
+        if (!block) return;
+        if ((*host_audio_source)(port, ch, block->data)) transmit(block, ch);
+        release(block);
+    }
+}
+
+void HostAudioOutput::update(void)
+{
+    for (uint8_t ch = 0; ch < 2; ch++) {
+        audio_block_t *block = receiveReadOnly(ch);
+        if (host_audio_sink) (*host_audio_sink)(port, ch, block ? block->data : NULL);
+        release(block);
+    }
+}
+
+//
+// ======================== Audio library data =============================
+//
+extern "C" {
+extern const int16_t AudioWaveformSine[257];
+const int16_t AudioWaveformSine[257] = {
+#include "sinetab.inc"
+};
+}
+
+//
+// ======================== CMSIS-DSP ======================================
+//
+void arm_biquad_cascade_df1_init_q15(arm_biquad_casd_df1_inst_q15 *S, uint8_t numStages,
+                                     const q15_t *pCoeffs, q15_t *pState, int8_t postShift)
+{
+    S->numStages = numStages;
+    S->pCoeffs = pCoeffs;
+    S->pState = pState;
+    S->postShift = postShift;
+    memset(pState, 0, 4 * numStages * sizeof(q15_t));
+}
+
+//
+// Same arithmetic as the Cortex-M version: the products are summed
+// (SMLAD) in a 32-bit accumulator that wraps around, the result is
+// shifted and saturated to 16 bits. Coefficients are {b0, 0, b1, b2, a1, a2},
+// the state of each stage is {x[n-1], x[n-2], y[n-1], y[n-2]}.
+//
+void arm_biquad_cascade_df1_fast_q15(const arm_biquad_casd_df1_inst_q15 *S,
+                                     const q15_t *pSrc, q15_t *pDst, uint32_t blockSize)
+{
+    const q15_t *c = S->pCoeffs;
+    q15_t *state = S->pState;
+    const q15_t *in = pSrc;
+
+    for (int8_t stage = 0; stage < S->numStages; stage++) {
+        q15_t x1 = state[0], x2 = state[1], y1 = state[2], y2 = state[3];
+        for (uint32_t n = 0; n < blockSize; n++) {
+            q15_t x0 = in[n];
+            uint32_t acc = (uint32_t) (c[0] * x0);
+            acc += (uint32_t) (c[2] * x1) + (uint32_t) (c[3] * x2);
+            acc += (uint32_t) (c[4] * y1) + (uint32_t) (c[5] * y2);
+            int32_t out = signed_saturate_rshift((int32_t) acc, 16, 15 - S->postShift);
+            x2 = x1;
+            x1 = x0;
+            y2 = y1;
+            y1 = (q15_t) out;
+            pDst[n] = (q15_t) out;
+        }
+        state[0] = x1;
+        state[1] = x2;
+        state[2] = y1;
+        state[3] = y2;
+        state += 4;
+        c += 6;
+        in = pDst;
+    }
+}
@@ -0,0 +1,47 @@
+//
+// Host versions of the Cortex-M7 DSP helpers of the Teensy audio library.
+// They compute the same results as the single instructions (SSAT, SMMUL,
+// SMUAD, SMLAD, PKHBT), including the wrap-around of the 32-bit sums.
+//
+#ifndef dspinst_h_
+#define dspinst_h_
+
+#include <stdint.h>
+
+// SSAT: saturate (val >> rshift) to a signed number of "bits" bits
+static inline int32_t signed_saturate_rshift(int32_t val, int bits, int rshift)
+{
+    int32_t out = val >> rshift;
+    int32_t max = (1 << (bits - 1)) - 1;
+
+    if (out > max)      return max;
+    if (out < -max - 1) return -max - 1;
+    return out;
+}
+
+// SMMUL: upper 32 bits of the 64-bit product
+static inline int32_t multiply_32x32_rshift32(int32_t a, int32_t b)
+{
+    return ((int64_t) a * b) >> 32;
+}
+
+// SMUAD: top * top + bottom * bottom
+static inline int32_t multiply_16tx16t_add_16bx16b(uint32_t a, uint32_t b)
+{
+    return (int32_t)((uint32_t)((int16_t)(a >> 16) * (int16_t)(b >> 16)) +
+                     (uint32_t)((int16_t) a * (int16_t) b));
+}
+
+// SMLAD: sum + top * top + bottom * bottom
+static inline int32_t multiply_accumulate_16tx16t_add_16bx16b(int32_t sum, uint32_t a, uint32_t b)
+{
+    return (int32_t)((uint32_t) sum + (uint32_t) multiply_16tx16t_add_16bx16b(a, b));
+}
+
+// PKHBT: a in the top half, b in the bottom half
+static inline uint32_t pack_16b_16b(int32_t a, int32_t b)
+{
+    return ((uint32_t) a << 16) | ((uint32_t) b & 0x0000FFFF);
+}
+
+#endif
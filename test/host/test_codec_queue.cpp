@@ -0,0 +1,93 @@
+//
+// Codec write queue: at most one write per loop() pass, and writes that
+// would not change a register (per the shadow of the registers) are
+// dropped. Counts codec calls (host_codec.calls) per batch of messages.
+//
+#include "check.h"
+#include "sim.h"
+
+static ShieldSim sim;
+
+static const int CHANNEL = 10;
+
+//
+// Codec calls for the messages sent by "send", after the queue has drained
+//
+template <typename F> static unsigned writes(F send)
+{
+    unsigned calls = host_codec.calls;
+
+    send();
+    sim.run_until(host_time_ns + 40 * ShieldSim::LOOP_NS);
+    return host_codec.calls - calls;
+}
+
+static void raw(int reg, int data, int mask, bool force = false)
+{
+    host_send_nrpn(CHANNEL, MIDI_NRPN_WM8960_RAW_MASK, mask);
+    host_send_nrpn(CHANNEL, MIDI_NRPN_WM8960_RAW_DATA, data);
+    host_send_nrpn(CHANNEL, MIDI_NRPN_WM8960_RAW_WRITE, reg + (force ? 64 : 0));
+}
+
+int main(void)
+{
+    unsigned n;
+
+    sim.begin();
+
+    //
+    // Raw writes: merged per register, dropped if the register
+    // holds the bits already, unless forced
+    //
+    n = writes([]() { raw(5, 0x01, 0x01); raw(5, 0x08, 0x08); raw(10, 0xff, 0x1ff); });
+    CHECK(n == 2, "%u writes for two registers", n);
+    n = writes([]() { raw(5, 0x09, 0x09); raw(10, 0xff, 0x1ff); });
+    CHECK(n == 0, "%u writes of the values on the codec", n);
+    n = writes([]() { raw(5, 0x01, 0x03); });
+    CHECK(n == 1, "%u writes with a bit not known", n);
+    n = writes([]() { raw(5, 0x01, 0x01, true); });
+    CHECK(n == 1, "%u forced writes", n);
+
+    //
+    // Commands: a repeated command is dropped, unless one of its
+    // registers has been written since. Running the command forgets
+    // the shadow of its registers.
+    //
+    n = writes([]() { host_send_nrpn(CHANNEL, MIDI_NRPN_WM8960_DISABLE_ADCHPF, 1); });
+    CHECK(n == 1, "%u writes for a command", n);
+    n = writes([]() { host_send_nrpn(CHANNEL, MIDI_NRPN_WM8960_DISABLE_ADCHPF, 1); });
+    CHECK(n == 0, "%u writes for a repeated command", n);
+    n = writes([]() { raw(10, 0xff, 0x1ff); });
+    CHECK(n == 0, "%u writes of another register", n);
+    n = writes([]() { host_send_nrpn(CHANNEL, MIDI_NRPN_WM8960_DISABLE_ADCHPF, 1); });
+    CHECK(n == 0, "%u writes for a command after another register", n);
+    n = writes([]() { raw(5, 0x01, 0x01); });
+    CHECK(n == 1, "%u writes of a register after a command", n);
+    n = writes([]() { host_send_nrpn(CHANNEL, MIDI_NRPN_WM8960_DISABLE_ADCHPF, 1); });
+    CHECK(n == 1, "%u writes for a command after its register", n);
+
+    //
+    // Master volume: no write for a level on the same volume step
+    // (WM8960: 80 steps for 127 levels)
+    //
+    host_send_cc(CHANNEL, MIDI_MASTER_VOLUME, 1);
+    sim.run_until(host_time_ns + 100 * ShieldSim::LOOP_NS);
+    unsigned volume_calls = host_codec.volume_calls;
+    host_send_cc(CHANNEL, MIDI_MASTER_VOLUME, 2);
+    sim.run_until(host_time_ns + 100 * ShieldSim::LOOP_NS);
+    CHECK(host_codec.volume_calls == volume_calls, "%u writes for the same volume step",
+          host_codec.volume_calls - volume_calls);
+
+    //
+    // The headphone volume command shares the registers of the master
+    // volume: afterwards, the master volume is written again
+    //
+    n = writes([]() { host_send_nrpn(CHANNEL, MIDI_NRPN_WM8960_HEADPHONE_VOLUME, 0x3f7f); });
+    CHECK(n == 1, "%u writes for the headphone volume", n);
+    host_send_cc(CHANNEL, MIDI_MASTER_VOLUME, 100);
+    sim.run_until(host_time_ns + 100 * ShieldSim::LOOP_NS);
+    CHECK(host_codec.volume_calls == volume_calls + 1, "%u master volume writes",
+          host_codec.volume_calls - volume_calls);
+
+    return check_result("test_codec_queue");
+}
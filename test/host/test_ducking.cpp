@@ -0,0 +1,65 @@
+//
+// RX audio ducking combined with gain changes: while the RX audio is
+// ducked at a constant depth, a master volume change must ramp smoothly,
+// without steps at the block boundaries.
+//
+#include <stdlib.h>
+#include "check.h"
+#include "tone_rig.h"
+
+static ToneRig rig;
+
+//
+// Largest difference between neighbouring samples of out[0] from "from" on
+//
+static int max_step(size_t from)
+{
+    const std::vector<int16_t> &out = rig.out[0];
+    int step = 0;
+
+    for (size_t i = from + 1; i < out.size(); i++) {
+        int d = abs(out[i] - out[i - 1]);
+        if (d > step) step = d;
+    }
+    return step;
+}
+
+int main(void)
+{
+    AudioMemory(16);
+    rig.tone.duck(0.3F, 2.0F, 10.0F);
+    rig.tone.volume(1.0F);
+    rig.rx = 16000;
+    rig.begin();
+    rig.blocks(4);
+
+    rig.tone.muteAudioIn(1);
+    rig.blocks(8);
+    int16_t ducked = rig.out[0].back();
+    CHECK(abs(ducked - 16000 * 3 / 20) <= 2, "ducked level %d", ducked);
+
+    //
+    // Volume down and up again: at most one ramp step per sample
+    // (1 << 21 in Q30, times 16000 / 2, times the ducking depth: 4.7)
+    //
+    for (float volume = 0.2F; volume <= 1.0F; volume += 0.8F) {
+        size_t from = rig.out[0].size();
+        rig.tone.volume(volume);
+        rig.blocks(12);
+        int step = max_step(from - 1);
+        CHECK(step <= 6, "volume %.1f: step of %d", volume, step);
+        int16_t level = rig.out[0].back();
+        int16_t expected = 16000 * 0.3F * volume / 2;
+        CHECK(abs(level - expected) <= 2, "volume %.1f: level %d, expected %d", volume, level, expected);
+    }
+
+    //
+    // Balance change while ducked
+    //
+    size_t from = rig.out[0].size();
+    rig.tone.balance(0.1F, 1.0F);
+    rig.blocks(12);
+    CHECK(max_step(from - 1) <= 6, "balance: step of %d", max_step(from - 1));
+
+    return check_result("test_ducking");
+}
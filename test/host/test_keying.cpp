@@ -0,0 +1,187 @@
+//
+// Sample accuracy of the side tone keying: an event time-stamped dt
+// micro-seconds after the start of a block that spans "span" micro-seconds
+// must switch the tone at sample dt * 128 / span (within one sample).
+// Covers events anywhere in the block, late events (time-stamped before
+// the block), events on the block boundaries, and scheduled (playout)
+// events mixed with immediate ones.
+//
+// The carrier is made constant (frequency 0 after the oscillator has been
+// run to a non-zero phase), so the output is the keying envelope itself:
+// the key-down edge is the first non-zero sample, the key-up edge the
+// first sample below the steady level.
+//
+#include <stdlib.h>
+#include "check.h"
+#include "tone_rig.h"
+
+static ToneRig rig;
+static int16_t level;      // steady output with the key down
+
+//
+// Global sample index of the first sample at or after "from" that
+// differs from "value" (or equals it, if equal is set)
+//
+static long find(size_t from, int16_t value, bool equal)
+{
+    const std::vector<int16_t> &out = rig.out[0];
+    for (size_t i = from; i < out.size(); i++) {
+        if ((out[i] == value) == equal) return i;
+    }
+    return -1;
+}
+
+//
+// Queue a key event dt micro-seconds after the start of the next block,
+// render until the ramp has finished, and return the edge found (global
+// sample index), the expected one is returned in expected
+//
+static long edge(uint8_t state, int32_t dt, long &expected)
+{
+    uint64_t k     = rig.next();
+    uint32_t start = ToneRig::now(k - 1);
+    uint32_t span  = ToneRig::now(k) - start;
+    size_t   first = rig.first_sample(k);
+
+    rig.tone.keyEvent(state, start + dt);
+    rig.blocks(3);
+    expected = first + (dt < 0 ? 0 : (int64_t) dt * AUDIO_BLOCK_SAMPLES / span);
+    return state ? find(first, 0, false) : find(first, level, false);
+}
+
+static void check_edge(uint8_t state, int32_t dt)
+{
+    long expected, found = edge(state, dt, expected);
+    CHECK(found >= 0 && labs(found - expected) <= 1,
+          "key %s at dt=%d: edge at sample %ld, expected %ld",
+          state ? "down" : "up", dt, found, expected);
+}
+
+int main(void)
+{
+    AudioMemory(16);
+    rig.tone.setWindow(WINDOW_RAISED_COSINE, 2);
+    rig.tone.amplitude(1.0F);
+    rig.tone.volume(1.0F);
+    rig.begin();
+
+    //
+    // Run the oscillator at 93.75 Hz (a quarter cycle per block) until the
+    // side tone gain has settled, then stop it at a non-zero phase
+    //
+    rig.tone.frequency(93.75F);
+    rig.tone.keyEvent(1, ToneRig::now(rig.next() - 1));
+    rig.blocks(8);
+    rig.tone.keyEvent(0, ToneRig::now(rig.next() - 1));
+    rig.blocks(3);
+    rig.tone.frequency(0.0F);
+    rig.tone.keyEvent(1, ToneRig::now(rig.next() - 1));
+    rig.blocks(3);
+    level = rig.out[0].back();
+    CHECK(abs(level) > 8000, "carrier level %d too small", level);
+    CHECK(find(rig.out[0].size() - AUDIO_BLOCK_SAMPLES, level, false) < 0, "carrier not constant");
+    rig.tone.keyEvent(0, ToneRig::now(rig.next() - 1));
+    rig.blocks(3);
+
+    //
+    // Events within the block, both edges
+    //
+    srand(1);
+    for (int trial = 0; trial < 200; trial++) {
+        int32_t dt = (trial * 1337) % 2666;
+        check_edge(1, dt);
+        check_edge(0, rand() % 2666);
+    }
+
+    //
+    // Block boundaries: at the start of the block, just before its end,
+    // and at its end (which is the start of the next block)
+    //
+    check_edge(1, 0);
+    check_edge(0, 0);
+    check_edge(1, 2665);
+    check_edge(0, 2665);
+    {
+        long expected, found = edge(1, ToneRig::now(rig.next()) - ToneRig::now(rig.next() - 1), expected);
+        CHECK(found == expected || found == expected + 1,
+              "key down at the end of the block: edge at %ld, expected %ld", found, expected);
+        found = edge(0, ToneRig::now(rig.next()) - ToneRig::now(rig.next() - 1), expected);
+        CHECK(found == expected || found == expected + 1,
+              "key up at the end of the block: edge at %ld, expected %ld", found, expected);
+    }
+
+    //
+    // Late events are played at the start of the block, and counted
+    //
+    uint16_t late = rig.tone.lateEvents();
+    check_edge(1, -500);
+    check_edge(0, -1);
+    CHECK(rig.tone.lateEvents() == late + 2, "late events %u, expected %u",
+          rig.tone.lateEvents(), late + 2);
+    CHECK(rig.tone.droppedEvents() == 0, "dropped events %u", rig.tone.droppedEvents());
+
+    //
+    // Scheduled key events (playout buffer) queued ahead of immediate key
+    // and mute events. A mute must not wait behind a key event scheduled
+    // blocks ahead ...
+    //
+    rig.rx = 8000;
+    rig.blocks(4);
+    late = rig.tone.lateEvents();
+    {
+        uint64_t k     = rig.next();
+        uint32_t start = ToneRig::now(k - 1);
+        size_t   first = rig.first_sample(k);
+
+        rig.tone.scheduleKeyEvent(1, start + 8000);
+        rig.tone.muteAudioIn(1);
+        rig.block();
+        int before = abs(rig.out[0][first - 1]);
+        int after  = abs(rig.out[0][first + 64]);
+        CHECK(before > 1000 && after < before / 2,
+              "RX audio not ducked at once: %d before, %d after the mute", before, after);
+        rig.blocks(4);
+        rig.tone.scheduleKeyEvent(0, ToneRig::now(rig.next() - 1));
+        rig.tone.muteAudioIn(0);
+        rig.rx = 0;
+        rig.blocks(8);
+    }
+
+    //
+    // ... and events from both queues within one block must be played in
+    // time order: here a scheduled key-down at sample 72 is queued before
+    // an immediate key-down at sample 4 and key-up at sample 48
+    //
+    {
+        uint64_t k     = rig.next();
+        uint32_t start = ToneRig::now(k - 1);
+        size_t   first = rig.first_sample(k);
+        const std::vector<int16_t> &out = rig.out[0];
+
+        rig.tone.scheduleKeyEvent(1, start + 1500);
+        rig.tone.keyEvent(1, start + 100);
+        rig.tone.keyEvent(0, start + 1000);
+        rig.blocks(2);
+        long on = find(first, 0, false);
+        CHECK(on >= (long) first + 4 && on <= (long) first + 5,
+              "key down at sample %ld, expected 4", on - (long) first);
+        CHECK(abs(out[first + 50]) < abs(out[first + 47]),
+              "no ramp down at sample 48: %d, %d", out[first + 47], out[first + 50]);
+        CHECK(abs(out[first + 72]) < abs(out[first + 60]) && abs(out[first + 90]) > abs(out[first + 72]),
+              "no ramp up at sample 72: %d, %d, %d", out[first + 60], out[first + 72], out[first + 90]);
+        CHECK(out[first + 2 * AUDIO_BLOCK_SAMPLES - 1] == level, "key not down at the end");
+        rig.tone.keyEvent(0, ToneRig::now(rig.next() - 1));
+        rig.blocks(3);
+    }
+    CHECK(rig.tone.lateEvents() == late, "%u late events", rig.tone.lateEvents() - late);
+    CHECK(rig.tone.droppedEvents() == 0, "dropped events %u", rig.tone.droppedEvents());
+
+    //
+    // Without RX audio and with the side tone centred, both channels get
+    // the same block, and no block is left allocated
+    //
+    CHECK(rig.out[0] == rig.out[1], "left and right channel differ");
+    CHECK(AudioMemoryUsage() == 0, "%u audio blocks not released", AudioMemoryUsage());
+
+    return check_result("test_keying");
+}
@@ -0,0 +1,98 @@
+//
+// Master volume on the codec: written once during startup, after the
+// settings have been restored. A change is ramped on the digital master
+// gain first and handed over to the codec once the ramp has settled:
+// one codec write per change, with the latest value, and the level on
+// the line out (digital level times codec gain) never jumps up.
+//
+#include <math.h>
+#include <stdlib.h>
+#include "check.h"
+#include "sim.h"
+
+static ShieldSim sim;
+
+static const int16_t RX = 16000;
+
+//
+// Linear gain of the WM8960 headphone volume for a level (1 dB steps,
+// 0x79: 0 dB, 0x2F and below: mute)
+//
+static float codec_gain(float level)
+{
+    int m = level * 80.0F + 47.499F;
+
+    return (m <= 0x2F) ? 0.0F : powf(10.0F, (m - 0x79) / 20.0F);
+}
+
+//
+// Line out level after the codec, from the last sample of the last block
+//
+static float level(void)
+{
+    return abs(sim.out[0].back()) * codec_gain(host_codec.volume);
+}
+
+//
+// Run n audio blocks, the highest level on the line out
+//
+static float run(int n)
+{
+    float peak = 0;
+
+    while (n-- > 0) {
+        sim.run_blocks(1);
+        if (level() > peak) peak = level();
+    }
+    return peak;
+}
+
+int main(void)
+{
+    sim.usb_in = [](uint8_t channel, int16_t *data) {
+        for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) data[i] = RX;
+        return true;
+    };
+    sim.begin();
+    CHECK(host_codec.volume_calls == 1, "%u volume writes during startup", host_codec.volume_calls);
+    CHECK(host_codec.volume == 0.8F, "startup volume %f", host_codec.volume);
+    run(8);
+    float start = level();
+
+    //
+    // A slider moved down through 40 values within one loop() pass:
+    // the digital gain ramps down, then the codec takes over
+    //
+    for (int v = 59; v >= 20; v--) host_send_cc(10, 7, v);
+    float peak = run(16);
+    CHECK(host_codec.volume_calls == 2, "%u volume writes", host_codec.volume_calls);
+    CHECK(host_codec.volume == 20 / 127.0F, "volume %f", host_codec.volume);
+    CHECK(abs(sim.out[0].back() - RX / 2) <= 2, "digital level %d after the handover", sim.out[0].back());
+    CHECK(peak <= start * 1.01F, "level %f going down, %f before", peak, start);
+
+    //
+    // Up again: the codec goes up after the digital gain went down,
+    // and the digital gain ramps back to unity
+    //
+    float low = level();
+    host_send_cc(10, 7, 100);
+    peak = run(16);
+    CHECK(host_codec.volume_calls == 3, "%u volume writes", host_codec.volume_calls);
+    CHECK(host_codec.volume == 100 / 127.0F, "volume %f", host_codec.volume);
+    CHECK(abs(sim.out[0].back() - RX / 2) <= 2, "digital level %d after the handover", sim.out[0].back());
+    CHECK(peak <= level() * 1.01F, "level %f going up, %f at the end", peak, level());
+    CHECK(level() > low, "level %f, %f before", level(), low);
+
+    //
+    // No write if nothing changes, or a change is taken back before
+    // the ramp has settled
+    //
+    host_send_cc(10, 7, 90);
+    sim.run_until(host_time_ns + ShieldSim::LOOP_NS);
+    host_send_cc(10, 7, 100);
+    run(16);
+    CHECK(host_codec.volume_calls == 3, "%u volume writes", host_codec.volume_calls);
+    CHECK(abs(sim.out[0].back() - RX / 2) <= 2, "digital level %d", sim.out[0].back());
+
+    return check_result("test_master_volume");
+}
@@ -0,0 +1,38 @@
+//
+// Latency of the microphone audio to the computer: a block from the I2S
+// input must reach the USB output in the next audio update, as without
+// the VOX in between (objects are updated in the order of construction,
+// the I2S input is created last).
+//
+#include "check.h"
+#include "sim.h"
+
+static ShieldSim sim;
+
+int main(void)
+{
+    const uint64_t impulse = 40;    // block with the impulse
+    uint64_t block = 0;
+
+    sim.line_in = [&block, impulse](uint8_t channel, int16_t *data) {
+        for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) data[i] = 0;
+        if (channel == 0 && block == impulse) data[0] = 10000;
+        if (channel == 1) block++;
+        return true;
+    };
+    sim.begin();
+    sim.run_blocks(impulse + 10);
+
+    const std::vector<int16_t> &out = sim.usb_out[0];
+    long found = -1;
+    for (size_t i = 0; i < out.size(); i++) {
+        if (out[i]) {
+            found = i;
+            break;
+        }
+    }
+    CHECK(found == (long) (impulse + 1) * AUDIO_BLOCK_SAMPLES,
+          "impulse at sample %ld, expected %ld", found, (long) (impulse + 1) * AUDIO_BLOCK_SAMPLES);
+
+    return check_result("test_mic_latency");
+}
@@ -0,0 +1,100 @@
+//
+// Persistent settings: saved to the EEPROM once they have been unchanged
+// for CWKEYER_PERSIST_DELAY_MS, and restored by a second keyer (a power
+// cycle) from the same EEPROM. The restored settings are executed once,
+// during the startup stages, without control change responses. The side
+// tone frequency is saved once, as MIDI_NRPN_SIDETONE_FREQUENCY.
+//
+#include "check.h"
+#include "sim.h"
+
+static ShieldSim sim;
+
+static const int CHANNEL = 10;
+static const uint64_t MS = 1000000ULL;
+
+//
+// Slot size: the header and one entry per PARAM_PERSIST parameter
+//
+#define COUNT(name, num, min, max, flags, ...) + (((flags) & PARAM_PERSIST) ? 1 : 0)
+static const int SLOT = 8 + 3 * (0 CWKEYER_PARAMETERS(COUNT, COUNT, CWKEYER_ENUM_IGNORE, CWKEYER_ENUM_IGNORE));
+
+//
+// Entries of the newest valid record: index -> value
+//
+static std::map<int, int> newest_record(void)
+{
+    const int base = E2END + 1 - CWKEYER_EEPROM_SIZE;
+    std::map<int, int> entries;
+    int newest = -1, seq = 0;
+
+    for (int slot = 0; (slot + 1) * SLOT <= CWKEYER_EEPROM_SIZE; slot++) {
+        const uint8_t *h = host_eeprom + base + slot * SLOT;
+        int s = (h[4] << 8) | h[5];
+        if (h[0] != 'C' || h[1] != 'W' || h[2] != 2) continue;
+        if (newest < 0 || (int16_t) (s - seq) > 0) {
+            newest = slot;
+            seq = s;
+        }
+    }
+    if (newest < 0) return entries;
+    const uint8_t *h = host_eeprom + base + newest * SLOT;
+    for (int i = 0; i < h[3]; i++) {
+        const uint8_t *e = h + 8 + 3 * i;
+        entries[e[0]] = (int16_t) ((e[1] << 8) | e[2]);
+    }
+    return entries;
+}
+
+static int cc_count(void)
+{
+    int n = 0;
+
+    for (const host_midi_message &m : host_midi_out) {
+        if (m.type == usbMIDI.ControlChange) n++;
+    }
+    return n;
+}
+
+int main(void)
+{
+    sim.begin();
+    host_send_cc(CHANNEL, MIDI_MASTER_VOLUME, 50);
+    host_send_cc(CHANNEL, MIDI_SIDETONE_FREQUENCY, 70);
+    host_send_cc(CHANNEL, MIDI_CW_SPEED, 25);
+    host_send_nrpn(CHANNEL, MIDI_NRPN_DUCK_DEPTH, 20);
+    sim.run_until(host_time_ns + (CWKEYER_PERSIST_DELAY_MS + 500) * MS);
+
+    std::map<int, int> record = newest_record();
+    CHECK(!record.empty(), "no record");
+    CHECK(record.count(MIDI_SIDETONE_FREQUENCY) == 0, "side tone frequency saved as a control");
+    CHECK(record[128 + MIDI_NRPN_SIDETONE_FREQUENCY] == 700, "side tone frequency %d",
+          record[128 + MIDI_NRPN_SIDETONE_FREQUENCY]);
+    CHECK(record[MIDI_MASTER_VOLUME] == 50, "master volume %d", record[MIDI_MASTER_VOLUME]);
+    CHECK(record[MIDI_CW_SPEED] == 25, "speed %d", record[MIDI_CW_SPEED]);
+    CHECK(record[128 + MIDI_NRPN_DUCK_DEPTH] == 20, "duck depth %d", record[128 + MIDI_NRPN_DUCK_DEPTH]);
+
+    //
+    // Power cycle: a new keyer on the same EEPROM
+    //
+    ShieldSim *next = new ShieldSim;
+    host_keyer_speed = 0;
+    host_midi_out.clear();
+    unsigned volume_calls = host_codec.volume_calls;
+    next->begin();
+    CHECK(host_keyer_speed == 25, "speed %d after the restore", host_keyer_speed);
+    CHECK(host_codec.volume_calls == volume_calls + 1, "%u master volume writes",
+          host_codec.volume_calls - volume_calls);
+    CHECK(host_codec.volume == 50 / 127.0F, "master volume %f", host_codec.volume);
+    next->run_until(host_time_ns + 100 * MS);
+    CHECK(cc_count() == 0, "%d control change responses", cc_count());
+
+    //
+    // Nothing changed: no new record
+    //
+    unsigned writes = host_eeprom_writes;
+    next->run_until(host_time_ns + (CWKEYER_PERSIST_DELAY_MS + 500) * MS);
+    CHECK(host_eeprom_writes == writes, "%u EEPROM writes after the restore", host_eeprom_writes - writes);
+
+    return check_result("test_persist");
+}
@@ -0,0 +1,185 @@
+//
+// Front panel pots: the background scan (through the host ADC stand-in,
+// host_analog[]), the low pass filter, the hysteresis and the mapping in
+// CWKeyerShield::pots(). Pot values are 12-bit ADC results; turning a pot
+// clockwise decreases them.
+//
+#include <random>
+#include "check.h"
+#include "sim.h"
+
+static ShieldSim sim;
+
+static const uint64_t MS = 1000000ULL;
+
+//
+// ADC value at the middle of step s, for steps of (1 << shift) in 13 bits
+//
+static int raw_mid(int s, int shift)
+{
+    return ((s << shift) + (1 << (shift - 1))) >> 1;
+}
+
+//
+// Turn a pot to step s. It stops a quarter step past the middle, as the
+// hysteresis only accepts a step beyond its middle (the last accepted
+// value is the middle of the last accepted step, and a step is accepted
+// if the value deviates from it by more than one step).
+//
+static void turn(int pin, int s, int shift)
+{
+    int raw = raw_mid(s, shift), quarter = 1 << (shift - 3);
+
+    host_analog[pin] = raw + (raw > host_analog[pin] ? quarter : -quarter);
+}
+
+//
+// Last control change response sent for a controller, -1 if there is none
+//
+static int last_cc(uint8_t cc)
+{
+    for (auto m = host_midi_out.rbegin(); m != host_midi_out.rend(); ++m) {
+        if (m->type == usbMIDI.ControlChange && m->data1 == cc) return m->data2;
+    }
+    return -1;
+}
+
+static int cc_count(void)
+{
+    int n = 0;
+
+    for (const host_midi_message &m : host_midi_out) {
+        if (m.type == usbMIDI.ControlChange) n++;
+    }
+    return n;
+}
+
+//
+// Master volume on the codec is at the WM8960 volume step of a level
+// (levels on the same step are not written)
+//
+static bool master(float volume, int level)
+{
+    return (int) (volume * 80.0F + 47.499F) == (int) (level / 127.0F * 80.0F + 47.499F);
+}
+
+int main(void)
+{
+    uint64_t t0;
+
+    //
+    // The pot positions at power-up are taken over right away
+    //
+    host_analog[A1] = raw_mid(127 - 100, 6);        // master volume 100
+    host_analog[A2] = raw_mid(127 - 90, 6);         // side tone volume 90
+    host_analog[A3] = raw_mid(103 - 80, 7);         // side tone 800 Hz
+    host_analog[A8] = raw_mid(31 - 15, 8);          // SpeedTab[15] = 20 wpm
+    sim.begin();
+    sim.run_until(host_time_ns + 50 * MS);
+    CHECK(master(host_codec.volume, 100), "master volume %f", host_codec.volume);
+    CHECK(last_cc(MIDI_SIDETONE_VOLUME) == 90, "side tone volume %d", last_cc(MIDI_SIDETONE_VOLUME));
+    CHECK(last_cc(MIDI_SIDETONE_FREQUENCY) == 80, "side tone frequency %d", last_cc(MIDI_SIDETONE_FREQUENCY));
+    CHECK(host_keyer_speed == 20, "speed %d", host_keyer_speed);
+
+    //
+    // Mapping, including both ends of the range. The codec follows the
+    // master volume once the digital master gain has settled (a ramp over
+    // the whole range takes 12 msec, the handover another 6 msec).
+    //
+    const int levels[] = {0, 127, 5, 64, 126, 2};
+    for (int level : levels) {
+        turn(A1, 127 - level, 6);
+        sim.run_until(host_time_ns + 60 * MS);
+        CHECK(master(host_codec.volume, level), "master volume %f, expected %d", host_codec.volume, level);
+    }
+    host_analog[A1] = 0;
+    host_analog[A8] = 0;
+    sim.run_until(host_time_ns + 60 * MS);
+    CHECK(master(host_codec.volume, 127), "master volume %f at pot 0", host_codec.volume);
+    CHECK(host_keyer_speed == 52, "speed %d at pot 0", host_keyer_speed);
+    host_analog[A1] = 4095;
+    host_analog[A8] = 4095;
+    sim.run_until(host_time_ns + 60 * MS);
+    CHECK(master(host_codec.volume, 0), "master volume %f at pot 4095", host_codec.volume);
+    CHECK(host_keyer_speed == 5, "speed %d at pot 4095", host_keyer_speed);
+
+    //
+    // Hysteresis: one step away from the middle of the last accepted
+    // step is not accepted, a little more is (on the control change
+    // response, as 63 and 64 are on the same codec volume step)
+    //
+    turn(A1, 63, 6);
+    sim.run_until(host_time_ns + 60 * MS);
+    CHECK(last_cc(MIDI_MASTER_VOLUME) == 64, "master volume %d", last_cc(MIDI_MASTER_VOLUME));
+    host_analog[A1] = raw_mid(63, 6) + 32;
+    sim.run_until(host_time_ns + 60 * MS);
+    CHECK(last_cc(MIDI_MASTER_VOLUME) == 64, "master volume %d one step away", last_cc(MIDI_MASTER_VOLUME));
+    host_analog[A1] = raw_mid(63, 6) + 33;
+    sim.run_until(host_time_ns + 60 * MS);
+    CHECK(last_cc(MIDI_MASTER_VOLUME) == 63, "master volume %d beyond one step", last_cc(MIDI_MASTER_VOLUME));
+
+    //
+    // Noise of up to one step at every pot does not change anything
+    //
+    const int pins[4] = {A1, A2, A3, A8}, shift[4] = {6, 6, 7, 8}, steps[4] = {64, 90, 23, 16};
+    std::mt19937 rng(1);
+    for (int i = 0; i < 4; i++) host_analog[pins[i]] = 0;
+    sim.run_until(host_time_ns + 30 * MS);
+    for (int i = 0; i < 4; i++) turn(pins[i], steps[i], shift[i]);
+    sim.run_until(host_time_ns + 50 * MS);
+    host_midi_out.clear();
+    unsigned volume_calls = host_codec.volume_calls;
+    int speed = host_keyer_speed;
+    t0 = host_time_ns;
+    for (uint64_t t = 0; t < 1000 * MS; t += MS / 4) {
+        sim.at(t0 + t, [&]() {
+            for (int i = 0; i < 4; i++) {
+                int step = 1 << (shift[i] - 1);                     // one step in 12 bits
+                host_analog[pins[i]] = raw_mid(steps[i], shift[i]) + (int) (rng() % (2 * step + 1)) - step;
+            }
+        });
+    }
+    sim.run_until(t0 + 1000 * MS);
+    CHECK(host_codec.volume_calls == volume_calls, "%u master volume writes with noise",
+          host_codec.volume_calls - volume_calls);
+    CHECK(cc_count() == 0, "%d control change responses with noise", cc_count());
+    CHECK(host_keyer_speed == speed, "speed %d with noise", host_keyer_speed);
+
+    //
+    // Low pass filter: glitches of three steps, one scan each, are not
+    // accepted either. The scans are on full milli-seconds.
+    //
+    host_analog[A1] = raw_mid(steps[0], shift[0]);
+    t0 = (host_time_ns / MS + 2) * MS + MS / 2;
+    for (int i = 0; i < 20; i++) {
+        sim.at(t0 + 10 * i * MS,      []() { host_analog[A1] += 3 * 32; });
+        sim.at(t0 + 10 * i * MS + MS, []() { host_analog[A1] -= 3 * 32; });
+    }
+    sim.run_until(t0 + 200 * MS);
+    CHECK(host_codec.volume_calls == volume_calls, "%u master volume writes with glitches",
+          host_codec.volume_calls - volume_calls);
+
+    //
+    // Latency: a change registers (the control change response, the
+    // digital master gain starts to ramp) within 5 msec. Reaching the
+    // end of the scale on the codec takes longer: the low pass filter
+    // (four scans) has to settle within one step, then the ramp and
+    // the handover follow.
+    //
+    host_analog[A1] = 0;
+    sim.run_until(host_time_ns + 60 * MS);
+    host_midi_out.clear();
+    host_analog[A1] = 4095;
+    t0 = host_time_ns;
+    uint64_t first = 0, last = 0;
+    while (host_time_ns < t0 + 80 * MS) {
+        sim.run_until(host_time_ns + ShieldSim::LOOP_NS);
+        if (!first && last_cc(MIDI_MASTER_VOLUME) >= 0) first = host_time_ns - t0;
+        if (!last && master(host_codec.volume, 0)) last = host_time_ns - t0;
+    }
+    CHECK(first && first <= 5 * MS, "first change after %.2f msec", first / 1e6);
+    CHECK(last && last <= 45 * MS, "end of scale after %.2f msec", last / 1e6);
+    printf("test_pots: latency %.2f msec, end of scale after %.2f msec\n", first / 1e6, last / 1e6);
+
+    return check_result("test_pots");
+}
@@ -0,0 +1,117 @@
+//
+// A TeensyAudioTone driven block by block with updateAt(), its output
+// captured. Block k ends at micros() time now(k), the host clock follows,
+// so time stamps from micros() (e.g. muteAudioIn()) are consistent.
+//
+#ifndef tone_rig_h_
+#define tone_rig_h_
+
+#include <vector>
+#include "host.h"
+#include "bench.h"
+#include "TeensyAudioTone.h"
+
+class AudioCapture : public AudioStream
+{
+public:
+    AudioCapture() : AudioStream(2, inputQueueArray) {}
+    virtual void update(void) {}
+
+    //
+    // Append the block received on a channel to out (silence if none)
+    //
+    void take(uint8_t channel, std::vector<int16_t> &out) {
+        audio_block_t *block = receiveReadOnly(channel);
+        if (block) {
+            out.insert(out.end(), block->data, block->data + AUDIO_BLOCK_SAMPLES);
+            release(block);
+        } else {
+            out.insert(out.end(), AUDIO_BLOCK_SAMPLES, 0);
+        }
+    }
+
+private:
+    audio_block_t *inputQueueArray[2];
+};
+
+//
+// Constant RX audio, as from the USB input
+//
+class AudioFeed : public AudioStream
+{
+public:
+    AudioFeed() : AudioStream(0, NULL) {}
+    virtual void update(void) {}
+
+    void push(int16_t value) {
+        audio_block_t *block = allocate();
+        if (!block) return;
+        for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) block->data[i] = value;
+        transmit(block, 0);
+        transmit(block, 1);
+        release(block);
+    }
+};
+
+class ToneRig
+{
+public:
+    ToneRig() : patchl(tone, 0, capture, 0), patchr(tone, 1, capture, 1),
+                feedl(feed, 0, tone, 0), feedr(feed, 0, tone, 1) {}
+
+    TeensyAudioTone tone;
+    AudioCapture    capture;
+    AudioFeed       feed;
+    std::vector<int16_t> out[2];
+    int16_t         rx = 0;     // RX audio level (0: no RX audio)
+    uint64_t        ticks = 0;  // time spent in updateAt() for the last block, see bench.h
+
+    //
+    // micros() time at the end of block k: 128 samples at 48 kHz are
+    // 2666.67 us, so the span of a block is 2666 or 2667 us
+    //
+    static uint32_t now(uint64_t k) { return (uint32_t) ((k + 1) * 8000 / 3); }
+
+    //
+    // Render the next block, with updateAt() called at its end. The host
+    // clock is then left at the end of the block, such that events
+    // stamped with micros() fall at the start of the next one.
+    //
+    void block(void) {
+        if (rx) feed.push(rx);
+        uint64_t t0 = bench_ticks();
+        tone.updateAt(now(count));
+        ticks = bench_ticks() - t0;
+        host_time_ns = (uint64_t) now(count) * 1000;
+        capture.take(0, out[0]);
+        capture.take(1, out[1]);
+        count++;
+    }
+    void blocks(unsigned n) { while (n--) block(); }
+
+    //
+    // Index of the next block, and sample index at which it starts in out[]
+    //
+    uint64_t next(void) { return count; }
+    size_t   first_sample(uint64_t k) { return (k - base) * AUDIO_BLOCK_SAMPLES; }
+
+    //
+    // The first block starts the time base (its span is not one block)
+    //
+    void begin(void) {
+        std::vector<int16_t> discard;
+        tone.updateAt(now(count));
+        capture.take(0, discard);
+        capture.take(1, discard);
+        host_time_ns = (uint64_t) now(count) * 1000;
+        count++;
+        base = count;
+    }
+
+private:
+    AudioConnection patchl, patchr, feedl, feedr;
+    uint64_t count = 0;
+    uint64_t base = 0;
+};
+
+#endif
@@ -0,0 +1,48 @@
+//
+// Minimal writer of 16-bit stereo PCM WAV files
+//
+#ifndef wav_h_
+#define wav_h_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+inline bool wav_write(const char *path, const std::vector<int16_t> &left,
+                      const std::vector<int16_t> &right, uint32_t rate)
+{
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) return false;
+
+    size_t n = left.size() < right.size() ? left.size() : right.size();
+    uint32_t data_bytes = n * 4;
+    uint8_t header[44];
+    auto le16 = [&](int pos, uint16_t v) { header[pos] = v; header[pos + 1] = v >> 8; };
+    auto le32 = [&](int pos, uint32_t v) { le16(pos, v & 0xffff); le16(pos + 2, v >> 16); };
+
+    memcpy(header, "RIFF", 4);
+    le32(4, 36 + data_bytes);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    le32(16, 16);               // fmt chunk length
+    le16(20, 1);                // PCM
+    le16(22, 2);                // channels
+    le32(24, rate);
+    le32(28, rate * 4);         // bytes per second
+    le16(32, 4);                // bytes per frame
+    le16(34, 16);               // bits per sample
+    memcpy(header + 36, "data", 4);
+    le32(40, data_bytes);
+    fwrite(header, 1, sizeof(header), f);
+
+    for (size_t i = 0; i < n; i++) {
+        uint8_t frame[4] = {
+            (uint8_t) left[i],  (uint8_t) ((uint16_t) left[i] >> 8),
+            (uint8_t) right[i], (uint8_t) ((uint16_t) right[i] >> 8)
+        };
+        fwrite(frame, 1, 4, f);
+    }
+    return fclose(f) == 0;
+}
+
+#endif